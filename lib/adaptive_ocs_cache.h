@@ -0,0 +1,125 @@
+#pragma once
+
+#include "basic_ocs_cache.h"
+#include "ocs_structs.h"
+#include <algorithm>
+
+// Tunes the clustering thresholds that the liberal and conservative caches
+// hard-code (the on-cluster accesses needed to promote a candidate, and the
+// off- to on-cluster ratio that invalidates one) from the outcomes of every
+// window of accesses:
+//  - promoted pools earning at least `kGoodHitsPerReconfiguration` OCS hits
+//    per reconfiguration, or no OCS activity at all, lower the bar;
+//  - reconfigurations that earn fewer than `kPoorHitsPerReconfiguration`
+//    hits, or that were wasted, raise it.
+class AdaptiveOCSCache : public BasicOCSCache {
+public:
+  AdaptiveOCSCache(int pool_size_bytes, int max_concurrent_ocs_pools,
+                   int backing_store_cache_size, long window_accesses = 4096)
+      : BasicOCSCache(pool_size_bytes, max_concurrent_ocs_pools,
+                      backing_store_cache_size),
+        window_accesses(window_accesses) {}
+
+  std::string getName() override {
+    return "OCS cache with adaptive clustering and random replacement for "
+           "both NFM and backing stores";
+  }
+
+  OCSCache *clone() const override { return cloneAs(*this); }
+
+  void appendStateSignature(std::vector<uint64_t> *signature) const override {
+    BasicOCSCache::appendStateSignature(signature);
+    signature->push_back(min_on_cluster_accesses);
+    signature->push_back(invalidation_ratio);
+    signature->push_back(window_progress);
+    // the window's outcomes so far
+    signature->push_back(stats.ocs_reconfigurations -
+                         window_start.ocs_reconfigurations);
+    signature->push_back(stats.ocs_pool_hits - window_start.ocs_pool_hits);
+    signature->push_back(stats.wasted_reconfigurations -
+                         window_start.wasted_reconfigurations);
+  }
+
+  int getMinOnClusterAccesses() const { return min_on_cluster_accesses; }
+  int getInvalidationRatio() const { return invalidation_ratio; }
+
+  static constexpr int kMinOnClusterAccesses = 25;
+  static constexpr int kMaxOnClusterAccesses = 1600;
+  static constexpr int kMinInvalidationRatio = 2;
+  static constexpr int kMaxInvalidationRatio = 16;
+  static constexpr long kGoodHitsPerReconfiguration = 32;
+  static constexpr long kPoorHitsPerReconfiguration = 4;
+
+protected:
+  [[nodiscard]] Status updateClustering(mem_access access,
+                                        bool is_clustering_candidate) override {
+    int candidate = -1;
+    RETURN_IF_ERROR(is_clustering_candidate
+                        ? getOrCreateCandidate(access, &candidate)
+                        : getCandidateIfExists(access, &candidate));
+    candidates.update(access, invalidation_ratio);
+
+    RETURN_IF_ERROR(materializeIfEligible(candidate));
+
+    if (++window_progress >= window_accesses) {
+      adaptThresholds();
+    }
+    return Status::OK;
+  }
+
+  [[nodiscard]] Status updateClusteringRun(const mem_access *accesses,
+                                           size_t count,
+                                           const access_run_bounds &run,
+                                           bool is_clustering_candidate,
+                                           size_t *applied) override {
+    // the access that ends the window goes on its own
+    count = std::min<size_t>(count, window_accesses - 1 - window_progress);
+    RETURN_IF_ERROR(updateCandidatesRun(accesses, count, run,
+                                        is_clustering_candidate,
+                                        invalidation_ratio, applied));
+    window_progress += *applied;
+    return Status::OK;
+  }
+
+  bool eligibleForMaterialization(const candidate_cluster &candidate) override {
+    return candidate.valid &&
+           candidate.on_cluster_accesses > min_on_cluster_accesses &&
+           candidate.on_cluster_accesses >
+               invalidation_ratio * candidate.off_cluster_accesses;
+  }
+
+  void adaptThresholds() {
+    long reconfigurations =
+        stats.ocs_reconfigurations - window_start.ocs_reconfigurations;
+    long hits = stats.ocs_pool_hits - window_start.ocs_pool_hits;
+    long wasted =
+        stats.wasted_reconfigurations - window_start.wasted_reconfigurations;
+
+    if (wasted > 0 ||
+        (reconfigurations > 0 &&
+         hits < kPoorHitsPerReconfiguration * reconfigurations)) {
+      // promotions are thrashing the OCS
+      min_on_cluster_accesses =
+          std::min(min_on_cluster_accesses * 2, kMaxOnClusterAccesses);
+      invalidation_ratio =
+          std::min(invalidation_ratio * 2, kMaxInvalidationRatio);
+    } else if (hits >= kGoodHitsPerReconfiguration * reconfigurations) {
+      // promoted pools pay off (or there are none yet)
+      min_on_cluster_accesses =
+          std::max(min_on_cluster_accesses / 2, kMinOnClusterAccesses);
+      invalidation_ratio =
+          std::max(invalidation_ratio / 2, kMinInvalidationRatio);
+    }
+
+    window_start = stats;
+    window_progress = 0;
+  }
+
+  long window_accesses;
+  long window_progress = 0;
+  perf_stats window_start;
+
+  // start between the liberal and conservative variants
+  int min_on_cluster_accesses = 100;
+  int invalidation_ratio = 4;
+};
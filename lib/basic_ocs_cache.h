@@ -14,40 +14,32 @@ public:
 protected:
   [[nodiscard]] Status updateClustering(mem_access access,
                                         bool is_clustering_candidate) {
-    candidate_cluster *candidate = nullptr;
+    int candidate = -1;
     RETURN_IF_ERROR(is_clustering_candidate
                         ? getOrCreateCandidate(access, &candidate)
                         : getCandidateIfExists(access, &candidate));
-    for (size_t idx = 0; idx < candidates.size(); idx++) {
-      auto candidate = candidates[idx];
-      if (candidate->valid) {
-        if (accessInRange(candidate->range, access)) {
-          candidate->on_cluster_accesses++;
-        } else {
-          candidate->off_cluster_accesses++;
-        }
-        if (candidate->off_cluster_accesses >
-            2 * candidate->on_cluster_accesses) {
-          candidate->valid = false;
-        }
-      }
-    }
+    candidates.update(access, /*invalidation_ratio=*/2);
 
     RETURN_IF_ERROR(materializeIfEligible(candidate));
     return Status::OK;
   }
 
-  [[nodiscard]] Status createCandidate(mem_access access,
-                                       candidate_cluster **candidate) {
-    *candidate = (candidate_cluster *)malloc(sizeof(candidate_cluster));
-    if (*candidate == nullptr) {
-      return Status::BAD;
-    }
+  [[nodiscard]] Status updateClusteringRun(const mem_access *accesses,
+                                           size_t count,
+                                           const access_run_bounds &run,
+                                           bool is_clustering_candidate,
+                                           size_t *applied) {
+    return updateCandidatesRun(accesses, count, run, is_clustering_candidate,
+                               /*invalidation_ratio=*/2, applied);
+  }
 
+  [[nodiscard]] Status createCandidate(mem_access access,
+                                       addr_subspace *range) {
     // naive strategy, this has bad countexamples when first access is the
     // minimum, as it usually(?) is
     addr_subspace s;
-    if (s.addr_start < .25 * pool_size_bytes) {
+    s.tenant = access.tenant;
+    if (access.addr >= .25 * pool_size_bytes) {
       s.addr_start = access.addr - .25 * pool_size_bytes;
       s.addr_end = access.addr + .75 * pool_size_bytes;
     } else { // weird edge case
@@ -55,11 +47,7 @@ protected:
       s.addr_end = access.addr + pool_size_bytes;
     }
 
-    (*candidate)->range = s;
-    (*candidate)->id = candidates.size();
-    (*candidate)->on_cluster_accesses = 0;
-    (*candidate)->off_cluster_accesses = 0;
-    (*candidate)->valid = true;
+    *range = s;
 
     DEBUG_LOG("creating candidate with address range "
               << s.addr_start << ":" << s.addr_end << std::endl);
@@ -78,4 +66,6 @@ protected:
   std::string getName() {
     return "OCS cache with random replacement for both NFM and backing store";
   }
+
+  OCSCache *clone() const override { return cloneAs(*this); }
 };
@@ -0,0 +1,184 @@
+#include "candidate_table.h"
+#include "cpu_features.h"
+
+#include <algorithm>
+
+#if AVX2_PATHS
+#include <immintrin.h>
+#endif
+
+int CandidateTable::add(const addr_subspace &range) {
+  starts.push_back(range.addr_start);
+  ends.push_back(range.addr_end);
+  tenants.push_back(range.tenant);
+  on_cluster_accesses.push_back(0);
+  off_cluster_accesses.push_back(0);
+  valid.push_back(-1);
+  touched_starts.push_back(UINT64_MAX);
+  touched_ends.push_back(0);
+  return starts.size() - 1;
+}
+
+// Same overlap test as `OCSCache::accessInRange`.
+static bool touches(uint64_t start, uint64_t end, int64_t tenant,
+                    const mem_access &access) {
+  return tenant == access.tenant && access.addr < end &&
+         access.addr + std::max(access.size, 1) > start;
+}
+
+int CandidateTable::findValid(const mem_access &access) const {
+  for (size_t idx = 0; idx < starts.size(); idx++) {
+    if (valid[idx] && touches(starts[idx], ends[idx], tenants[idx], access)) {
+      return idx;
+    }
+  }
+  return -1;
+}
+
+void CandidateTable::updateScalar(const mem_access &access,
+                                  int invalidation_ratio, size_t begin) {
+  for (size_t idx = begin; idx < starts.size(); idx++) {
+    if (!valid[idx]) {
+      continue;
+    }
+    if (touches(starts[idx], ends[idx], tenants[idx], access)) {
+      on_cluster_accesses[idx]++;
+    } else {
+      off_cluster_accesses[idx]++;
+    }
+    if (off_cluster_accesses[idx] >
+        invalidation_ratio * on_cluster_accesses[idx]) {
+      valid[idx] = 0;
+    }
+  }
+}
+
+#if AVX2_PATHS
+TARGET_AVX2 size_t CandidateTable::updateAvx2(const mem_access &access,
+                                              int invalidation_ratio) {
+  size_t idx = 0;
+  // AVX2 only compares signed 64-bit lanes, so addresses are compared with
+  // their sign bits flipped.
+  const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+  const __m256i lo = _mm256_xor_si256(
+      _mm256_set1_epi64x(static_cast<long long>(access.addr)), sign);
+  const __m256i hi = _mm256_xor_si256(
+      _mm256_set1_epi64x(
+          static_cast<long long>(access.addr + std::max(access.size, 1))),
+      sign);
+  const __m256i tenant = _mm256_set1_epi64x(access.tenant);
+  const __m256i ratio = _mm256_set1_epi64x(invalidation_ratio);
+
+  for (; idx + 4 <= starts.size(); idx += 4) {
+    __m256i lane_valid = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(&valid[idx]));
+    if (_mm256_testz_si256(lane_valid, lane_valid)) {
+      continue;
+    }
+    __m256i start = _mm256_xor_si256(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&starts[idx])),
+        sign);
+    __m256i end = _mm256_xor_si256(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(&ends[idx])),
+        sign);
+    __m256i lane_tenant = _mm256_loadu_si256(
+        reinterpret_cast<const __m256i *>(&tenants[idx]));
+
+    // tenant matches && addr < end && addr + size > start
+    __m256i match = _mm256_and_si256(
+        _mm256_cmpeq_epi64(lane_tenant, tenant),
+        _mm256_and_si256(_mm256_cmpgt_epi64(end, lo),
+                         _mm256_cmpgt_epi64(hi, start)));
+    __m256i on_mask = _mm256_and_si256(match, lane_valid);
+    __m256i off_mask = _mm256_andnot_si256(match, lane_valid);
+
+    // the masks are all ones (-1) in the lanes to count
+    __m256i *on_ptr = reinterpret_cast<__m256i *>(&on_cluster_accesses[idx]);
+    __m256i *off_ptr = reinterpret_cast<__m256i *>(&off_cluster_accesses[idx]);
+    __m256i on = _mm256_sub_epi64(_mm256_loadu_si256(on_ptr), on_mask);
+    __m256i off = _mm256_sub_epi64(_mm256_loadu_si256(off_ptr), off_mask);
+    _mm256_storeu_si256(on_ptr, on);
+    _mm256_storeu_si256(off_ptr, off);
+
+    // the 32x32 bit multiply below would truncate on-cluster counts of 2^32
+    // or more (e.g. a candidate counting through a long run), so such lanes
+    // are compared one by one
+    __m256i on_high = _mm256_srli_epi64(on, 32);
+    if (!_mm256_testz_si256(on_high, on_high)) {
+      for (size_t lane = idx; lane < idx + 4; lane++) {
+        if (valid[lane] && off_cluster_accesses[lane] >
+                               invalidation_ratio * on_cluster_accesses[lane]) {
+          valid[lane] = 0;
+        }
+      }
+      continue;
+    }
+    __m256i too_far = _mm256_cmpgt_epi64(off, _mm256_mul_epu32(on, ratio));
+    _mm256_storeu_si256(reinterpret_cast<__m256i *>(&valid[idx]),
+                        _mm256_andnot_si256(too_far, lane_valid));
+  }
+  return idx;
+}
+#endif
+
+void CandidateTable::update(const mem_access &access, int invalidation_ratio) {
+  size_t idx = 0;
+#if AVX2_PATHS
+  if (useAvx2()) {
+    idx = updateAvx2(access, invalidation_ratio);
+  }
+#endif
+  updateScalar(access, invalidation_ratio, idx);
+}
+
+bool CandidateTable::touchedUniformly(const access_run_bounds &run) const {
+  for (size_t idx = 0; idx < starts.size(); idx++) {
+    if (valid[idx] && tenants[idx] == run.tenant &&
+        !run.allTouch(starts[idx], ends[idx]) &&
+        !run.noneTouch(starts[idx], ends[idx])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+void CandidateTable::updateRun(const access_run_bounds &run, int64_t count,
+                               int invalidation_ratio) {
+  for (size_t idx = 0; idx < starts.size(); idx++) {
+    if (!valid[idx]) {
+      continue;
+    }
+    if (tenants[idx] == run.tenant && !run.noneTouch(starts[idx], ends[idx])) {
+      // only the first access can invalidate it, later ones just add to the
+      // on-cluster count
+      on_cluster_accesses[idx]++;
+      if (off_cluster_accesses[idx] >
+          invalidation_ratio * on_cluster_accesses[idx]) {
+        valid[idx] = 0;
+        continue;
+      }
+      on_cluster_accesses[idx] += count - 1;
+      continue;
+    }
+    // off-cluster accesses until the one that invalidates it
+    int64_t to_invalidate =
+        std::max<int64_t>(1, invalidation_ratio * on_cluster_accesses[idx] -
+                                 off_cluster_accesses[idx] + 1);
+    if (to_invalidate <= count) {
+      off_cluster_accesses[idx] += to_invalidate;
+      valid[idx] = 0;
+    } else {
+      off_cluster_accesses[idx] += count;
+    }
+  }
+}
+
+candidate_cluster CandidateTable::get(int idx) const {
+  candidate_cluster candidate;
+  candidate.id = idx;
+  candidate.range = {starts[idx], ends[idx], static_cast<int>(tenants[idx])};
+  candidate.on_cluster_accesses = on_cluster_accesses[idx];
+  candidate.off_cluster_accesses = off_cluster_accesses[idx];
+  candidate.valid = valid[idx] != 0;
+  return candidate;
+}
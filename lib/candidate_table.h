@@ -0,0 +1,90 @@
+#pragma once
+
+#include "ocs_structs.h"
+#include <algorithm>
+#include <cstdint>
+#include <vector>
+
+// Every clustering candidate of a cache, stored as parallel arrays (one
+// 64-bit lane per candidate and field) so the per-access sweep over all
+// candidates streams through contiguous memory and can be vectorized.
+// Candidates are identified by their index, which is also their id.
+class CandidateTable {
+public:
+  size_t size() const { return starts.size(); }
+
+  // Add a valid candidate covering `range` and return its index.
+  int add(const addr_subspace &range);
+
+  // Return the index of the first valid candidate touched by `access`, or -1
+  // if there is none.
+  int findValid(const mem_access &access) const;
+
+  // Count `access` as on-cluster for every valid candidate it touches and as
+  // off-cluster for every other valid candidate, then invalidate candidates
+  // with more than `invalidation_ratio` off-cluster accesses per on-cluster
+  // access. Uses AVX2 if the CPU supports it (see cpu_features.h), a scalar
+  // loop otherwise.
+  void update(const mem_access &access, int invalidation_ratio);
+
+  // If every valid candidate is touched by either all or none of the
+  // accesses within `run`.
+  bool touchedUniformly(const access_run_bounds &run) const;
+
+  // Same as `update` for `count` accesses within `run`, given
+  // `touchedUniformly(run)`: the candidates they touch count all of them as
+  // on-cluster, and every other one counts them as off-cluster until it is
+  // invalidated.
+  void updateRun(const access_run_bounds &run, int64_t count,
+                 int invalidation_ratio);
+
+  void invalidate(int idx) { valid[idx] = 0; }
+
+  bool isValid(int idx) const { return valid[idx] != 0; }
+
+  // A snapshot of the candidate at `idx`.
+  candidate_cluster get(int idx) const;
+
+  // Widen the extent of candidate `idx` that accesses actually touched to
+  // cover `access`.
+  void recordTouch(int idx, const mem_access &access) {
+    touched_starts[idx] = std::min<uint64_t>(touched_starts[idx], access.addr);
+    touched_ends[idx] = std::max<uint64_t>(
+        touched_ends[idx], access.addr + std::max(access.size, 1));
+  }
+
+  // Widen the touched extent of candidate `idx` to cover every access within
+  // `run`.
+  void recordTouch(int idx, const access_run_bounds &run) {
+    touched_starts[idx] = std::min<uint64_t>(touched_starts[idx], run.lo);
+    touched_ends[idx] = std::max<uint64_t>(touched_ends[idx], run.hi);
+  }
+
+  // The touched extent of candidate `idx` (empty if it was never touched).
+  addr_subspace touchedExtent(int idx) const {
+    if (touched_starts[idx] >= touched_ends[idx]) {
+      return {0, 0, static_cast<int>(tenants[idx])};
+    }
+    return {touched_starts[idx], touched_ends[idx],
+            static_cast<int>(tenants[idx])};
+  }
+
+private:
+  void updateScalar(const mem_access &access, int invalidation_ratio,
+                    size_t begin);
+
+  // Update the candidates four at a time, returning the index the scalar
+  // loop takes over from.
+  size_t updateAvx2(const mem_access &access, int invalidation_ratio);
+
+  std::vector<uint64_t> starts;
+  std::vector<uint64_t> ends;
+  std::vector<int64_t> tenants;
+  std::vector<int64_t> on_cluster_accesses;
+  std::vector<int64_t> off_cluster_accesses;
+  // all ones for valid candidates, 0 otherwise
+  std::vector<int64_t> valid;
+  // [touched_starts, touched_ends) bounds the accesses to each candidate
+  std::vector<uint64_t> touched_starts;
+  std::vector<uint64_t> touched_ends;
+};
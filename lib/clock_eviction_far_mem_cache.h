@@ -15,8 +15,17 @@ public:
     return Status::OK;
   }
 
+  [[nodiscard]] Status updateClusteringRun(const mem_access *accesses,
+                                           size_t count,
+                                           const access_run_bounds &run,
+                                           bool is_clustering_candidate,
+                                           size_t *applied) {
+    *applied = count;
+    return Status::OK;
+  }
+
   [[nodiscard]] Status createCandidate(mem_access access,
-                                       candidate_cluster **candidate) {
+                                       addr_subspace *range) {
     return Status::OK;
   }
 
@@ -27,4 +36,6 @@ public:
   std::string getName() {
     return "Pure Far-Memory Cache with clock replacement";
   }
+
+  OCSCache *clone() const override { return cloneAs(*this); }
 };
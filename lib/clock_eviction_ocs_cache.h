@@ -93,11 +93,36 @@ protected:
     return ret_idx;
   }
 
+  void releaseSlot(bool is_ocs_pool) override {
+    BasicOCSCache::releaseSlot(is_ocs_pool);
+    std::vector<bool> *ref_bitvector = is_ocs_pool
+                                           ? &ocs_referenced_bits
+                                           : &backing_store_referenced_bits;
+    size_t *clock_hand =
+        is_ocs_pool ? &ocs_clock_hand : &backing_store_clock_hand;
+    ref_bitvector->pop_back();
+    if (*clock_hand >= ref_bitvector->size()) {
+      *clock_hand = 0;
+    }
+  }
+
   std::string getName() override {
     return "OCS cache with clock replacement for both NFM and backing "
            "stores";
   }
 
+  OCSCache *clone() const override { return cloneAs(*this); }
+
+  void appendStateSignature(std::vector<uint64_t> *signature) const override {
+    BasicOCSCache::appendStateSignature(signature);
+    signature->push_back(ocs_clock_hand);
+    signature->push_back(backing_store_clock_hand);
+    signature->insert(signature->end(), ocs_referenced_bits.begin(),
+                      ocs_referenced_bits.end());
+    signature->insert(signature->end(), backing_store_referenced_bits.begin(),
+                      backing_store_referenced_bits.end());
+  }
+
   size_t ocs_clock_hand = 0;
   size_t backing_store_clock_hand = 0;
   std::vector<bool> ocs_referenced_bits;
@@ -0,0 +1,508 @@
+#include "compressed_trace.h"
+#include "cpu_features.h"
+
+#include <algorithm>
+#include <cstring>
+#include <future>
+#include <iostream>
+
+#if AVX2_PATHS
+#include <immintrin.h>
+#endif
+
+static const char kHeaderMagic[8] = {'O', 'C', 'S', 'T', 'R', 'A', 'C', 'E'};
+static const char kFooterMagic[8] = {'O', 'C', 'S', 'T', 'R', 'I', 'D', 'X'};
+static constexpr uint32_t kVersion = 1;
+static constexpr size_t kFooterBytes = 3 * sizeof(uint64_t) + 8;
+static constexpr size_t kBlockHeaderBytes = 4 * sizeof(uint32_t) + 1;
+
+// code byte: dictionary index in the low bits, then the address base and the
+// store bit
+static constexpr int kMaxDictionarySize = 64;
+static constexpr uint8_t kDictionaryMask = 0x3f;
+static constexpr uint8_t kSecondBaseBit = 0x40;
+static constexpr uint8_t kStoreBit = 0x80;
+
+static uint64_t zigzag(int64_t value) {
+  return (static_cast<uint64_t>(value) << 1) ^ static_cast<uint64_t>(value >> 63);
+}
+
+static int64_t unzigzag(uint64_t value) {
+  return static_cast<int64_t>(value >> 1) ^ -static_cast<int64_t>(value & 1);
+}
+
+static void putVarint(std::string *out, uint64_t value) {
+  while (value >= 0x80) {
+    out->push_back(static_cast<char>(value | 0x80));
+    value >>= 7;
+  }
+  out->push_back(static_cast<char>(value));
+}
+
+template <typename T> static void putRaw(std::string *out, T value) {
+  out->append(reinterpret_cast<const char *>(&value), sizeof(value));
+}
+
+template <typename T> static T getRaw(const char *p) {
+  T value;
+  memcpy(&value, p, sizeof(value));
+  return value;
+}
+
+#if AVX2_PATHS
+// Scan `max` bytes 32 at a time for a continuation bit, setting `*run` to the
+// bytes before it (or the last full group). Returns true if it found one.
+TARGET_AVX2 static bool oneByteRunAvx2(const uint8_t *p, size_t max,
+                                       size_t *run) {
+  for (*run = 0; *run + 32 <= max; *run += 32) {
+    uint32_t continued = _mm256_movemask_epi8(
+        _mm256_loadu_si256(reinterpret_cast<const __m256i *>(p + *run)));
+    if (continued != 0) {
+      *run += __builtin_ctz(continued);
+      return true;
+    }
+  }
+  return false;
+}
+#endif
+
+// The number of bytes (at most `max`) at the start of [p, end) without a
+// continuation bit, i.e. of consecutive one-byte varints.
+static size_t oneByteRun(const uint8_t *p, const uint8_t *end, size_t max) {
+  max = std::min<size_t>(max, end - p);
+  size_t run = 0;
+#if AVX2_PATHS
+  if (useAvx2() && oneByteRunAvx2(p, max, &run)) {
+    return run;
+  }
+#endif
+  // eight bytes at a time otherwise
+  for (; run + 8 <= max; run += 8) {
+    uint64_t word;
+    memcpy(&word, p + run, sizeof(word));
+    uint64_t continued = word & 0x8080808080808080ULL;
+    if (continued != 0) {
+      return run + (__builtin_ctzll(continued) >> 3);
+    }
+  }
+  while (run < max && (p[run] & 0x80) == 0) {
+    run++;
+  }
+  return run;
+}
+
+// Decode `count` varints from [p, end) into `values`. Returns the end of the
+// last one, or nullptr if they don't fit.
+static const uint8_t *decodeVarints(const uint8_t *p, const uint8_t *end,
+                                    size_t count, uint64_t *values) {
+  size_t idx = 0;
+  while (idx < count) {
+    // most deltas fit in a byte, runs of them are copied out in bulk
+    size_t run = oneByteRun(p, end, count - idx);
+    for (size_t offset = 0; offset < run; offset++) {
+      values[idx + offset] = p[offset];
+    }
+    p += run;
+    idx += run;
+    if (idx == count) {
+      break;
+    }
+
+    uint64_t value = 0;
+    for (int shift = 0;; shift += 7) {
+      if (p == end || shift > 63) {
+        return nullptr;
+      }
+      uint8_t byte = *p++;
+      value |= static_cast<uint64_t>(byte & 0x7f) << shift;
+      if ((byte & 0x80) == 0) {
+        break;
+      }
+    }
+    values[idx++] = value;
+  }
+  return p;
+}
+
+OCSCache::Status
+CompressedTraceWriter::open(const std::string &filename,
+                            const std::vector<addr_subspace> &dram_regions,
+                            uint32_t new_block_records) {
+  out.open(filename, std::ios::binary | std::ios::trunc);
+  if (!out) {
+    std::cerr << "Error opening file " << filename << std::endl;
+    return OCSCache::Status::BAD;
+  }
+  block_records = std::max<uint32_t>(new_block_records, 1);
+  records = 0;
+  index.clear();
+  block.clear();
+  dictionary.clear();
+
+  std::string header(kHeaderMagic, sizeof(kHeaderMagic));
+  putRaw<uint32_t>(&header, kVersion);
+  putRaw<uint32_t>(&header, dram_regions.size());
+  for (const addr_subspace &region : dram_regions) {
+    putRaw<uint64_t>(&header, region.addr_start);
+    putRaw<uint64_t>(&header, region.addr_end);
+  }
+  out.write(header.data(), header.size());
+  return out ? OCSCache::Status::OK : OCSCache::Status::BAD;
+}
+
+OCSCache::Status CompressedTraceWriter::append(const mem_access &access) {
+  bool known = std::find(dictionary.begin(), dictionary.end(), access.size) !=
+               dictionary.end();
+  // a full dictionary ends the block early
+  if (!known && dictionary.size() == kMaxDictionarySize) {
+    flushBlock();
+  }
+  if (std::find(dictionary.begin(), dictionary.end(), access.size) ==
+      dictionary.end()) {
+    dictionary.push_back(access.size);
+  }
+  block.push_back(access);
+  records++;
+  if (block.size() == block_records) {
+    flushBlock();
+  }
+  return out ? OCSCache::Status::OK : OCSCache::Status::BAD;
+}
+
+void CompressedTraceWriter::flushBlock() {
+  if (block.empty()) {
+    return;
+  }
+  std::string codes;
+  std::string timestamps;
+  std::string addresses;
+  std::string tenants;
+  long last_timestamp = 0;
+  uintptr_t bases[2] = {0, 0};
+  for (size_t idx = 0; idx < block.size(); idx++) {
+    const mem_access &access = block[idx];
+    uint8_t code =
+        std::find(dictionary.begin(), dictionary.end(), access.size) -
+        dictionary.begin();
+
+    putVarint(&timestamps, zigzag(access.timestamp - last_timestamp));
+    last_timestamp = access.timestamp;
+
+    // relative to the closer of the last two addresses
+    int64_t deltas[2] = {static_cast<int64_t>(access.addr - bases[0]),
+                         static_cast<int64_t>(access.addr - bases[1])};
+    int base = zigzag(deltas[1]) < zigzag(deltas[0]) ? 1 : 0;
+    putVarint(&addresses, zigzag(deltas[base]));
+    bases[base] = access.addr;
+    code |= base ? kSecondBaseBit : 0;
+    code |= access.is_write ? kStoreBit : 0;
+    codes.push_back(static_cast<char>(code));
+
+    if (idx == 0 || block[idx - 1].tenant != access.tenant) {
+      size_t run_end = idx + 1;
+      while (run_end < block.size() && block[run_end].tenant == access.tenant) {
+        run_end++;
+      }
+      putVarint(&tenants, run_end - idx);
+      putVarint(&tenants, access.tenant);
+    }
+  }
+
+  index.push_back(out.tellp());
+  index.push_back(records - block.size());
+  index.push_back(static_cast<uint64_t>(block.front().timestamp));
+
+  std::string header;
+  putRaw<uint32_t>(&header, block.size());
+  putRaw<uint32_t>(&header, timestamps.size());
+  putRaw<uint32_t>(&header, addresses.size());
+  putRaw<uint32_t>(&header, tenants.size());
+  header.push_back(static_cast<char>(dictionary.size()));
+  for (int size : dictionary) {
+    putRaw<int32_t>(&header, size);
+  }
+  for (const std::string *part :
+       {&header, &codes, &timestamps, &addresses, &tenants}) {
+    out.write(part->data(), part->size());
+  }
+  block.clear();
+  dictionary.clear();
+}
+
+OCSCache::Status CompressedTraceWriter::close() {
+  flushBlock();
+  std::string footer;
+  uint64_t index_offset = out.tellp();
+  for (uint64_t field : index) {
+    putRaw<uint64_t>(&footer, field);
+  }
+  putRaw<uint64_t>(&footer, index_offset);
+  putRaw<uint64_t>(&footer, index.size() / 3);
+  putRaw<uint64_t>(&footer, records);
+  footer.append(kFooterMagic, sizeof(kFooterMagic));
+  out.write(footer.data(), footer.size());
+  out.close();
+  return out ? OCSCache::Status::OK : OCSCache::Status::BAD;
+}
+
+bool CompressedTraceDecoder::isCompressed(const char *data, size_t length) {
+  return length >= sizeof(kHeaderMagic) &&
+         memcmp(data, kHeaderMagic, sizeof(kHeaderMagic)) == 0;
+}
+
+OCSCache::Status CompressedTraceDecoder::attach(const char *new_data,
+                                                size_t length) {
+  data = new_data;
+  dram_regions.clear();
+  blocks.clear();
+  decoded.clear();
+  position = 0;
+  next_block = 0;
+
+  size_t header_bytes = sizeof(kHeaderMagic) + 2 * sizeof(uint32_t);
+  if (!isCompressed(data, length) || length < header_bytes + kFooterBytes ||
+      memcmp(data + length - sizeof(kFooterMagic), kFooterMagic,
+             sizeof(kFooterMagic)) != 0) {
+    std::cerr << "Not a complete compressed trace" << std::endl;
+    return OCSCache::Status::BAD;
+  }
+  if (getRaw<uint32_t>(data + sizeof(kHeaderMagic)) != kVersion) {
+    std::cerr << "Unsupported compressed trace version" << std::endl;
+    return OCSCache::Status::BAD;
+  }
+  uint32_t num_regions =
+      getRaw<uint32_t>(data + sizeof(kHeaderMagic) + sizeof(uint32_t));
+  const char *footer = data + length - kFooterBytes;
+  uint64_t index_offset = getRaw<uint64_t>(footer);
+  uint64_t num_blocks = getRaw<uint64_t>(footer + sizeof(uint64_t));
+  records = getRaw<uint64_t>(footer + 2 * sizeof(uint64_t));
+  if (header_bytes + num_regions * 2 * sizeof(uint64_t) > index_offset ||
+      index_offset > length - kFooterBytes ||
+      // bound the count before multiplying so it can't wrap around
+      num_blocks > (length - kFooterBytes - index_offset) /
+                       (3 * sizeof(uint64_t)) ||
+      num_blocks * 3 * sizeof(uint64_t) !=
+          length - kFooterBytes - index_offset) {
+    std::cerr << "Corrupt compressed trace index" << std::endl;
+    return OCSCache::Status::BAD;
+  }
+
+  const char *region = data + header_bytes;
+  for (uint32_t idx = 0; idx < num_regions; idx++) {
+    dram_regions.push_back({getRaw<uint64_t>(region),
+                            getRaw<uint64_t>(region + sizeof(uint64_t))});
+    region += 2 * sizeof(uint64_t);
+  }
+  blocks_end = index_offset;
+  for (uint64_t idx = 0; idx < num_blocks; idx++) {
+    const char *entry = data + index_offset + idx * 3 * sizeof(uint64_t);
+    blocks.push_back({getRaw<uint64_t>(entry),
+                      getRaw<uint64_t>(entry + sizeof(uint64_t)),
+                      getRaw<long>(entry + 2 * sizeof(uint64_t))});
+    if (blocks.back().offset >= blocks_end ||
+        blocks.back().first_record > records ||
+        (idx == 0 && blocks.back().first_record != 0) ||
+        (idx > 0 && (blocks.back().offset <= blocks[idx - 1].offset ||
+                     blocks.back().first_record <
+                         blocks[idx - 1].first_record))) {
+      std::cerr << "Corrupt compressed trace index" << std::endl;
+      return OCSCache::Status::BAD;
+    }
+  }
+  if (blocks.empty() && records != 0) {
+    std::cerr << "Corrupt compressed trace index" << std::endl;
+    return OCSCache::Status::BAD;
+  }
+  // every block holds (at least) a code byte per record, which bounds what
+  // the decoder allocates by the size of the trace
+  for (size_t idx = 0; idx < blocks.size(); idx++) {
+    uint64_t block_end =
+        idx + 1 < blocks.size() ? blocks[idx + 1].offset : blocks_end;
+    if (block_end - blocks[idx].offset < kBlockHeaderBytes ||
+        getRaw<uint32_t>(data + blocks[idx].offset) != blockRecords(idx) ||
+        blockRecords(idx) > block_end - blocks[idx].offset) {
+      std::cerr << "Corrupt compressed trace block " << idx << std::endl;
+      return OCSCache::Status::BAD;
+    }
+  }
+  return OCSCache::Status::OK;
+}
+
+OCSCache::Status CompressedTraceDecoder::decodeBlock(size_t block,
+                                                     mem_access *out) const {
+  const uint8_t *p =
+      reinterpret_cast<const uint8_t *>(data + blocks[block].offset);
+  const uint8_t *end = reinterpret_cast<const uint8_t *>(data + blocks_end);
+  size_t count = blockRecords(block);
+  if (static_cast<size_t>(end - p) < kBlockHeaderBytes ||
+      getRaw<uint32_t>(reinterpret_cast<const char *>(p)) != count) {
+    return OCSCache::Status::BAD;
+  }
+  const char *header = reinterpret_cast<const char *>(p);
+  size_t timestamp_bytes = getRaw<uint32_t>(header + sizeof(uint32_t));
+  size_t address_bytes = getRaw<uint32_t>(header + 2 * sizeof(uint32_t));
+  size_t tenant_bytes = getRaw<uint32_t>(header + 3 * sizeof(uint32_t));
+  size_t dictionary_size = p[4 * sizeof(uint32_t)];
+  p += kBlockHeaderBytes;
+  if (dictionary_size > kMaxDictionarySize ||
+      static_cast<size_t>(end - p) < dictionary_size * sizeof(int32_t) +
+                                         count + timestamp_bytes +
+                                         address_bytes + tenant_bytes) {
+    return OCSCache::Status::BAD;
+  }
+  int32_t dictionary[kMaxDictionarySize];
+  for (size_t idx = 0; idx < dictionary_size; idx++) {
+    dictionary[idx] = getRaw<int32_t>(reinterpret_cast<const char *>(p));
+    p += sizeof(int32_t);
+  }
+  const uint8_t *codes = p;
+  p += count;
+
+  std::vector<uint64_t> values(count);
+  const uint8_t *timestamps_end = p + timestamp_bytes;
+  if (decodeVarints(p, timestamps_end, count, values.data()) !=
+      timestamps_end) {
+    return OCSCache::Status::BAD;
+  }
+  long timestamp = 0;
+  for (size_t idx = 0; idx < count; idx++) {
+    timestamp += unzigzag(values[idx]);
+    out[idx].timestamp = timestamp;
+  }
+  p = timestamps_end;
+
+  const uint8_t *addresses_end = p + address_bytes;
+  if (decodeVarints(p, addresses_end, count, values.data()) != addresses_end) {
+    return OCSCache::Status::BAD;
+  }
+  uintptr_t bases[2] = {0, 0};
+  for (size_t idx = 0; idx < count; idx++) {
+    uint8_t code = codes[idx];
+    if ((code & kDictionaryMask) >= dictionary_size) {
+      return OCSCache::Status::BAD;
+    }
+    uintptr_t &base = bases[(code & kSecondBaseBit) != 0];
+    base += unzigzag(values[idx]);
+    out[idx].addr = base;
+    out[idx].size = dictionary[code & kDictionaryMask];
+    out[idx].is_write = (code & kStoreBit) != 0;
+    out[idx].thread = 0;
+  }
+  p = addresses_end;
+
+  const uint8_t *tenants_end = p + tenant_bytes;
+  size_t filled = 0;
+  while (filled < count) {
+    uint64_t run[2];
+    p = decodeVarints(p, tenants_end, 2, run);
+    if (p == nullptr || run[0] == 0 || run[0] > count - filled) {
+      return OCSCache::Status::BAD;
+    }
+    for (uint64_t idx = 0; idx < run[0]; idx++) {
+      out[filled++].tenant = static_cast<int>(run[1]);
+    }
+  }
+  return p == tenants_end ? OCSCache::Status::OK : OCSCache::Status::BAD;
+}
+
+OCSCache::Status
+CompressedTraceDecoder::decodeAll(uint64_t max_records, int threads,
+                                  std::vector<mem_access> *accesses) const {
+  uint64_t wanted = max_records > 0 ? std::min(max_records, records) : records;
+  size_t num_blocks = 0;
+  while (num_blocks < blocks.size() &&
+         blocks[num_blocks].first_record < wanted) {
+    num_blocks++;
+  }
+  uint64_t decoded_records =
+      num_blocks == 0 ? 0
+                      : blocks[num_blocks - 1].first_record +
+                            blockRecords(num_blocks - 1);
+  size_t start = accesses->size();
+  accesses->resize(start + decoded_records);
+
+  // every thread decodes a contiguous range of blocks in place
+  threads = std::max(1, std::min<int>(threads, num_blocks));
+  std::vector<std::future<OCSCache::Status>> futures;
+  for (int thread = 0; thread < threads; thread++) {
+    size_t first = num_blocks * thread / threads;
+    size_t last = num_blocks * (thread + 1) / threads;
+    futures.push_back(std::async(std::launch::async, [=]() {
+      for (size_t block = first; block < last; block++) {
+        if (decodeBlock(block, accesses->data() + start +
+                                   blocks[block].first_record) !=
+            OCSCache::Status::OK) {
+          std::cerr << "Corrupt compressed trace block " << block << std::endl;
+          return OCSCache::Status::BAD;
+        }
+      }
+      return OCSCache::Status::OK;
+    }));
+  }
+  OCSCache::Status status = OCSCache::Status::OK;
+  for (std::future<OCSCache::Status> &future : futures) {
+    if (future.get() != OCSCache::Status::OK) {
+      status = OCSCache::Status::BAD;
+    }
+  }
+  accesses->resize(start + wanted);
+  return status;
+}
+
+OCSCache::Status CompressedTraceDecoder::seek(uint64_t record) {
+  if (record >= records) {
+    decoded.clear();
+    position = 0;
+    next_block = blocks.size();
+    return record == records ? OCSCache::Status::OK : OCSCache::Status::BAD;
+  }
+  // the last block starting at or before `record`
+  auto block = std::upper_bound(
+      blocks.begin(), blocks.end(), record,
+      [](uint64_t target, const block_entry &entry) {
+        return target < entry.first_record;
+      });
+  size_t idx = block - blocks.begin() - 1;
+  decoded.resize(blockRecords(idx));
+  if (decodeBlock(idx, decoded.data()) != OCSCache::Status::OK) {
+    return OCSCache::Status::BAD;
+  }
+  position = record - blocks[idx].first_record;
+  next_block = idx + 1;
+  return OCSCache::Status::OK;
+}
+
+bool CompressedTraceDecoder::next(mem_access *access) {
+  while (position == decoded.size()) {
+    if (next_block == blocks.size()) {
+      return false;
+    }
+    decoded.resize(blockRecords(next_block));
+    if (decodeBlock(next_block, decoded.data()) != OCSCache::Status::OK) {
+      std::cerr << "Corrupt compressed trace block " << next_block << std::endl;
+      decoded.clear();
+      next_block = blocks.size();
+      return false;
+    }
+    position = 0;
+    next_block++;
+  }
+  *access = decoded[position++];
+  return true;
+}
+
+OCSCache::Status
+writeCompressedTrace(const std::string &filename,
+                     const std::vector<mem_access> &accesses,
+                     const std::vector<addr_subspace> &dram_regions) {
+  CompressedTraceWriter writer;
+  if (writer.open(filename, dram_regions) != OCSCache::Status::OK) {
+    return OCSCache::Status::BAD;
+  }
+  for (const mem_access &access : accesses) {
+    if (writer.append(access) != OCSCache::Status::OK) {
+      return OCSCache::Status::BAD;
+    }
+  }
+  return writer.close();
+}
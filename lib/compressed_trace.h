@@ -0,0 +1,135 @@
+#pragma once
+
+#include "ocs_cache.h"
+#include "ocs_structs.h"
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// A compact binary trace format, several times smaller than the CSV traces
+// and decodable without any compression library. Records are stored in
+// blocks that decode independently of each other, so a reader can seek to a
+// block and several blocks can be decoded in parallel.
+//
+// Layout (little-endian):
+//  - header: the magic `OCSTRACE`, a u32 version, a u32 number of DRAM
+//    regions and a (u64 start, u64 end) pair per region;
+//  - blocks: a u32 record count, u32 timestamp, address and tenant stream
+//    byte counts, a u8 dictionary size and that many i32 access sizes, then
+//    the streams:
+//    one code byte per record (its size's dictionary index, the address
+//    base, and if it's a store), zigzag varint timestamp deltas, zigzag
+//    varint address deltas and (run length, tenant) varint pairs. Deltas
+//    restart at every block;
+//  - index: a (u64 offset, u64 first record, i64 first timestamp) triple per
+//    block;
+//  - footer: u64 index offset, u64 blocks, u64 records and the magic
+//    `OCSTRIDX`.
+//
+// Addresses are encoded as the delta to the closer of the last two addresses,
+// so a trace alternating between the heap and the stack stays cheap.
+
+// Writes accesses in the compressed format.
+class CompressedTraceWriter {
+public:
+  static constexpr uint32_t kDefaultBlockRecords = 64 * 1024;
+
+  [[nodiscard]] OCSCache::Status
+  open(const std::string &filename,
+       const std::vector<addr_subspace> &dram_regions,
+       uint32_t block_records = kDefaultBlockRecords);
+
+  [[nodiscard]] OCSCache::Status append(const mem_access &access);
+
+  // Flush the last block and write the index. Must be called once every
+  // access has been appended.
+  [[nodiscard]] OCSCache::Status close();
+
+private:
+  void flushBlock();
+
+  std::ofstream out;
+  uint32_t block_records = kDefaultBlockRecords;
+  uint64_t records = 0;
+  // (offset, first record, first timestamp) of every block written
+  std::vector<uint64_t> index;
+
+  // the block being built
+  std::vector<mem_access> block;
+  std::vector<int> dictionary;
+};
+
+// Decodes a compressed trace held in memory (e.g. a file mapping owned by
+// `MappedTraceCursor`), either record by record or a block at a time.
+class CompressedTraceDecoder {
+public:
+  // Return if `data` starts like a compressed trace.
+  static bool isCompressed(const char *data, size_t length);
+
+  // Parse the header and block index of the `length` bytes at `data`, which
+  // have to outlive the decoder.
+  [[nodiscard]] OCSCache::Status attach(const char *data, size_t length);
+
+  const std::vector<addr_subspace> &getDramRegions() const {
+    return dram_regions;
+  }
+
+  size_t numBlocks() const { return blocks.size(); }
+  uint64_t numRecords() const { return records; }
+  uint64_t blockFirstRecord(size_t block) const {
+    return blocks[block].first_record;
+  }
+  uint64_t blockRecords(size_t block) const {
+    return (block + 1 < blocks.size() ? blocks[block + 1].first_record
+                                      : records) -
+           blocks[block].first_record;
+  }
+  long blockFirstTimestamp(size_t block) const {
+    return blocks[block].first_timestamp;
+  }
+
+  // Decode block `block` into the `blockRecords(block)` accesses at `out`.
+  [[nodiscard]] OCSCache::Status decodeBlock(size_t block,
+                                             mem_access *out) const;
+
+  // Decode the first `max_records` records (every record if 0) into
+  // `accesses`, spreading the blocks over `threads` threads.
+  [[nodiscard]] OCSCache::Status
+  decodeAll(uint64_t max_records, int threads,
+            std::vector<mem_access> *accesses) const;
+
+  // Position the streaming cursor on record `record`.
+  [[nodiscard]] OCSCache::Status seek(uint64_t record);
+
+  // Decode the next record into `access`. Returns false at the end of the
+  // trace (or if a block is corrupt).
+  bool next(mem_access *access);
+
+private:
+  typedef struct block_entry {
+    uint64_t offset;
+    uint64_t first_record;
+    long first_timestamp;
+  } block_entry;
+
+  const char *data = nullptr;
+  // blocks lie in [data, data + blocks_end)
+  size_t blocks_end = 0;
+  uint64_t records = 0;
+  std::vector<addr_subspace> dram_regions;
+  std::vector<block_entry> blocks;
+
+  // streaming state: the last decoded block, the position in it and the
+  // block to decode after it
+  std::vector<mem_access> decoded;
+  size_t position = 0;
+  size_t next_block = 0;
+};
+
+// Write `accesses` (with `dram_regions`) to `filename` in the compressed
+// format.
+[[nodiscard]] OCSCache::Status
+writeCompressedTrace(const std::string &filename,
+                     const std::vector<mem_access> &accesses,
+                     const std::vector<addr_subspace> &dram_regions);
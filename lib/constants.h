@@ -1,5 +1,6 @@
-// TODO make this a real value lol
 #include <cstdio>
+// Default floor of local DRAM (stack) addresses, only used when the trace
+// neither declares its DRAM regions nor has them detected (see dram_filter.h).
 #define STACK_FLOOR 0x7fa5c7e4ec00
 
 // TODO set this with a bazel config
@@ -7,6 +8,7 @@
 
 #define ENABLE_MULTITHREADING 1
 
+// Default backing store page size (see OCSCache::setPageSize).
 #define PAGE_SIZE 4096
 
 #define PAGE_ALIGN_ADDR(addr) (addr & ~(PAGE_SIZE - 1))
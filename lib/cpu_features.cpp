@@ -0,0 +1,22 @@
+#include "cpu_features.h"
+
+#include <atomic>
+
+static bool cpuSupportsAvx2() {
+#if AVX2_PATHS
+  return __builtin_cpu_supports("avx2");
+#else
+  return false;
+#endif
+}
+
+static std::atomic<bool> &avx2Enabled() {
+  static std::atomic<bool> enabled(cpuSupportsAvx2());
+  return enabled;
+}
+
+bool useAvx2() { return avx2Enabled().load(std::memory_order_relaxed); }
+
+void setAvx2Enabled(bool enabled) {
+  avx2Enabled().store(enabled && cpuSupportsAvx2(), std::memory_order_relaxed);
+}
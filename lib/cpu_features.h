@@ -0,0 +1,20 @@
+#pragma once
+
+// Runtime selection of the AVX2 code paths (candidate updates, DRAM
+// prefiltering and varint scanning). They are compiled for AVX2 with a target
+// attribute and only run if the CPU supports it, so one binary runs anywhere.
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#define AVX2_PATHS 1
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define AVX2_PATHS 0
+#endif
+
+// If the AVX2 paths are taken: the CPU supports AVX2 and they weren't
+// disabled.
+bool useAvx2();
+
+// Disable the AVX2 paths (e.g. to test the scalar loops), or re-enable them
+// where the CPU supports AVX2.
+void setAvx2Enabled(bool enabled);
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "basic_ocs_cache.h"
+#include "ocs_structs.h"
+#include "region_heat.h"
+
+// Clusters by access density instead of growing candidates around misses:
+// every backing store access heats its `pool_size_bytes`-aligned region in a
+// fixed-size `RegionHeatTable`, and once per epoch the regions that are both
+// hot and densely touched are materialized as OCS pools. Recording is O(1)
+// and the epoch's scan of the table is amortized over the epoch's accesses.
+class DensityOCSCache : public BasicOCSCache {
+public:
+  DensityOCSCache(int pool_size_bytes, int max_concurrent_ocs_pools,
+                  int backing_store_cache_size, long epoch_accesses = 4096,
+                  uint32_t min_heat = 100, double min_density = 0.5)
+      : BasicOCSCache(pool_size_bytes, max_concurrent_ocs_pools,
+                      backing_store_cache_size),
+        epoch_accesses(epoch_accesses), min_heat(min_heat),
+        min_density(min_density) {}
+
+  std::string getName() override {
+    return "OCS cache with density clustering and random replacement for both "
+           "NFM and backing stores";
+  }
+
+  OCSCache *clone() const override { return cloneAs(*this); }
+
+  void appendStateSignature(std::vector<uint64_t> *signature) const override {
+    BasicOCSCache::appendStateSignature(signature);
+    signature->push_back(epoch_progress);
+    heat.appendStateSignature(signature);
+  }
+
+protected:
+  [[nodiscard]] Status updateClustering(mem_access access,
+                                        bool is_clustering_candidate) override {
+    if (!heat.configured()) {
+      heat.configure(pool_size_bytes, page_size);
+    }
+    if (is_clustering_candidate) {
+      heat.record(access.tenant, access.addr);
+    }
+    if (++epoch_progress < epoch_accesses) {
+      return Status::OK;
+    }
+    epoch_progress = 0;
+
+    std::vector<hot_region> hot;
+    heat.extractHot(min_heat, min_density, &hot);
+    for (const hot_region &region : hot) {
+      candidate_cluster candidate;
+      candidate.id = -1;
+      candidate.valid = true;
+      candidate.range = {region.addr_start, region.addr_start + pool_size_bytes,
+                         region.tenant};
+      stats.candidates_created++;
+      pool_entry *pool;
+      RETURN_IF_ERROR(
+          createPoolFromCandidate(candidate, &pool, /*is_ocs_node=*/true));
+      stats.candidates_promoted++;
+      // accesses to the region are now served by its pool
+      heat.forget(region.tenant, region.addr_start);
+    }
+    heat.advanceEpoch();
+    return Status::OK;
+  }
+
+  [[nodiscard]] Status updateClusteringRun(const mem_access *accesses,
+                                           size_t count,
+                                           const access_run_bounds &run,
+                                           bool is_clustering_candidate,
+                                           size_t *applied) override {
+    // the access that ends the epoch goes on its own
+    count = std::min<size_t>(count, epoch_accesses - 1 - epoch_progress);
+    if (!heat.configured() || count == 0) {
+      *applied = 0;
+      return Status::OK;
+    }
+    if (is_clustering_candidate) {
+      for (size_t idx = 0; idx < count; idx++) {
+        heat.record(accesses[idx].tenant, accesses[idx].addr);
+      }
+    }
+    epoch_progress += count;
+    *applied = count;
+    return Status::OK;
+  }
+
+  [[nodiscard]] Status createCandidate(mem_access access,
+                                       addr_subspace *range) override {
+    range->tenant = access.tenant;
+    range->addr_start = access.addr / pool_size_bytes * pool_size_bytes;
+    range->addr_end = range->addr_start + pool_size_bytes;
+    return Status::OK;
+  }
+
+  // Candidates are never tracked individually.
+  bool eligibleForMaterialization(const candidate_cluster &candidate) override {
+    return false;
+  }
+
+  long epoch_accesses;
+  uint32_t min_heat;
+  double min_density;
+  long epoch_progress = 0;
+  RegionHeatTable heat;
+};
@@ -0,0 +1,121 @@
+#include "dram_filter.h"
+#include "cpu_features.h"
+
+#include <algorithm>
+#include <cstddef>
+
+#if AVX2_PATHS
+#include <immintrin.h>
+#endif
+
+bool StackRegionDetector::detect(std::vector<addr_subspace> *regions) const {
+  if (pages.empty()) {
+    return false;
+  }
+  std::vector<uintptr_t> sorted(pages.begin(), pages.end());
+  std::sort(sorted.begin(), sorted.end());
+
+  // walk down from the highest touched page until the first big gap
+  size_t floor_idx = sorted.size() - 1;
+  while (floor_idx > 0 && (sorted[floor_idx] - sorted[floor_idx - 1]) *
+                                  kDetectionPageSize <
+                              min_gap_bytes) {
+    floor_idx--;
+  }
+  if (floor_idx == 0) {
+    return false; // one cluster, nothing separates a stack from the heap
+  }
+
+  uintptr_t floor = sorted[floor_idx] * kDetectionPageSize;
+  uintptr_t top = (sorted.back() + 1) * kDetectionPageSize;
+  if (top - floor > max_stack_bytes) {
+    return false;
+  }
+  regions->push_back({floor, UINTPTR_MAX});
+  return true;
+}
+
+static size_t prefilterScalar(const mem_access *accesses, size_t begin,
+                              size_t count,
+                              const std::vector<addr_subspace> &regions,
+                              std::vector<uint32_t> *off_node) {
+  size_t dram = 0;
+  for (size_t idx = begin; idx < count; idx++) {
+    bool in_dram = false;
+    for (const addr_subspace &region : regions) {
+      in_dram |= accesses[idx].addr >= region.addr_start &&
+                 accesses[idx].addr < region.addr_end;
+    }
+    dram += in_dram;
+    if (!in_dram) {
+      off_node->push_back(idx);
+    }
+  }
+  return dram;
+}
+
+#if AVX2_PATHS
+// Filter the accesses four at a time, up to the last full group. Returns the
+// number of DRAM accesses and sets `*end` to the index it stopped at.
+TARGET_AVX2 static size_t
+prefilterAvx2(const mem_access *accesses, size_t count,
+              const std::vector<addr_subspace> &regions,
+              std::vector<uint32_t> *off_node, size_t *end) {
+  size_t idx = 0;
+  size_t dram = 0;
+  static_assert(sizeof(mem_access) % 8 == 0 &&
+                    offsetof(mem_access, addr) == 0,
+                "the gather below assumes 8-byte aligned mem_access records");
+  constexpr long long stride = sizeof(mem_access) / 8;
+  const __m256i gather_index = _mm256_set_epi64x(3 * stride, 2 * stride,
+                                                 stride, 0);
+  // AVX2 only compares signed 64-bit lanes, so flip the sign bit of both
+  // sides to compare addresses as unsigned.
+  const __m256i sign = _mm256_set1_epi64x(INT64_MIN);
+  std::vector<long long> starts, ends;
+  for (const addr_subspace &region : regions) {
+    starts.push_back(static_cast<long long>(region.addr_start) ^ INT64_MIN);
+    ends.push_back(static_cast<long long>(region.addr_end) ^ INT64_MIN);
+  }
+
+  for (; idx + 4 <= count; idx += 4) {
+    __m256i addrs = _mm256_xor_si256(
+        _mm256_i64gather_epi64(
+            reinterpret_cast<const long long *>(&accesses[idx]), gather_index,
+            8),
+        sign);
+    __m256i in_dram = _mm256_setzero_si256();
+    for (size_t region = 0; region < starts.size(); region++) {
+      // start <= addr && addr < end
+      __m256i below_start =
+          _mm256_cmpgt_epi64(_mm256_set1_epi64x(starts[region]), addrs);
+      __m256i below_end =
+          _mm256_cmpgt_epi64(_mm256_set1_epi64x(ends[region]), addrs);
+      in_dram = _mm256_or_si256(in_dram,
+                                _mm256_andnot_si256(below_start, below_end));
+    }
+    int mask = _mm256_movemask_pd(_mm256_castsi256_pd(in_dram));
+    dram += __builtin_popcount(mask);
+    for (int lane = 0; lane < 4; lane++) {
+      if (!(mask & (1 << lane))) {
+        off_node->push_back(idx + lane);
+      }
+    }
+  }
+  *end = idx;
+  return dram;
+}
+#endif
+
+size_t prefilterDramAccesses(const mem_access *accesses, size_t count,
+                             const std::vector<addr_subspace> &regions,
+                             std::vector<uint32_t> *off_node) {
+  size_t idx = 0;
+  size_t dram = 0;
+#if AVX2_PATHS
+  if (useAvx2()) {
+    dram = prefilterAvx2(accesses, count, regions, off_node, &idx);
+  }
+#endif
+  return dram + prefilterScalar(accesses, idx, count, regions, off_node);
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+#include "ocs_structs.h"
+#include <cstdint>
+#include <unordered_set>
+#include <vector>
+
+// Detects the stack from the addresses a trace touches: the stack is the
+// topmost cluster of touched pages, separated from everything below it by a
+// gap of at least `min_gap_bytes` and spanning at most `max_stack_bytes`.
+class StackRegionDetector {
+public:
+  StackRegionDetector(uintptr_t min_gap_bytes = 256ul << 20,
+                      uintptr_t max_stack_bytes = 1ul << 30)
+      : min_gap_bytes(min_gap_bytes), max_stack_bytes(max_stack_bytes) {}
+
+  void observe(uintptr_t addr) { pages.insert(addr / kDetectionPageSize); }
+
+  // Append the detected stack region ([floor, UINTPTR_MAX)) to `regions`.
+  // Returns false (and appends nothing) if no region looks like a stack.
+  bool detect(std::vector<addr_subspace> *regions) const;
+
+private:
+  static constexpr uintptr_t kDetectionPageSize = 4096;
+
+  uintptr_t min_gap_bytes;
+  uintptr_t max_stack_bytes;
+  std::unordered_set<uintptr_t> pages;
+};
+
+// Split `count` accesses into those served by local DRAM (any address in one
+// of `regions`) and off-node accesses. Returns the number of DRAM accesses
+// and appends the indices of the off-node ones, in order, to `off_node`.
+// Uses AVX2 if the CPU supports it (see cpu_features.h), a scalar loop
+// otherwise.
+size_t prefilterDramAccesses(const mem_access *accesses, size_t count,
+                             const std::vector<addr_subspace> &regions,
+                             std::vector<uint32_t> *off_node);
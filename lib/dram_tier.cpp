@@ -0,0 +1,112 @@
+#include "dram_tier.h"
+
+void LocalDramTier::configure(size_t capacity_pages, Policy new_policy) {
+  policy = new_policy;
+  frames.assign(capacity_pages, frame());
+  resident.clear();
+  resident.reserve(capacity_pages);
+  used_frames = 0;
+  clock_hand = 0;
+  head = -1;
+  tail = -1;
+}
+
+void LocalDramTier::unlink(int idx) {
+  frame &f = frames[idx];
+  if (f.prev != -1) {
+    frames[f.prev].next = f.next;
+  } else {
+    head = f.next;
+  }
+  if (f.next != -1) {
+    frames[f.next].prev = f.prev;
+  } else {
+    tail = f.prev;
+  }
+  f.prev = -1;
+  f.next = -1;
+}
+
+void LocalDramTier::pushFront(int idx) {
+  frames[idx].prev = -1;
+  frames[idx].next = head;
+  if (head != -1) {
+    frames[head].prev = idx;
+  }
+  head = idx;
+  if (tail == -1) {
+    tail = idx;
+  }
+}
+
+bool LocalDramTier::lookup(int tenant, uintptr_t page, bool is_write) {
+  auto it = resident.find(keyOf(tenant, page));
+  if (it == resident.end()) {
+    return false;
+  }
+  frame &f = frames[it->second];
+  f.dirty |= is_write;
+  if (policy == LRU) {
+    unlink(it->second);
+    pushFront(it->second);
+  } else {
+    f.referenced = true;
+  }
+  return true;
+}
+
+size_t LocalDramTier::victim() {
+  if (used_frames < frames.size()) {
+    return used_frames++;
+  }
+  if (policy == LRU) {
+    return tail;
+  }
+  while (frames[clock_hand].referenced) {
+    frames[clock_hand].referenced = false;
+    clock_hand = (clock_hand + 1) % frames.size();
+  }
+  size_t idx = clock_hand;
+  clock_hand = (clock_hand + 1) % frames.size();
+  return idx;
+}
+
+bool LocalDramTier::fill(int tenant, uintptr_t page, bool is_write,
+                         bool *evicted_dirty, int *evicted_tenant,
+                         uintptr_t *evicted_page) {
+  size_t idx = victim();
+  frame &f = frames[idx];
+  bool evicted = f.used;
+  *evicted_dirty = evicted && f.dirty;
+  *evicted_tenant = f.tenant;
+  *evicted_page = f.page;
+  if (evicted) {
+    resident.erase(f.key);
+    if (policy == LRU) {
+      unlink(idx);
+    }
+  }
+  f.key = keyOf(tenant, page);
+  f.tenant = tenant;
+  f.page = page;
+  f.used = true;
+  f.dirty = is_write;
+  f.referenced = true;
+  resident[f.key] = idx;
+  if (policy == LRU) {
+    pushFront(idx);
+  }
+  return evicted;
+}
+
+void LocalDramTier::appendStateSignature(
+    std::vector<uint64_t> *signature) const {
+  signature->push_back(clock_hand);
+  for (int idx = head; idx != -1; idx = frames[idx].next) {
+    signature->push_back(idx);
+  }
+  for (const frame &f : frames) {
+    signature->push_back(f.key);
+    signature->push_back(f.used | f.dirty << 1 | f.referenced << 2);
+  }
+}
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+// A page-granular local DRAM cache of fixed capacity, in front of the OCS
+// and far memory tiers. Pages are identified by tenant and page number.
+class LocalDramTier {
+public:
+  enum Policy { LRU, CLOCK };
+
+  // Hold up to `capacity_pages` pages (0 disables the tier), replaced with
+  // `policy`.
+  void configure(size_t capacity_pages, Policy policy);
+
+  bool enabled() const { return !frames.empty(); }
+  size_t capacity() const { return frames.size(); }
+  static std::string policyName(Policy policy) {
+    return policy == LRU ? "lru" : "clock";
+  }
+
+  // If `page` is resident, without touching it.
+  bool contains(int tenant, uintptr_t page) const {
+    return resident.count(keyOf(tenant, page)) > 0;
+  }
+
+  // Look up `page`, touching it (and dirtying it, for stores) if present.
+  bool lookup(int tenant, uintptr_t page, bool is_write);
+
+  // Bring `page` in after a miss. Returns true if a page was evicted to make
+  // room, with `*evicted_dirty` telling if it has to be written back and
+  // `*evicted_tenant` and `*evicted_page` which page it was.
+  bool fill(int tenant, uintptr_t page, bool is_write, bool *evicted_dirty,
+            int *evicted_tenant, uintptr_t *evicted_page);
+
+  // Append the resident pages (see `OCSCache::appendStateSignature`).
+  void appendStateSignature(std::vector<uint64_t> *signature) const;
+
+private:
+  typedef struct frame {
+    uint64_t key = 0;
+    int tenant = 0;
+    uintptr_t page = 0;
+    bool used = false;
+    bool dirty = false;
+    bool referenced = false;
+    // LRU list neighbours, most recently used at `head`
+    int prev = -1;
+    int next = -1;
+  } frame;
+
+  static uint64_t keyOf(int tenant, uintptr_t page) {
+    return (static_cast<uint64_t>(tenant) << 52) ^ page;
+  }
+  size_t victim();
+  void unlink(int idx);
+  void pushFront(int idx);
+
+  Policy policy = LRU;
+  std::vector<frame> frames;
+  std::unordered_map<uint64_t, int> resident;
+  size_t used_frames = 0;
+  size_t clock_hand = 0;
+  int head = -1;
+  int tail = -1;
+};
@@ -0,0 +1,175 @@
+#pragma once
+
+#include "liberal_clock_ocs_cache.h"
+#include "ocs_structs.h"
+#include <algorithm>
+#include <random>
+
+// Picks between random and clock replacement at runtime by dueling them:
+// each policy replaces on a tag-only shadow of the OCS and backing store
+// slots, fed every pool access. A saturating counter per cache tracks which
+// shadow misses more, and the real slots (the followers) replace with
+// whichever policy is currently winning.
+//
+// The caches are fully associative with a handful of slots, so leader sets
+// carved out of the real slots would evict each other's pools; the shadows
+// stand in for them.
+class DuelingOCSCache : public LiberalClockOCSCache {
+public:
+  enum Policy { RANDOM, CLOCK };
+
+  DuelingOCSCache(int pool_size_bytes, int max_concurrent_ocs_pools,
+                  int backing_store_cache_size)
+      : LiberalClockOCSCache(pool_size_bytes, max_concurrent_ocs_pools,
+                             backing_store_cache_size) {}
+
+  std::string getName() override {
+    return "OCS cache with liberal clustering and dueling random/clock "
+           "replacement for both NFM and backing stores";
+  }
+
+  OCSCache *clone() const override { return cloneAs(*this); }
+
+  void setSeed(uint64_t new_seed) override {
+    LiberalClockOCSCache::setSeed(new_seed);
+    shadow_rng.seed(shadowSeed(new_seed));
+  }
+
+  void appendStateSignature(std::vector<uint64_t> *signature) const override {
+    LiberalClockOCSCache::appendStateSignature(signature);
+    for (int is_ocs_pool = 0; is_ocs_pool < 2; is_ocs_pool++) {
+      signature->push_back(psel[is_ocs_pool]);
+      for (const shadow_slots &shadow : shadows[is_ocs_pool]) {
+        signature->push_back(shadow.hand);
+        signature->insert(signature->end(), shadow.tags.begin(),
+                          shadow.tags.end());
+        signature->insert(signature->end(), shadow.referenced.begin(),
+                          shadow.referenced.end());
+      }
+    }
+  }
+
+  // The policy the OCS (or backing store) slots currently replace with.
+  Policy followerPolicy(bool is_ocs_pool) const {
+    return psel[is_ocs_pool] > kPselMax / 2 ? CLOCK : RANDOM;
+  }
+
+  static constexpr int kPselMax = 1023;
+
+protected:
+  typedef struct shadow_slots {
+    std::vector<uint64_t> tags;
+    std::vector<bool> referenced;
+    size_t hand = 0;
+  } shadow_slots;
+
+  // Pools are told apart by their address, so a shadow tag stays the same
+  // when a pool is materialized again.
+  static uint64_t tagOf(const pool_entry *pool) {
+    return (static_cast<uint64_t>(pool->range.tenant) << 52) ^
+           pool->range.addr_start;
+  }
+
+  // The random shadow's seed for cache seed `seed`, distinct from it so the
+  // shadow doesn't replay the followers' victims.
+  static uint64_t shadowSeed(uint64_t seed) {
+    return seed ^ 0x9e3779b97f4a7c15ULL;
+  }
+
+  // Access `tag` in `shadow` of `capacity` slots under `policy`, returning
+  // if it hit.
+  bool accessShadow(shadow_slots *shadow, uint64_t tag, size_t capacity,
+                    Policy policy) {
+    // hits don't set reference bits, as on the clock followers (only pools
+    // brought in start out referenced)
+    auto it = std::find(shadow->tags.begin(), shadow->tags.end(), tag);
+    if (it != shadow->tags.end()) {
+      return true;
+    }
+    if (capacity == 0) {
+      return false;
+    }
+    if (shadow->tags.size() < capacity) {
+      shadow->tags.push_back(tag);
+      shadow->referenced.push_back(true);
+      return false;
+    }
+    size_t victim;
+    if (policy == RANDOM) {
+      victim = shadow_rng() % shadow->tags.size();
+    } else {
+      shadow->hand %= shadow->tags.size();
+      while (shadow->referenced[shadow->hand]) {
+        shadow->referenced[shadow->hand] = false;
+        shadow->hand = (shadow->hand + 1) % shadow->tags.size();
+      }
+      victim = shadow->hand;
+      shadow->hand = (shadow->hand + 1) % shadow->tags.size();
+    }
+    shadow->tags[victim] = tag;
+    shadow->referenced[victim] = true;
+    return false;
+  }
+
+  void recordPoolAccesses(const std::vector<pool_entry *> &nodes,
+                          long repeats) override {
+    // once a pass hits every shadow, repeating it changes nothing
+    for (long repeat = 0; repeat < repeats; repeat++) {
+      bool all_hit = true;
+      for (const pool_entry *node : nodes) {
+        all_hit &= recordShadowAccess(node);
+      }
+      if (all_hit) {
+        break;
+      }
+    }
+  }
+
+  // Access `node` in both of its tier's shadows, returning if both hit.
+  bool recordShadowAccess(const pool_entry *node) {
+    bool is_ocs_pool = node->is_ocs_pool;
+    size_t capacity =
+        is_ocs_pool ? max_ocs_cache_size : max_backing_store_cache_size;
+    Policy before = followerPolicy(is_ocs_pool);
+    int &counter = psel[is_ocs_pool];
+    // random missing pushes the counter up, towards clock
+    bool random_hit = accessShadow(&shadows[is_ocs_pool][RANDOM], tagOf(node),
+                                   capacity, RANDOM);
+    if (!random_hit) {
+      counter = std::min(counter + 1, kPselMax);
+    }
+    bool clock_hit = accessShadow(&shadows[is_ocs_pool][CLOCK], tagOf(node),
+                                  capacity, CLOCK);
+    if (!clock_hit) {
+      counter = std::max(counter - 1, 0);
+    }
+    if (followerPolicy(is_ocs_pool) != before) {
+      stats.replacement_policy_switches++;
+    }
+    return random_hit && clock_hit;
+  }
+
+  [[nodiscard]] size_t indexToReplace(bool is_ocs_replacement) override {
+    std::vector<pool_entry *> &cache =
+        is_ocs_replacement ? cached_ocs_pools : cached_backing_store_pools;
+    size_t max_cache_size =
+        is_ocs_replacement ? max_ocs_cache_size : max_backing_store_cache_size;
+    if (followerPolicy(is_ocs_replacement) == CLOCK ||
+        cache.size() < max_cache_size) {
+      return ClockOCSCache::indexToReplace(is_ocs_replacement);
+    }
+
+    size_t victim = rng() % max_cache_size;
+    // the incoming pool starts out referenced, as under clock
+    (is_ocs_replacement ? ocs_referenced_bits
+                        : backing_store_referenced_bits)[victim] = true;
+    return victim;
+  }
+
+  // indexed by `is_ocs_pool`, then by `Policy`
+  shadow_slots shadows[2][2];
+  // start halfway, on clock
+  int psel[2] = {kPselMax / 2 + 1, kPselMax / 2 + 1};
+  // kept apart from `rng` so the shadows don't perturb the real slots
+  std::mt19937_64 shadow_rng{shadowSeed(0)};
+};
@@ -18,29 +18,25 @@ public:
 protected:
   [[nodiscard]] Status updateClustering(mem_access access,
                                         bool is_clustering_candidate) override {
-    candidate_cluster *candidate = nullptr;
+    int candidate = -1;
     RETURN_IF_ERROR(is_clustering_candidate
                         ? getOrCreateCandidate(access, &candidate)
                         : getCandidateIfExists(access, &candidate));
-    for (size_t idx = 0; idx < candidates.size(); idx++) {
-      auto candidate = candidates[idx];
-      if (candidate->valid) {
-        if (accessInRange(candidate->range, access)) {
-          candidate->on_cluster_accesses++;
-        } else {
-          candidate->off_cluster_accesses++;
-        }
-        if (candidate->off_cluster_accesses >
-            2 * candidate->on_cluster_accesses) {
-          candidate->valid = false;
-        }
-      }
-    }
+    candidates.update(access, /*invalidation_ratio=*/2);
 
     RETURN_IF_ERROR(materializeIfEligible(candidate));
     return Status::OK;
   }
 
+  [[nodiscard]] Status updateClusteringRun(const mem_access *accesses,
+                                           size_t count,
+                                           const access_run_bounds &run,
+                                           bool is_clustering_candidate,
+                                           size_t *applied) override {
+    return updateCandidatesRun(accesses, count, run, is_clustering_candidate,
+                               /*invalidation_ratio=*/2, applied);
+  }
+
   bool eligibleForMaterialization(const candidate_cluster &candidate) override {
     return candidate.valid && candidate.on_cluster_accesses > 100 &&
            candidate.on_cluster_accesses > 2 * candidate.off_cluster_accesses;
@@ -51,4 +47,6 @@ protected:
            "NFM and backing "
            "stores";
   }
+
+  OCSCache *clone() const override { return cloneAs(*this); }
 };
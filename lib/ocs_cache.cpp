@@ -6,60 +6,228 @@
 #include <cstdlib>
 #include <exception>
 #include <iostream>
+#include <set>
 #include <sstream>
+#include <tuple>
+#include <unordered_map>
 
 OCSCache::OCSCache(int pool_size_bytes,
                    int max_concurrent_ocs_pools, int backing_store_cache_size)
     : pool_size_bytes(pool_size_bytes),
       max_ocs_cache_size(max_concurrent_ocs_pools),
-      max_backing_store_cache_size(backing_store_cache_size) {}
+      max_backing_store_cache_size(backing_store_cache_size), rng(seed) {}
 
 OCSCache::~OCSCache() {
-  for (candidate_cluster *c : candidates) {
-    free(c);
-  }
   for (pool_entry *p : pools) {
     free(p);
   }
 }
 
-// an access touches a `range` if either
-// its beginning or end is within the `range`, or the `access` spans beyond both
-// endpoints of `range`.
-bool OCSCache::accessInRange(addr_subspace &range, mem_access access) {
-  return (access.addr >= range.addr_start && access.addr < range.addr_end) ||
-         (access.addr + access.size >= range.addr_start &&
-          access.addr + access.size < range.addr_end) ||
-         (access.addr <= range.addr_start &&
-          access.addr + access.size >= range.addr_end);
+void OCSCache::ownPoolCopies() {
+  std::unordered_map<const pool_entry *, pool_entry *> copies;
+  for (pool_entry *&pool : pools) {
+    pool_entry *copy = (pool_entry *)malloc(sizeof(pool_entry));
+    *copy = *pool;
+    copies[pool] = copy;
+    pool = copy;
+  }
+  for (pool_entry *&pool : cached_ocs_pools) {
+    pool = copies[pool];
+  }
+  for (pool_entry *&pool : cached_backing_store_pools) {
+    pool = copies[pool];
+  }
+  for (pool_entry *&pool : ocs_pool_index) {
+    pool = copies[pool];
+  }
+  for (auto &page : backing_page_index) {
+    page.second = copies[page.second];
+  }
+  if (prefetcher) {
+    prefetcher.reset(prefetcher->clone());
+  }
+}
 
-  ;
+// Append the identity of `pool` (not its id, which depends on history).
+static void appendPoolSignature(const pool_entry *pool,
+                                std::vector<uint64_t> *signature) {
+  signature->push_back(pool->range.addr_start);
+  signature->push_back(pool->range.addr_end);
+  signature->push_back((static_cast<uint64_t>(pool->range.tenant) << 4) |
+                       (pool->dirty << 3) | (pool->prefetched << 2) |
+                       (pool->valid << 1) | pool->is_ocs_pool);
+  if (pool->num_intervals > 1) {
+    signature->push_back(pool->num_intervals);
+    for (int idx = 0; idx < pool->num_intervals; idx++) {
+      signature->push_back(pool->intervals[idx].addr_start);
+      signature->push_back(pool->intervals[idx].addr_end);
+    }
+  }
 }
 
-[[nodiscard]] OCSCache::Status
-OCSCache::getCandidateIfExists(mem_access access,
-                               candidate_cluster **candidate) {
-  *candidate = nullptr;
-  for (candidate_cluster *cand : candidates) {
-    if (accessInRange(cand->range, access) && cand->valid) {
-      *candidate = cand;
-      break;
+void OCSCache::appendStateSignature(std::vector<uint64_t> *signature) const {
+  signature->push_back(cached_ocs_pools.size());
+  for (const pool_entry *pool : cached_ocs_pools) {
+    appendPoolSignature(pool, signature);
+  }
+  signature->push_back(cached_backing_store_pools.size());
+  for (const pool_entry *pool : cached_backing_store_pools) {
+    appendPoolSignature(pool, signature);
+  }
+  for (const pool_entry *pool : pools) {
+    if (pool->valid && pool->is_ocs_pool) {
+      appendPoolSignature(pool, signature);
+      if (dematerialization.epoch_accesses > 0) {
+        pool_entry decayed = *pool;
+        decayPoolHeat(&decayed);
+        signature->push_back(decayed.heat);
+        signature->push_back(decayed.cold_epochs);
+      }
+    }
+  }
+  signature->push_back(pool_heat_epoch);
+  if (slot_partitioning.epoch_accesses > 0) {
+    signature->push_back(max_ocs_cache_size);
+    signature->push_back(ocs_epoch_ghost_hits);
+    signature->insert(signature->end(), ocs_ghosts.begin(), ocs_ghosts.end());
+    signature->push_back(max_backing_store_cache_size);
+    signature->push_back(backing_store_epoch_ghost_hits);
+    signature->insert(signature->end(), backing_store_ghosts.begin(),
+                      backing_store_ghosts.end());
+  }
+  if (prefetcher) {
+    prefetcher->appendStateSignature(signature);
+  }
+  dram_tier.appendStateSignature(signature);
+  for (size_t idx = 0; idx < candidates.size(); idx++) {
+    if (candidates.isValid(idx)) {
+      candidate_cluster candidate = candidates.get(idx);
+      signature->push_back(candidate.range.addr_start);
+      signature->push_back(candidate.range.addr_end);
+      signature->push_back(candidate.range.tenant);
+      signature->push_back(candidate.on_cluster_accesses);
+      signature->push_back(candidate.off_cluster_accesses);
+      if (pool_packing) {
+        addr_subspace touched = candidates.touchedExtent(idx);
+        signature->push_back(touched.addr_start);
+        signature->push_back(touched.addr_end);
+      }
+    }
+  }
+}
+
+void OCSCache::mergeBackingPagesFrom(const OCSCache &earlier) {
+  std::set<std::tuple<int, uintptr_t, uintptr_t>> known_pages;
+  std::vector<const pool_entry *> ocs_pools;
+  for (const pool_entry *pool : pools) {
+    if (pool->is_ocs_pool) {
+      if (pool->valid) {
+        ocs_pools.push_back(pool);
+      }
+    } else {
+      known_pages.insert(
+          {pool->range.tenant, pool->range.addr_start, pool->range.addr_end});
     }
   }
 
+  for (const pool_entry *page : earlier.pools) {
+    if (!page->valid || page->is_ocs_pool ||
+        known_pages.count({page->range.tenant, page->range.addr_start,
+                           page->range.addr_end}) > 0) {
+      continue;
+    }
+    bool covered = std::any_of(
+        ocs_pools.begin(), ocs_pools.end(), [page](const pool_entry *ocs) {
+          return ocs->range.tenant == page->range.tenant &&
+                 ocs->covers(page->range.addr_start, page->range.addr_end);
+        });
+    if (!covered) {
+      pool_entry *copy = (pool_entry *)malloc(sizeof(pool_entry));
+      *copy = *page;
+      copy->id = allocatePoolId();
+      copy->in_cache = false;
+      copy->dirty = false;
+      copy->prefetched = false;
+      addPool(copy);
+    }
+  }
+}
+
+void OCSCache::restoreStats(const perf_stats &counters,
+                            const std::vector<perf_stats> &tenant_counters,
+                            const std::vector<perf_stats> &thread_counters) {
+  // the pool aggregates describe this cache's pools, keep them
+  perf_stats pool_totals = stats;
+  stats = counters;
+  stats.ocs_pool_mem_usage = pool_totals.ocs_pool_mem_usage;
+  stats.backing_store_mem_usage = pool_totals.backing_store_mem_usage;
+  stats.num_ocs_pools = pool_totals.num_ocs_pools;
+  stats.num_backing_store_pools = pool_totals.num_backing_store_pools;
+  tenant_stats = tenant_counters;
+  thread_stats = thread_counters;
+  attribution_start = stats;
+  attributed_tenant = -1;
+}
+
+// an access touches a `range` if the bytes it covers,
+// [addr, addr + size), overlap the range (zero-sized accesses are treated as
+// touching a single byte). Ranges in other tenants' address spaces are never
+// touched.
+bool OCSCache::accessInRange(addr_subspace &range, mem_access access) {
+  if (range.tenant != access.tenant) { // different address spaces
+    return false;
+  }
+  return access.addr < range.addr_end &&
+         access.addr + std::max(access.size, 1) > range.addr_start;
+}
+
+[[nodiscard]] OCSCache::Status
+OCSCache::getCandidateIfExists(mem_access access, int *candidate) {
+  *candidate = candidates.findValid(access);
+  if (*candidate != -1) {
+    candidates.recordTouch(*candidate, access);
+  }
   return Status::OK;
 }
 
 [[nodiscard]] OCSCache::Status
 OCSCache::getPoolNodes(mem_access access,
                        std::vector<pool_entry *> *parent_pools) {
-  // Iterate through the pool nodes backwards, since OCS nodes are appended to
-  // the end and we want to prioritize them
-  for (auto pool = pools.rbegin(); pool != pools.rend(); ++pool) {
-    if (accessInRange((*pool)->range, access) && (*pool)->valid) {
+  switch (page_size) {
+  case 4096:
+    return getPoolNodesForPageSize<4096>(access, parent_pools);
+  case 64 * 1024:
+    return getPoolNodesForPageSize<64 * 1024>(access, parent_pools);
+  case 2 * 1024 * 1024:
+    return getPoolNodesForPageSize<2 * 1024 * 1024>(access, parent_pools);
+  default:
+    return getPoolNodesForPageSize<0>(access, parent_pools);
+  }
+}
+
+template <uintptr_t kPageSize>
+[[nodiscard]] OCSCache::Status
+OCSCache::getPoolNodesForPageSize(mem_access access,
+                                  std::vector<pool_entry *> *parent_pools) {
+  // a constant (so alignment is a mask) unless the size isn't specialized
+  const uintptr_t page_bytes = kPageSize != 0 ? kPageSize : page_size;
+
+  // OCS pools first, newest first
+  for (auto pool = ocs_pool_index.rbegin(); pool != ocs_pool_index.rend();
+       ++pool) {
+    if ((*pool)->touches(access)) {
       parent_pools->push_back((*pool));
     }
   }
+  // then the pages the access touches
+  uintptr_t access_end = access.addr + std::max(access.size, 1);
+  for (auto page = backing_page_index.lower_bound(
+           {access.tenant, access.addr & ~(page_bytes - 1)});
+       page != backing_page_index.end() && page->first.first == access.tenant &&
+       page->first.second < access_end;
+       ++page) {
+    parent_pools->push_back(page->second);
+  }
 
   auto uncovered_range = findUncoveredRanges(access, parent_pools);
 
@@ -74,11 +242,12 @@ OCSCache::getPoolNodes(mem_access access,
     // TODO this is bad because it might allocate overlapping pages, but I think
     // it should only do that if the system was already incorrect?
     for (addr_subspace &range : uncovered_range) {
-      for (uintptr_t base = PAGE_ALIGN_ADDR(range.addr_start);
-           base < range.addr_end; base += PAGE_SIZE) {
+      for (uintptr_t base = range.addr_start & ~(page_bytes - 1);
+           base < range.addr_end; base += page_bytes) {
         candidate_cluster new_fm_page;
-        new_fm_page.range.addr_start = PAGE_ALIGN_ADDR(base);
-        new_fm_page.range.addr_end = PAGE_ALIGN_ADDR(base) + PAGE_SIZE;
+        new_fm_page.range.addr_start = base;
+        new_fm_page.range.addr_end = base + page_bytes;
+        new_fm_page.range.tenant = access.tenant;
 
         pool_entry *tmp_pool_pointer = nullptr;
 
@@ -91,6 +260,16 @@ OCSCache::getPoolNodes(mem_access access,
     }
   }
 
+  // Keep the order independent of when pages happened to be materialized, so
+  // caches in equivalent states replace pages in the same order.
+  auto first_page = std::stable_partition(
+      parent_pools->begin(), parent_pools->end(),
+      [](const pool_entry *pool) { return pool->is_ocs_pool; });
+  std::sort(first_page, parent_pools->end(),
+            [](const pool_entry *a, const pool_entry *b) {
+              return a->range.addr_start < b->range.addr_start;
+            });
+
   DEBUG_LOG("getPoolNodes got " << parent_pools->size() << " nodes\n");
 
   return Status::OK;
@@ -127,7 +306,40 @@ OCSCache::poolNodesInCache(std::vector<pool_entry *> *nodes,
     // TODO this needs to take size of access, we're ignoring alignment issues
     // rn
     mem_access access, bool *hit) {
+  if (addrAlwaysInDRAM(access)) {
+    DEBUG_LOG("DRAM hit");
+    recordDramHits(access.tenant, access.thread, 1);
+    *hit = true;
+    return Status::OK;
+  }
+  return handleOffNodeAccess(access, access.addr / page_size, hit);
+}
+
+[[nodiscard]] OCSCache::Status
+OCSCache::handleOffNodeAccess(mem_access access, uintptr_t first_page,
+                              bool *hit) {
+  // the DRAM tier serves the access only if it holds every page it touches
+  uintptr_t last_page =
+      (access.addr + std::max(access.size, 1) - 1) / page_size;
+  bool tier_hit = dram_tier.enabled();
+  for (uintptr_t page = first_page; tier_hit && page <= last_page; page++) {
+    tier_hit = dram_tier.contains(access.tenant, page);
+  }
+  if (tier_hit) {
+    for (uintptr_t page = first_page; page <= last_page; page++) {
+      dram_tier.lookup(access.tenant, page, access.is_write);
+    }
+    recordDramHits(access.tenant, access.thread, 1);
+    stats.dram_tier_hits++;
+    *hit = true;
+    return Status::OK;
+  }
+
   *hit = false;
+  attributeTo(access.tenant, access.thread);
+  reconfiguration_now = reconfiguration.delay_in_accesses
+                            ? stats.off_node_loads + stats.off_node_stores
+                            : access.timestamp;
 
   bool is_dram_hit = false;
   std::vector<bool> node_hits;
@@ -144,6 +356,27 @@ OCSCache::poolNodesInCache(std::vector<pool_entry *> *nodes,
                                            // uncached backing store node/ocs
                                            // node
 
+  if (!is_dram_hit) {
+    recordPoolAccesses(associated_nodes, 1);
+  }
+
+  // backing store misses, and first uses of prefetched pages, train the
+  // prefetcher
+  std::vector<pool_entry *> prefetch_triggers;
+  for (size_t idx = 0; idx < node_hits.size(); idx++) {
+    pool_entry *node = associated_nodes[idx];
+    if (node->is_ocs_pool) {
+      continue;
+    }
+    if (!node_hits[idx]) {
+      prefetch_triggers.push_back(node);
+    } else if (node->prefetched) {
+      stats.prefetch_hits++;
+      node->prefetched = false;
+      prefetch_triggers.push_back(node);
+    }
+  }
+
   bool is_clustering_candidate = false;
 
   // TODO find a way to show the number of non-stack DRAM accesses going down
@@ -164,7 +397,11 @@ OCSCache::poolNodesInCache(std::vector<pool_entry *> *nodes,
                     "hit on a node that's not marked as in cache!");
         if (associated_node->is_ocs_pool) {
           DEBUG_LOG("ocs hit on node " << associated_node->id);
-          stats.ocs_pool_hits++;
+          // unless it falls back to far memory below
+          if (!reconfigurationPending(associated_node) ||
+              reconfiguration.stall_pending) {
+            stats.ocs_pool_hits++;
+          }
         } else {
           DEBUG_LOG("backing store hit on node " << associated_node->id);
           stats.backing_store_hits++;
@@ -214,22 +451,330 @@ OCSCache::poolNodesInCache(std::vector<pool_entry *> *nodes,
     RETURN_IF_ERROR(runReplacement(access, associated_nodes));
   }
 
+  // OCS pools whose port is still reconfiguring can't serve the access yet
+  bool touches_pending = false;
+  for (pool_entry *node : associated_nodes) {
+    if (!node->is_ocs_pool) {
+      continue;
+    }
+    if (dematerialization.epoch_accesses > 0) {
+      decayPoolHeat(node);
+      if (node->heat < UINT32_MAX) {
+        node->heat++;
+      }
+    }
+    if (!reconfigurationPending(node)) {
+      node->served = true;
+      continue;
+    }
+    touches_pending = true;
+    if (reconfiguration.stall_pending) {
+      stats.reconfiguration_stall += node->ready_at - reconfiguration_now;
+      node->served = true;
+    } else {
+      stats.reconfiguration_fallbacks++;
+    }
+  }
+  if (!touches_pending &&
+      std::any_of(cached_ocs_pools.begin(), cached_ocs_pools.end(),
+                  [this](const pool_entry *pool) {
+                    return reconfigurationPending(pool);
+                  })) {
+    stats.reconfiguration_overlapped_accesses++;
+  }
+
+  // every node of the access is cached now, stores dirty them (or the DRAM
+  // tier's copies of the pages, which dirty them once they're evicted)
+  if (access.is_write) {
+    stats.off_node_stores++;
+    for (pool_entry *node : associated_nodes) {
+      node->dirty |= !dram_tier.enabled();
+    }
+  } else {
+    stats.off_node_loads++;
+  }
+
+  RETURN_IF_ERROR(
+      prefetchAfter(access.tenant, prefetch_triggers, associated_nodes));
+
   // we are committing to not updating a cluster once it's been chosen, for
   // now.
   RETURN_IF_ERROR(updateClustering(access, is_clustering_candidate));
 
   stats.accesses += addrAlwaysInDRAM(access) ? 1 : associated_nodes.size();
 
+  // the pages are now cached in local DRAM, each missing one displacing
+  // another
+  if (dram_tier.enabled()) {
+    stats.dram_tier_misses++;
+    for (uintptr_t page = first_page; page <= last_page; page++) {
+      if (dram_tier.lookup(access.tenant, page, access.is_write)) {
+        continue;
+      }
+      bool evicted_dirty = false;
+      int evicted_tenant;
+      uintptr_t evicted_page;
+      if (dram_tier.fill(access.tenant, page, access.is_write, &evicted_dirty,
+                         &evicted_tenant, &evicted_page)) {
+        stats.dram_tier_evictions++;
+      }
+      if (evicted_dirty) {
+        stats.dram_tier_writebacks++;
+        stats.dram_tier_writeback_bytes += page_size;
+        dirtyCachedPageNodes(evicted_tenant, evicted_page);
+      }
+    }
+  }
+
+  if (dematerialization.epoch_accesses > 0 &&
+      (stats.off_node_loads + stats.off_node_stores) %
+              dematerialization.epoch_accesses ==
+          0) {
+    dematerializeColdPools();
+  }
+  if (slot_partitioning.epoch_accesses > 0 &&
+      (stats.off_node_loads + stats.off_node_stores) %
+              slot_partitioning.epoch_accesses ==
+          0) {
+    repartitionSlots();
+  }
+
+  maybeCompactPools();
+
+  return Status::OK;
+}
+
+[[nodiscard]] OCSCache::Status
+OCSCache::handleOffNodeRun(const mem_access *accesses, size_t count,
+                           uintptr_t first_page, long *hits) {
+  // failed bulk steps scan the rest of the run, so they back off
+  size_t retry_at = 0;
+  size_t backoff = 1;
+  size_t idx = 0;
+  while (idx < count) {
+    bool hit = false;
+    RETURN_IF_ERROR(handleOffNodeAccess(accesses[idx], first_page, &hit));
+    *hits += hit;
+    idx++;
+    if (idx < retry_at || idx == count) {
+      continue;
+    }
+    size_t applied = 0;
+    RETURN_IF_ERROR(
+        applyRepeatedHits(accesses + idx, count - idx, first_page, &applied));
+    *hits += applied;
+    idx += applied;
+    // a bulk step that stopped short (at an epoch boundary, or a candidate
+    // about to be materialized) resumes right after the next access
+    if (applied > 0) {
+      retry_at = 0;
+      backoff = 1;
+    } else {
+      retry_at = idx + backoff;
+      backoff *= 2;
+    }
+  }
+  return Status::OK;
+}
+
+[[nodiscard]] OCSCache::Status
+OCSCache::applyRepeatedHits(const mem_access *accesses, size_t count,
+                            uintptr_t first_page, size_t *applied) {
+  *applied = 0;
+  const mem_access &first = accesses[0];
+
+  // the previous access left the page in the DRAM tier, which serves the rest
+  if (dram_tier.enabled()) {
+    bool any_write =
+        std::any_of(accesses, accesses + count,
+                    [](const mem_access &access) { return access.is_write; });
+    if (!dram_tier.lookup(first.tenant, first_page, any_write)) {
+      return Status::OK;
+    }
+    recordDramHits(first.tenant, first.thread, count);
+    stats.dram_tier_hits += count;
+    *applied = count;
+    return Status::OK;
+  }
+
+  // the access ending a dematerialization or repartitioning epoch goes on its
+  // own
+  long off_node_accesses = stats.off_node_loads + stats.off_node_stores;
+  for (long epoch_accesses :
+       {dematerialization.epoch_accesses, slot_partitioning.epoch_accesses}) {
+    if (epoch_accesses > 0) {
+      count = std::min<size_t>(
+          count, epoch_accesses - 1 - off_node_accesses % epoch_accesses);
+    }
+  }
+  if (count == 0) {
+    return Status::OK;
+  }
+
+  access_run_bounds run;
+  long earliest = accesses[0].timestamp;
+  for (size_t idx = 0; idx < count; idx++) {
+    run.add(accesses[idx]);
+    earliest = std::min(earliest, accesses[idx].timestamp);
+  }
+  DEBUG_CHECK(run.lo / page_size == first_page &&
+                  (run.hi - 1) / page_size == first_page,
+              "run of accesses crosses a page boundary");
+
+  // every access has the same nodes: the OCS pools touched by all of them
+  // (newest first, as `getPoolNodes` orders them), then the page, which has
+  // to exist unless one pool covers all of them
+  std::vector<pool_entry *> nodes;
+  bool covered = false;
+  for (auto pool = ocs_pool_index.rbegin(); pool != ocs_pool_index.rend();
+       ++pool) {
+    if ((*pool)->range.tenant != run.tenant) {
+      continue;
+    }
+    bool touched_by_all = false;
+    bool touched_by_none = true;
+    for (int idx = 0; idx < (*pool)->num_intervals; idx++) {
+      const addr_interval &interval = (*pool)->intervals[idx];
+      touched_by_all |= run.allTouch(interval.addr_start, interval.addr_end);
+      touched_by_none &= run.noneTouch(interval.addr_start, interval.addr_end);
+    }
+    if (!touched_by_all && !touched_by_none) {
+      return Status::OK;
+    }
+    if (touched_by_all) {
+      nodes.push_back(*pool);
+      covered |= (*pool)->covers(run.lo, run.hi);
+    }
+  }
+  auto page = backing_page_index.find({run.tenant, first_page * page_size});
+  if (page != backing_page_index.end()) {
+    nodes.push_back(page->second);
+  } else if (!covered) {
+    return Status::OK;
+  }
+  if (nodes.empty()) {
+    return Status::OK;
+  }
+
+  std::vector<bool> in_cache;
+  RETURN_IF_ERROR(poolNodesInCache(&nodes, &in_cache));
+  if (!std::all_of(in_cache.begin(), in_cache.end(),
+                   [](bool val) { return val; })) {
+    return Status::OK;
+  }
+  bool is_clustering_candidate = false;
+  for (const pool_entry *node : nodes) {
+    // the first use of a prefetched page trains the prefetcher
+    if (!node->is_ocs_pool && node->prefetched) {
+      return Status::OK;
+    }
+    is_clustering_candidate |= !node->is_ocs_pool;
+  }
+  // nor may any OCS port still be reconfiguring when the accesses are made
+  long now = reconfiguration.delay_in_accesses ? off_node_accesses : earliest;
+  if (std::any_of(
+          cached_ocs_pools.begin(), cached_ocs_pools.end(),
+          [now](const pool_entry *pool) { return pool->ready_at > now; })) {
+    return Status::OK;
+  }
+
+  size_t run_length = 0;
+  RETURN_IF_ERROR(updateClusteringRun(accesses, count, run,
+                                      is_clustering_candidate, &run_length));
+  if (run_length == 0) {
+    return Status::OK;
+  }
+
+  attributeTo(first.tenant, first.thread);
+  recordPoolAccesses(nodes, run_length);
+  long writes =
+      std::count_if(accesses, accesses + run_length,
+                    [](const mem_access &access) { return access.is_write; });
+  for (pool_entry *node : nodes) {
+    if (node->is_ocs_pool) {
+      stats.ocs_pool_hits += run_length;
+      if (dematerialization.epoch_accesses > 0) {
+        decayPoolHeat(node);
+        node->heat = std::min<uint64_t>(UINT32_MAX, node->heat + run_length);
+      }
+      node->served = true;
+    } else {
+      stats.backing_store_hits += run_length;
+    }
+    node->dirty |= writes > 0;
+  }
+  stats.off_node_stores += writes;
+  stats.off_node_loads += run_length - writes;
+  stats.accesses += run_length * nodes.size();
+  reconfiguration_now = reconfiguration.delay_in_accesses
+                            ? off_node_accesses + run_length - 1
+                            : accesses[run_length - 1].timestamp;
+
+  maybeCompactPools();
+
+  *applied = run_length;
+  return Status::OK;
+}
+
+[[nodiscard]] OCSCache::Status OCSCache::updateCandidatesRun(
+    const mem_access *accesses, size_t count, const access_run_bounds &run,
+    bool is_clustering_candidate, int invalidation_ratio, size_t *applied) {
+  *applied = 0;
+  if (!candidates.touchedUniformly(run)) {
+    return Status::OK;
+  }
+  int candidate = candidates.findValid(accesses[0]);
+  if (candidate == -1 && is_clustering_candidate) {
+    // creating the candidate is left to `updateClustering`
+    return Status::OK;
+  }
+
+  if (candidate != -1) {
+    candidate_cluster after = candidates.get(candidate);
+    // the candidate has to stay the accesses' candidate throughout
+    if (after.off_cluster_accesses >
+        static_cast<long>(invalidation_ratio) *
+            (after.on_cluster_accesses + 1)) {
+      return Status::OK;
+    }
+    // and the access that makes it eligible goes on its own
+    size_t before_eligible = 0;
+    while (before_eligible < count) {
+      after.on_cluster_accesses++;
+      if (eligibleForMaterialization(after)) {
+        break;
+      }
+      before_eligible++;
+    }
+    if (before_eligible == 0) {
+      return Status::OK;
+    }
+    access_run_bounds touched = run;
+    if (before_eligible < count) {
+      touched = access_run_bounds();
+      for (size_t idx = 0; idx < before_eligible; idx++) {
+        touched.add(accesses[idx]);
+      }
+    }
+    candidates.recordTouch(candidate, touched);
+    count = before_eligible;
+  }
+
+  // candidates are told apart by all of `run`, which the accesses applied
+  // touch the same way
+  candidates.updateRun(run, count, invalidation_ratio);
+  *applied = count;
   return Status::OK;
 }
 
 [[nodiscard]] OCSCache::Status
-OCSCache::getOrCreateCandidate(mem_access access,
-                               candidate_cluster **candidate) {
+OCSCache::getOrCreateCandidate(mem_access access, int *candidate) {
   RETURN_IF_ERROR(getCandidateIfExists(access, candidate));
-  if (*candidate == nullptr) { // candidate doesn't exist, create one
-    RETURN_IF_ERROR(createCandidate(access, candidate));
-    candidates.push_back(*candidate);
+  if (*candidate == -1) { // candidate doesn't exist, create one
+    addr_subspace range;
+    RETURN_IF_ERROR(createCandidate(access, &range));
+    *candidate = candidates.add(range);
+    candidates.recordTouch(*candidate, access);
   }
   return Status::OK;
 }
@@ -237,68 +782,48 @@ OCSCache::getOrCreateCandidate(mem_access access,
 OCSCache::Status
 OCSCache::createPoolFromCandidate(const candidate_cluster &candidate,
                                   pool_entry **pool, bool is_ocs_node) {
+  return createPool(candidate.range.tenant,
+                    {{candidate.range.addr_start, candidate.range.addr_end}},
+                    pool, is_ocs_node);
+}
+
+OCSCache::Status
+OCSCache::createPool(int tenant, const std::vector<addr_interval> &intervals,
+                     pool_entry **pool, bool is_ocs_node) {
+  DEBUG_CHECK(!intervals.empty() &&
+                  intervals.size() <= static_cast<size_t>(kMaxPoolIntervals),
+              "pools hold 1 to kMaxPoolIntervals intervals");
 
   pool_entry *new_pool_entry = (pool_entry *)malloc(sizeof(pool_entry));
 
   new_pool_entry->valid = true;
   new_pool_entry->in_cache = false;
+  new_pool_entry->dirty = false;
+  new_pool_entry->prefetched = false;
+  new_pool_entry->ready_at = 0;
+  new_pool_entry->served = false;
+  new_pool_entry->heat = 0;
+  new_pool_entry->heat_epoch = pool_heat_epoch;
+  new_pool_entry->cold_epochs = 0;
   new_pool_entry->is_ocs_pool = is_ocs_node;
-  new_pool_entry->id = pools.size();
-  new_pool_entry->range.addr_start = candidate.range.addr_start;
-  new_pool_entry->range.addr_end = candidate.range.addr_end;
+  new_pool_entry->id = allocatePoolId();
+  new_pool_entry->range.addr_start = intervals.front().addr_start;
+  new_pool_entry->range.addr_end = intervals.back().addr_end;
+  new_pool_entry->range.tenant = tenant;
+  new_pool_entry->num_intervals = intervals.size();
+  std::copy(intervals.begin(), intervals.end(), new_pool_entry->intervals);
 
   if (is_ocs_node) {
     DEBUG_LOG("materializing OCS pool with address range "
               << new_pool_entry->range.addr_start << ":"
-              << new_pool_entry->range.addr_end << std::endl);
-
-    // invalidate only backing store pages that fall completely within the range
-    // covered by this pool. This may be overly safe
-
-    // Round up start address to the nearest page alignment
-    uintptr_t firstPage =
-        (new_pool_entry->range.addr_start + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
-
-    // Iterate (and invalidate) every backing store pool that falls completely
-    // within this new pool's range
-    // note that this might materialize new backing nodes just to invalidate
-    // them, but that's fine since it won't affect performance stats. Although
-    // it's wasteful of cycles...
-    for (uintptr_t current = firstPage;
-         current < new_pool_entry->range.addr_end; current += PAGE_SIZE) {
-      mem_access a;
-      a.size = 1;
-      a.addr = current;
-      std::vector<pool_entry *> nodes;
-      nodes.clear();
-
-      // this may over-eagerly invalidate backing but they'll get materialized
-      // again
-      RETURN_IF_ERROR(getPoolNodes(a, &nodes));
-
-      // size 1, shouldn't have multiple matches
-      DEBUG_CHECK(nodes.size() == 1,
-                  "access of size 1 should only have one matching node! ");
-
-      pool_entry *node = nodes[0];
-
-      if (!node->is_ocs_pool) {
-        // TODO figure out how to align candidated to not overlap with
-        // materialized ocs nodes
-        DEBUG_CHECK(!node->is_ocs_pool,
-                    "overlapping coverage of OCS pool ranges: "
-                        << *new_pool_entry << "\nis trying to invalidate"
-                        << *node);
-        DEBUG_LOG("Invalidating Backing store node: "
-                  << node->range
-                  << " due to it being covered by newly materialized OCS pool "
-                     "with id: "
-                  << new_pool_entry->id << std::endl);
-        node->valid = false;
-
-        // TODO actually kick it out
-        node->in_cache = false;
-      }
+              << new_pool_entry->range.addr_end << " ("
+              << new_pool_entry->num_intervals << " intervals)" << std::endl);
+
+    // invalidate only backing store pages that fall completely within the
+    // intervals covered by this pool.
+    for (const addr_interval &interval : intervals) {
+      stats.backing_store_bytes_displaced += invalidateBackingPages(
+          tenant, interval.addr_start, interval.addr_end);
     }
 
   } else {
@@ -307,20 +832,24 @@ OCSCache::createPoolFromCandidate(const candidate_cluster &candidate,
               << new_pool_entry->range.addr_end << std::endl);
   }
 
-  pools.push_back(new_pool_entry);
+  addPool(new_pool_entry);
   *pool = new_pool_entry;
 
   return Status::OK;
 }
 
 [[nodiscard]] OCSCache::Status
-OCSCache::materializeIfEligible(candidate_cluster *candidate) {
+OCSCache::materializeIfEligible(int candidate) {
 
-  if (candidate != nullptr && eligibleForMaterialization(*candidate)) {
+  if (candidate != -1 &&
+      eligibleForMaterialization(candidates.get(candidate))) {
+    if (pool_packing) {
+      return materializePacked(candidate);
+    }
     pool_entry *throwaway;
-    RETURN_IF_ERROR(
-        createPoolFromCandidate(*candidate, &throwaway, /*is_ocs_node=*/true));
-    candidate->valid = false;
+    RETURN_IF_ERROR(createPoolFromCandidate(candidates.get(candidate),
+                                            &throwaway, /*is_ocs_node=*/true));
+    candidates.invalidate(candidate);
     // TODO invalidate backing stores here or somehow figure out how to
     // prioritize ocs pools over backing pool nodes
     stats.candidates_promoted++;
@@ -328,14 +857,106 @@ OCSCache::materializeIfEligible(candidate_cluster *candidate) {
   return Status::OK;
 }
 
+[[nodiscard]] OCSCache::Status OCSCache::materializePacked(int candidate) {
+  candidate_cluster primary = candidates.get(candidate);
+  const uintptr_t pool_bytes = pool_size_bytes;
+
+  // page-aligned touched extent of candidate `idx`, empty if none
+  auto extentOf = [this](int idx) -> addr_interval {
+    addr_subspace touched = candidates.touchedExtent(idx);
+    if (touched.size() == 0) {
+      return {0, 0};
+    }
+    return {touched.addr_start & ~(page_size - 1),
+            (touched.addr_end + page_size - 1) & ~(page_size - 1)};
+  };
+  auto overlaps = [](const addr_interval &a, const addr_interval &b) {
+    return a.addr_start < b.addr_end && b.addr_start < a.addr_end;
+  };
+
+  std::vector<addr_interval> intervals;
+  addr_interval extent = extentOf(candidate);
+  if (extent.addr_end - extent.addr_start == 0 ||
+      extent.addr_end - extent.addr_start >= pool_bytes) {
+    // nothing to pack alongside it, promote it as is
+    intervals.push_back({primary.range.addr_start, primary.range.addr_end});
+  } else {
+    intervals.push_back(extent);
+    uintptr_t used = extent.addr_end - extent.addr_start;
+
+    // other candidates at least a quarter as hot, hottest first
+    std::vector<std::pair<long, int>> hot;
+    for (size_t idx = 0; idx < candidates.size(); idx++) {
+      if (static_cast<int>(idx) == candidate || !candidates.isValid(idx)) {
+        continue;
+      }
+      candidate_cluster other = candidates.get(idx);
+      if (other.range.tenant == primary.range.tenant &&
+          4 * other.on_cluster_accesses >= primary.on_cluster_accesses) {
+        hot.push_back({-other.on_cluster_accesses, idx});
+      }
+    }
+    std::sort(hot.begin(), hot.end());
+
+    // first fit, skipping what is already offloaded
+    for (const auto &[neg_accesses, idx] : hot) {
+      if (intervals.size() == static_cast<size_t>(kMaxPoolIntervals)) {
+        break;
+      }
+      addr_interval other = extentOf(idx);
+      uintptr_t bytes = other.addr_end - other.addr_start;
+      if (bytes == 0 || used + bytes > pool_bytes) {
+        continue;
+      }
+      bool taken = std::any_of(
+          intervals.begin(), intervals.end(),
+          [&](const addr_interval &chosen) { return overlaps(chosen, other); });
+      for (const pool_entry *pool : ocs_pool_index) {
+        for (int i = 0; !taken && i < pool->num_intervals; i++) {
+          taken = pool->range.tenant == primary.range.tenant &&
+                  overlaps(pool->intervals[i], other);
+        }
+      }
+      if (taken) {
+        continue;
+      }
+      intervals.push_back(other);
+      used += bytes;
+      candidates.invalidate(idx);
+      stats.candidates_packed++;
+    }
+
+    // sorted, with adjacent intervals joined
+    std::sort(intervals.begin(), intervals.end(),
+              [](const addr_interval &a, const addr_interval &b) {
+                return a.addr_start < b.addr_start;
+              });
+    size_t joined = 0;
+    for (size_t idx = 1; idx < intervals.size(); idx++) {
+      if (intervals[idx].addr_start == intervals[joined].addr_end) {
+        intervals[joined].addr_end = intervals[idx].addr_end;
+      } else {
+        intervals[++joined] = intervals[idx];
+      }
+    }
+    intervals.resize(joined + 1);
+  }
+
+  pool_entry *throwaway;
+  RETURN_IF_ERROR(createPool(primary.range.tenant, intervals, &throwaway,
+                             /*is_ocs_node=*/true));
+  candidates.invalidate(candidate);
+  stats.candidates_promoted++;
+  return Status::OK;
+}
+
 std::ostream &operator<<(std::ostream &oss, const OCSCache &entry) {
   // Adding information about cached_pools
 
   oss << "Candidates:\n";
-  for (const candidate_cluster *candidate : entry.candidates) {
-    // Assuming candidate_cluster has a method to get a string representation
-    if (candidate->valid || DEBUG) {
-      oss << *candidate << "\n";
+  for (size_t idx = 0; idx < entry.candidates.size(); idx++) {
+    if (entry.candidates.isValid(idx) || DEBUG) {
+      oss << entry.candidates.get(idx) << "\n";
     }
   }
 
@@ -393,6 +1014,9 @@ OCSCache::runReplacement(mem_access access,
 
     // Only replace nodes not in cache.
     if (!parent_pool->in_cache) {
+      if (slot_partitioning.epoch_accesses > 0) {
+        recordGhostHit(parent_pool);
+      }
       size_t max_cache_size = parent_pool->is_ocs_pool
                                   ? max_ocs_cache_size
                                   : max_backing_store_cache_size;
@@ -401,6 +1025,10 @@ OCSCache::runReplacement(mem_access access,
                                              : cached_backing_store_pools;
 
       size_t idx_to_evict = indexToReplace(parent_pool->is_ocs_pool);
+      if (parent_pool->is_ocs_pool && tenant_fair_share &&
+          idx_to_evict < cache.size()) {
+        idx_to_evict = arbitrateOCSVictim(parent_pool, idx_to_evict);
+      }
 
       DEBUG_LOG("index to evict is " << idx_to_evict);
       DEBUG_CHECK(idx_to_evict < max_cache_size,
@@ -415,19 +1043,81 @@ OCSCache::runReplacement(mem_access access,
 
       } else {
         DEBUG_LOG("evicting node " << cache[idx_to_evict]->id)
-        cache[idx_to_evict]->in_cache = false;
+        evict(cache[idx_to_evict]);
+        rememberEvicted(cache[idx_to_evict]);
         cache[idx_to_evict] = parent_pool;
       }
 
       DEBUG_CHECK(cache.size() <= max_cache_size,
                   "cache was bigger than max_cache_size after replacement");
       parent_pool->in_cache = true;
+      if (parent_pool->is_ocs_pool) {
+        parent_pool->ready_at = reconfiguration_now + reconfiguration.delay;
+        parent_pool->served = false;
+      }
     }
   }
 
   return Status::OK;
 }
 
+size_t OCSCache::arbitrateOCSVictim(const pool_entry *incoming,
+                                    size_t policy_victim) {
+  settleAttribution();
+
+  // tenant ids index the counts below, there is nothing to arbitrate for a
+  // pool without one
+  int requester = incoming->range.tenant;
+  int victim_tenant = cached_ocs_pools[policy_victim]->range.tenant;
+  if (requester < 0 || victim_tenant < 0) {
+    return policy_victim;
+  }
+
+  // Count the OCS slots held by each tenant that currently uses the OCS
+  std::vector<int> slots_held(tenant_stats.size() + 1, 0);
+  if (static_cast<size_t>(requester) >= slots_held.size()) {
+    slots_held.resize(requester + 1, 0);
+  }
+  for (const pool_entry *pool : cached_ocs_pools) {
+    if (pool->range.tenant < 0) {
+      continue;
+    }
+    if (static_cast<size_t>(pool->range.tenant) >= slots_held.size()) {
+      slots_held.resize(pool->range.tenant + 1, 0);
+    }
+    slots_held[pool->range.tenant]++;
+  }
+
+  int active_tenants = 0;
+  for (size_t tenant = 0; tenant < slots_held.size(); tenant++) {
+    bool uses_ocs =
+        slots_held[tenant] > 0 || static_cast<int>(tenant) == requester ||
+        (tenant < tenant_stats.size() &&
+         tenant_stats[tenant].ocs_pool_hits +
+                 tenant_stats[tenant].ocs_reconfigurations >
+             0);
+    active_tenants += uses_ocs ? 1 : 0;
+  }
+  // every active tenant is guaranteed at least one slot if the budget allows
+  int fair_share = std::max(max_ocs_cache_size / active_tenants, 1);
+
+  if (victim_tenant == requester || slots_held[requester] < fair_share ||
+      slots_held[victim_tenant] > fair_share) {
+    // the requester is under its share, or the policy's victim comes from a
+    // tenant that is over its share: take the policy's choice.
+    return policy_victim;
+  }
+
+  // The requester is at (or over) its share and would take a slot from a
+  // tenant within its share, so make it evict one of its own pools instead.
+  for (size_t idx = 0; idx < cached_ocs_pools.size(); idx++) {
+    if (cached_ocs_pools[idx]->range.tenant == requester) {
+      return idx;
+    }
+  }
+  return policy_victim;
+}
+
 [[nodiscard]] size_t OCSCache::indexToReplace(bool is_ocs_replacement) {
   // random eviction
   std::vector<pool_entry *> &cache =
@@ -438,7 +1128,7 @@ OCSCache::runReplacement(mem_access access,
   if (cache.size() < max_cache_size) {
     return cache.size();
   }
-  return random() % max_cache_size;
+  return rng() % max_cache_size;
 }
 
 [[nodiscard]] OCSCache::Status
@@ -464,29 +1154,389 @@ OCSCache::accessInCacheOrDram(mem_access access,
   return Status::OK;
 }
 
-perf_stats OCSCache::getPerformanceStats() {
-  return getPerformanceStats(false);
+void OCSCache::recordDramHits(int tenant, int thread, long count) {
+  attributeTo(tenant, thread);
+  stats.dram_hits += count;
+  stats.accesses += count;
 }
 
-perf_stats OCSCache::getPerformanceStats(bool summary) {
-  // reset stats before setting them
-  stats.ocs_pool_mem_usage = 0;
-  stats.backing_store_mem_usage = 0;
-  stats.num_ocs_pools = 0;
-  stats.num_backing_store_pools = 0;
+void OCSCache::attributeTo(int tenant, int thread) {
+  if (tenant == attributed_tenant &&
+      (!thread_attribution || thread == attributed_thread)) {
+    return;
+  }
+  settleAttribution();
+  attributed_tenant = tenant;
+  attributed_thread = thread;
+}
+
+void OCSCache::settleAttribution() {
+  if (attributed_tenant >= 0) {
+    if (static_cast<size_t>(attributed_tenant) >= tenant_stats.size()) {
+      tenant_stats.resize(attributed_tenant + 1);
+    }
+    tenant_stats[attributed_tenant].accumulateDelta(attribution_start, stats);
+    if (thread_attribution) {
+      if (static_cast<size_t>(attributed_thread) >= thread_stats.size()) {
+        thread_stats.resize(attributed_thread + 1);
+      }
+      thread_stats[attributed_thread].accumulateDelta(attribution_start, stats);
+    }
+  }
+  attribution_start = stats;
+}
+
+std::vector<perf_stats> OCSCache::getThreadPerformanceStats() {
+  settleAttribution();
+  return thread_stats;
+}
+
+std::vector<perf_stats> OCSCache::getTenantPerformanceStats() {
+  settleAttribution();
+  std::vector<perf_stats> per_tenant = tenant_stats;
+  for (perf_stats &tenant : per_tenant) {
+    tenant.ocs_pool_mem_usage = 0;
+    tenant.backing_store_mem_usage = 0;
+    tenant.num_ocs_pools = 0;
+    tenant.num_backing_store_pools = 0;
+  }
 
   for (const pool_entry *entry : pools) {
-    if (entry->valid) {
+    if (entry->valid &&
+        static_cast<size_t>(entry->range.tenant) < per_tenant.size()) {
+      perf_stats &tenant = per_tenant[entry->range.tenant];
       if (entry->is_ocs_pool) {
-        stats.ocs_pool_mem_usage += entry->size();
-        stats.num_ocs_pools++;
+        tenant.ocs_pool_mem_usage += entry->size();
+        tenant.num_ocs_pools++;
       } else {
-        stats.backing_store_mem_usage += entry->size();
-        stats.num_backing_store_pools++;
+        tenant.backing_store_mem_usage += entry->size();
+        tenant.num_backing_store_pools++;
+      }
+    }
+  }
+  return per_tenant;
+}
+
+perf_stats OCSCache::getPerformanceStats() {
+  return getPerformanceStats(false);
+}
+
+[[nodiscard]] OCSCache::Status
+OCSCache::prefetchAfter(int tenant, const std::vector<pool_entry *> &triggers,
+                        const std::vector<pool_entry *> &pinned) {
+  if (prefetcher == nullptr || triggers.empty() ||
+      max_backing_store_cache_size == 0) {
+    return Status::OK;
+  }
+
+  std::vector<uintptr_t> pages;
+  for (const pool_entry *trigger : triggers) {
+    prefetcher->train(tenant, trigger->range.addr_start, page_size, &pages);
+  }
+
+  for (uintptr_t page : pages) {
+    mem_access prefetch_access = {page, 1, tenant};
+    if (addrAlwaysInDRAM(prefetch_access)) {
+      continue;
+    }
+    std::vector<pool_entry *> nodes;
+    RETURN_IF_ERROR(getPoolNodes(prefetch_access, &nodes));
+    // pages under an OCS pool are the OCS' business
+    if (nodes.empty() || nodes[0]->is_ocs_pool || nodes[0]->in_cache) {
+      continue;
+    }
+
+    pool_entry *target = nodes[0];
+    // don't evict what the current access just used, ask the policy again
+    auto is_pinned = [&pinned](const pool_entry *pool) {
+      return std::find(pinned.begin(), pinned.end(), pool) != pinned.end();
+    };
+    size_t victim = indexToReplace(/*is_ocs_replacement=*/false);
+    for (int retry = 0; victim < cached_backing_store_pools.size() &&
+                        is_pinned(cached_backing_store_pools[victim]) &&
+                        retry < max_backing_store_cache_size;
+         retry++) {
+      victim = indexToReplace(/*is_ocs_replacement=*/false);
+    }
+    if (victim < cached_backing_store_pools.size()) {
+      if (is_pinned(cached_backing_store_pools[victim])) {
+        continue;
       }
+      DEBUG_LOG("prefetch evicting node "
+                << cached_backing_store_pools[victim]->id);
+      evict(cached_backing_store_pools[victim]);
+      rememberEvicted(cached_backing_store_pools[victim]);
+      cached_backing_store_pools[victim] = target;
+    } else {
+      cached_backing_store_pools.push_back(target);
+    }
+    target->in_cache = true;
+    target->prefetched = true;
+    stats.prefetches_issued++;
+    stats.prefetch_bytes += target->size();
+  }
+  return Status::OK;
+}
+
+long OCSCache::invalidateBackingPages(int tenant, uintptr_t addr_start,
+                                      uintptr_t addr_end) {
+  // Round up start address to the nearest page alignment
+  uintptr_t first_page = (addr_start + page_size - 1) & ~(page_size - 1);
+  long displaced_bytes = 0;
+  auto page = backing_page_index.lower_bound({tenant, first_page});
+  while (page != backing_page_index.end() && page->first.first == tenant &&
+         page->second->range.addr_end <= addr_end) {
+    pool_entry *node = page->second;
+    DEBUG_LOG("Invalidating Backing store node: "
+              << node->range << " due to it being covered by [" << addr_start
+              << ", " << addr_end << ")" << std::endl);
+    node->valid = false;
+    // TODO actually kick it out
+    if (node->in_cache) {
+      evict(node); // its dirty data has to reach far memory first
+    }
+    accountPool(*node, -1);
+    invalid_pools++;
+    displaced_bytes += node->size();
+    page = backing_page_index.erase(page);
+  }
+  return displaced_bytes;
+}
+
+void OCSCache::dirtyCachedPageNodes(int tenant, uintptr_t page) {
+  mem_access page_access = {page * page_size, static_cast<int>(page_size)};
+  page_access.tenant = tenant;
+  for (pool_entry *pool : ocs_pool_index) {
+    if (pool->in_cache && pool->touches(page_access)) {
+      pool->dirty = true;
+    }
+  }
+  auto backing_page = backing_page_index.find({tenant, page * page_size});
+  if (backing_page != backing_page_index.end() &&
+      backing_page->second->in_cache) {
+    backing_page->second->dirty = true;
+  }
+}
+
+void OCSCache::decayPoolHeat(pool_entry *pool) const {
+  uint32_t elapsed = pool_heat_epoch - pool->heat_epoch;
+  pool->heat = elapsed >= 32 ? 0 : pool->heat >> elapsed;
+  pool->heat_epoch = pool_heat_epoch;
+}
+
+void OCSCache::dematerializeColdPools() {
+  std::vector<pool_entry *> cold;
+  for (pool_entry *pool : ocs_pool_index) {
+    decayPoolHeat(pool);
+    pool->cold_epochs =
+        pool->heat < dematerialization.cold_heat ? pool->cold_epochs + 1 : 0;
+    // a pool has to stay cold for a while, so it isn't dematerialized by a
+    // short lull right after being materialized
+    if (pool->cold_epochs >= dematerialization.cold_epochs) {
+      cold.push_back(pool);
+    }
+  }
+  for (pool_entry *pool : cold) {
+    dematerialize(pool);
+  }
+  pool_heat_epoch++;
+}
+
+void OCSCache::dematerialize(pool_entry *pool) {
+  DEBUG_LOG("dematerializing cold OCS pool " << *pool);
+  if (pool->in_cache) {
+    evict(pool); // its dirty data has to be flushed first
+  }
+  // it may still sit in an OCS slot until it's replaced
+  pool->served = true;
+  pool->valid = false;
+  accountPool(*pool, -1);
+  invalid_pools++;
+  ocs_pool_index.erase(
+      std::find(ocs_pool_index.begin(), ocs_pool_index.end(), pool));
+  stats.ocs_pools_dematerialized++;
+  stats.dematerialized_bytes += pool->size();
+}
+
+void OCSCache::rememberEvicted(const pool_entry *pool) {
+  // invalidated pools can still sit in a slot, but they're gone for good and
+  // would only push live ones out of the ghost tags
+  if (slot_partitioning.epoch_accesses <= 0 || !pool->valid) {
+    return;
+  }
+  std::deque<pool_id> &ghosts =
+      pool->is_ocs_pool ? ocs_ghosts : backing_store_ghosts;
+  ghosts.push_front(pool->id);
+  if (ghosts.size() > static_cast<size_t>(slot_partitioning.ghost_slots)) {
+    ghosts.pop_back();
+  }
+}
+
+void OCSCache::recordGhostHit(const pool_entry *pool) {
+  std::deque<pool_id> &ghosts =
+      pool->is_ocs_pool ? ocs_ghosts : backing_store_ghosts;
+  auto ghost = std::find(ghosts.begin(), ghosts.end(), pool->id);
+  if (ghost == ghosts.end()) {
+    return;
+  }
+  ghosts.erase(ghost);
+  if (pool->is_ocs_pool) {
+    stats.ocs_ghost_hits++;
+    ocs_epoch_ghost_hits++;
+  } else {
+    stats.backing_store_ghost_hits++;
+    backing_store_epoch_ghost_hits++;
+  }
+}
+
+void OCSCache::repartitionSlots() {
+  long ocs_gain = ocs_epoch_ghost_hits;
+  long backing_store_gain = backing_store_epoch_ghost_hits;
+  ocs_epoch_ghost_hits = 0;
+  backing_store_epoch_ghost_hits = 0;
+
+  if (ocs_gain > backing_store_gain &&
+      max_backing_store_cache_size > slot_partitioning.min_slots) {
+    max_backing_store_cache_size--;
+    max_ocs_cache_size++;
+    while (cached_backing_store_pools.size() >
+           static_cast<size_t>(max_backing_store_cache_size)) {
+      releaseSlot(/*is_ocs_pool=*/false);
+    }
+  } else if (backing_store_gain > ocs_gain &&
+             max_ocs_cache_size > slot_partitioning.min_slots) {
+    max_ocs_cache_size--;
+    max_backing_store_cache_size++;
+    while (cached_ocs_pools.size() > static_cast<size_t>(max_ocs_cache_size)) {
+      releaseSlot(/*is_ocs_pool=*/true);
+    }
+  } else {
+    return;
+  }
+  stats.slot_repartitions++;
+  slot_partition_history.push_back({stats.off_node_loads +
+                                        stats.off_node_stores,
+                                    max_ocs_cache_size,
+                                    max_backing_store_cache_size});
+}
+
+void OCSCache::releaseSlot(bool is_ocs_pool) {
+  std::vector<pool_entry *> &cache =
+      is_ocs_pool ? cached_ocs_pools : cached_backing_store_pools;
+  pool_entry *pool = cache.back();
+  // invalidated pools can still sit in a slot
+  if (pool->in_cache) {
+    evict(pool);
+    rememberEvicted(pool);
+  }
+  cache.pop_back();
+}
+
+void OCSCache::evict(pool_entry *pool) {
+  if (pool->dirty) {
+    if (pool->is_ocs_pool) {
+      stats.ocs_flushes++;
+      stats.ocs_flush_bytes += pool->size();
+    } else {
+      stats.backing_store_writebacks++;
+      stats.backing_store_writeback_bytes += pool->size();
     }
+    pool->dirty = false;
+  }
+  if (pool->is_ocs_pool && !pool->served) {
+    stats.wasted_reconfigurations++;
   }
+  pool->in_cache = false;
+}
+
+void OCSCache::addPool(pool_entry *pool) {
+  pools.push_back(pool);
+  if (pool->is_ocs_pool) {
+    ocs_pool_index.push_back(pool);
+  } else {
+    backing_page_index[{pool->range.tenant, pool->range.addr_start}] = pool;
+  }
+  accountPool(*pool, 1);
+}
 
+OCSCache::Status OCSCache::setPageSize(uintptr_t bytes) {
+  if (bytes == 0 || (bytes & (bytes - 1)) != 0) {
+    std::cerr << "page size " << bytes << " is not a power of two"
+              << std::endl;
+    return Status::BAD;
+  }
+  if (!pools.empty()) {
+    return Status::BAD; // existing pages would have the wrong size
+  }
+  page_size = bytes;
+  return Status::OK;
+}
+
+size_t OCSCache::metadataBytes() const {
+  // a red-black tree node holds three pointers and a color besides its value
+  constexpr size_t kTreeNodeOverhead = 4 * sizeof(void *);
+  return pools.capacity() * sizeof(pool_entry *) +
+         pools.size() * sizeof(pool_entry) +
+         ocs_pool_index.capacity() * sizeof(pool_entry *) +
+         backing_page_index.size() *
+             (sizeof(decltype(backing_page_index)::value_type) +
+              kTreeNodeOverhead) +
+         slot_generations.capacity() * sizeof(uint32_t) +
+         free_slots.capacity() * sizeof(uint32_t);
+}
+
+pool_id OCSCache::allocatePoolId() {
+  if (free_slots.empty()) {
+    slot_generations.push_back(0);
+    return makePoolId(slot_generations.size() - 1, 0);
+  }
+  uint32_t slot = free_slots.back();
+  free_slots.pop_back();
+  return makePoolId(slot, slot_generations[slot]);
+}
+
+void OCSCache::maybeCompactPools() {
+  constexpr size_t kMinReclaimable = 64;
+  if (invalid_pools >= kMinReclaimable && invalid_pools * 4 >= pools.size()) {
+    compactPools();
+  }
+}
+
+void OCSCache::compactPools() {
+  // invalidated pages may still sit in a cache slot until they're evicted
+  std::set<const pool_entry *> referenced(cached_ocs_pools.begin(),
+                                          cached_ocs_pools.end());
+  referenced.insert(cached_backing_store_pools.begin(),
+                    cached_backing_store_pools.end());
+
+  // stable, since the order of `pools` decides which OCS pool is preferred
+  auto live_end = std::stable_partition(
+      pools.begin(), pools.end(), [&referenced](const pool_entry *pool) {
+        return pool->valid || referenced.count(pool) > 0;
+      });
+  for (auto pool = live_end; pool != pools.end(); ++pool) {
+    uint32_t slot = poolIdSlot((*pool)->id);
+    slot_generations[slot]++;
+    free_slots.push_back(slot);
+    free(*pool);
+  }
+  invalid_pools -= pools.end() - live_end;
+  pools.erase(live_end, pools.end());
+  pools.shrink_to_fit();
+}
+
+void OCSCache::accountPool(const pool_entry &pool, int sign) {
+  if (pool.is_ocs_pool) {
+    stats.ocs_pool_mem_usage += sign * pool.size();
+    stats.num_ocs_pools += sign;
+  } else {
+    stats.backing_store_mem_usage += sign * pool.size();
+    stats.num_backing_store_pools += sign;
+  }
+}
+
+perf_stats OCSCache::getPerformanceStats(bool summary) {
+  // the pool aggregates are kept up to date by `accountPool`
   stats.summary = summary; // effects the << operator's verbosity
   return stats;
 }
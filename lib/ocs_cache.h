@@ -1,15 +1,23 @@
 #pragma once
 // TODO There should really be tests for like all of this
 
+#include "candidate_table.h"
 #include "constants.h"
+#include "dram_tier.h"
 #include "ocs_structs.h"
+#include "prefetcher.h"
+#include <deque>
 #include <iostream>
+#include <map>
+#include <memory>
 #include <numbers>
+#include <random>
 #include <vector>
 
 class OCSCache {
-  // We use virtual addresses here, since we're only considering
-  // single-process workloads for now
+  // We use virtual addresses here. Accesses (and the pools/candidates they
+  // create) are tagged with a tenant id, so each tenant has its own address
+  // space while sharing the cache's OCS and backing store slots.
 
 public:
   enum Status { OK, BAD };
@@ -18,17 +26,36 @@ public:
 
   OCSCache(int pool_size_bytes, int max_concurrent_ocs_pools,
            int backing_store_cache_size);
-  ~OCSCache();
+  virtual ~OCSCache();
 
   // Update online clustering algorithm, potentially creating a new cluster.
   [[nodiscard]] virtual Status
   updateClustering(mem_access access, bool is_clustering_candidate) = 0;
 
+  // Same as calling `updateClustering` for each of the `count` `accesses`,
+  // which lie within `run` and touch the same pool nodes, for as many of them
+  // as can be applied in one step without materializing a candidate. Sets
+  // `*applied` to how many that was; the rest are left to `updateClustering`.
+  // Applies none by default.
+  [[nodiscard]] virtual Status
+  updateClusteringRun(const mem_access *accesses, size_t count,
+                      const access_run_bounds &run,
+                      bool is_clustering_candidate, size_t *applied) {
+    *applied = 0;
+    return Status::OK;
+  }
+
   // Returns the cache index to replace. This makes implementing custom policies
   // easier to do without rewriting a bunch of replacement business logic
   // Random by default.
   [[nodiscard]] virtual size_t indexToReplace(bool is_ocs_pool);
 
+  // Called with the nodes of every off-node access, before any of them are
+  // brought into their cache. `repeats` consecutive accesses to the same
+  // (cached) nodes may be reported in one call.
+  virtual void recordPoolAccesses(const std::vector<pool_entry *> &nodes,
+                                  long repeats) {}
+
   // Swap all `parent_pools` with `in_cache=false` in to their respective cache
   // (given by `parent_pools[i] == is_ocs_replacement[i]`. Random replacement
   // policy by default.
@@ -39,15 +66,194 @@ public:
   // clustering if relevant, and replace a cache line if neccessary.
   [[nodiscard]] Status handleMemoryAccess(mem_access access, bool *hit);
 
+  // Same as `handleMemoryAccess` for an access already known to miss the DRAM
+  // regions, starting in page `first_page` (see `PageResolvedTrace`).
+  [[nodiscard]] Status handleOffNodeAccess(mem_access access,
+                                           uintptr_t first_page, bool *hit);
+
+  // Same as `handleOffNodeAccess` for each of the `count` `accesses`, issued
+  // back to back by one tenant and thread and all within page `first_page`.
+  // Once the first access has brought the page's nodes in, the accesses that
+  // can only hit them are applied in bulk. Adds the number of hits to `*hits`.
+  [[nodiscard]] Status handleOffNodeRun(const mem_access *accesses,
+                                        size_t count, uintptr_t first_page,
+                                        long *hits);
+
   perf_stats getPerformanceStats();
 
   perf_stats getPerformanceStats(bool summary);
 
+  // The live counters, for callers that only read a few of them per access.
+  const perf_stats &getStats() const { return stats; }
+
+  // Per-tenant stats, indexed by tenant id. The counters sum to those of
+  // `getPerformanceStats()`.
+  std::vector<perf_stats> getTenantPerformanceStats();
+
+  // Per-thread stats, indexed by `mem_access::thread`. Only collected once
+  // enabled with `setThreadAttribution`.
+  std::vector<perf_stats> getThreadPerformanceStats();
+
+  void setThreadAttribution(bool enabled) {
+    settleAttribution();
+    thread_attribution = enabled;
+  }
+
+  // If enabled, a tenant that already holds its fair share of OCS slots
+  // (`max_ocs_cache_size` / #tenants using the OCS) can't evict another
+  // tenant's pool that is within its share; it replaces one of its own pools
+  // instead.
+  void setTenantFairShare(bool enabled) { tenant_fair_share = enabled; }
+
+  // Put a local DRAM cache of `capacity_pages` backing store pages in front
+  // of the off-node tiers (0 for none). Accesses it serves never reach the
+  // OCS or the backing store. Must be set before the first access.
+  void setDramTier(size_t capacity_pages, LocalDramTier::Policy policy) {
+    dram_tier.configure(capacity_pages, policy);
+  }
+
+  // Turn cold OCS pools back into backing store pages.
+  void setDematerialization(const dematerialization_params &params) {
+    dematerialization = params;
+  }
+
+  // If enabled, promoting a candidate packs other hot candidates into the
+  // same OCS pool, as up to `kMaxPoolIntervals` intervals of what each
+  // candidate's accesses actually touched, as long as they fit in
+  // `pool_size_bytes`.
+  void setPoolPacking(bool enabled) { pool_packing = enabled; }
+
+  // Repartition the OCS and backing store slots at runtime (see
+  // `slot_partitioning_params`). Must be set before the first access.
+  void setSlotPartitioning(const slot_partitioning_params &params) {
+    slot_partitioning = params;
+    slot_partition_history = {
+        {0, max_ocs_cache_size, max_backing_store_cache_size}};
+  }
+
+  // The partitions the slots went through, oldest first (empty unless
+  // partitioning is enabled).
+  const std::vector<slot_partition> &getSlotPartitionHistory() const {
+    return slot_partition_history;
+  }
+
+  int getOCSSlots() const { return max_ocs_cache_size; }
+  int getBackingStoreSlots() const { return max_backing_store_cache_size; }
+
+  // Model OCS reconfigurations as in flight for a while instead of instant.
+  void setReconfiguration(const reconfiguration_params &params) {
+    reconfiguration = params;
+  }
+
   virtual std::string getName() = 0;
 
+  // Set the address ranges (of every tenant) that always live in local DRAM.
+  void setDramRegions(const std::vector<addr_subspace> &regions) {
+    dram_regions = regions;
+  }
+
+  const std::vector<addr_subspace> &getDramRegions() const {
+    return dram_regions;
+  }
+
+  // Account for `count` accesses to local DRAM issued by `tenant`/`thread`.
+  // DRAM accesses don't touch any pool or clustering state, so they can be
+  // filtered out of the trace and counted in bulk.
+  void recordDramHits(int tenant, int thread, long count);
+
+  // Return a deep copy of this cache, including all of its simulation state.
+  virtual OCSCache *clone() const = 0;
+
+  // Append everything that determines how this cache will handle future
+  // accesses (cache contents, valid OCS pools and candidates, replacement
+  // state) to `signature`. Two caches with equal signatures produce the same
+  // stats from then on, up to the replacement PRNG stream. Backing store page
+  // bookkeeping is left out since pages are materialized on demand.
+  virtual void appendStateSignature(std::vector<uint64_t> *signature) const;
+
+  // Add (uncached) copies of the valid backing store pages of `earlier` that
+  // this cache doesn't know about and no valid OCS pool of this cache covers.
+  // Used to reconstruct the page set of a run simulated in pieces.
+  void mergeBackingPagesFrom(const OCSCache &earlier);
+
+  // Overwrite the event counters with `counters`, and their per-tenant and
+  // per-thread breakdowns with `tenant_counters` and `thread_counters` (e.g.
+  // after reconstructing a run from several partial simulations).
+  void restoreStats(const perf_stats &counters,
+                    const std::vector<perf_stats> &tenant_counters,
+                    const std::vector<perf_stats> &thread_counters);
+
+  // Record the latency distribution of a timed run, reported with the stats.
+  void setLatencySummary(const latency_summary &latency) {
+    stats.latency = latency;
+  }
+
+  // The pools the OCS currently points to, indexed by switch port.
+  const std::vector<pool_entry *> &getCachedOCSPools() const {
+    return cached_ocs_pools;
+  }
+
+  // Return if `id` belongs to a pool that hasn't been reclaimed.
+  bool poolIsLive(pool_id id) const {
+    return poolIdSlot(id) < slot_generations.size() &&
+           slot_generations[poolIdSlot(id)] == poolIdGeneration(id);
+  }
+
+  // The number of pools (valid or not) the cache currently holds.
+  size_t numPoolEntries() const { return pools.size(); }
+
+  // Prefetch backing store pages with `prefetcher` (nullptr for none). The
+  // cache takes ownership of it.
+  void setPrefetcher(Prefetcher *new_prefetcher) {
+    prefetcher.reset(new_prefetcher);
+  }
+
+  std::string getPrefetcherName() const {
+    return prefetcher ? prefetcher->getName() : "none";
+  }
+
+  // Set the size of backing store pages, a power of two. Must be set before
+  // the first access.
+  [[nodiscard]] Status setPageSize(uintptr_t bytes);
+
+  uintptr_t getPageSize() const { return page_size; }
+
+  // Approximate bytes of simulator memory spent on pool metadata (pool
+  // entries, the pool index and id slots).
+  size_t metadataBytes() const;
+
+  // Reclaim every invalidated pool that no cache slot still points to.
+  void compactPools();
+
+  // Reseed the replacement PRNG. Every cache owns its own generator so that
+  // concurrently simulated caches are reproducible and don't contend on the
+  // global `random()` state.
+  virtual void setSeed(uint64_t new_seed) {
+    seed = new_seed;
+    rng.seed(new_seed);
+  }
+
+  uint64_t getSeed() const { return seed; }
+
 protected:
+  // Shallow member-wise copy, only to be used through `cloneAs`.
+  OCSCache(const OCSCache &) = default;
+
+  // Copy-construct a `T` from `cache` and give it its own copies of every
+  // pool.
+  template <typename T> static OCSCache *cloneAs(const T &cache) {
+    T *copy = new T(cache);
+    copy->ownPoolCopies();
+    return copy;
+  }
+
+  // Replace the (shared) pool pointers of a shallow copy with pointers to
+  // fresh copies.
+  void ownPoolCopies();
+
   // Get the nodes that, together, contain `access`. `parent_nodes.size() == 0`
-  // if there is no associated
+  // if there is no associated node. OCS pools come first (newest first),
+  // followed by backing store pages in address order.
   [[nodiscard]] OCSCache::Status
   getPoolNodes(mem_access access, std::vector<pool_entry *> *parent_nodes);
 
@@ -55,20 +261,132 @@ protected:
   // can span multiple ranges
   bool accessInRange(addr_subspace &range, mem_access access);
 
+  // Invalidate every (existing) valid backing store page of `tenant` that
+  // lies completely within [addr_start, addr_end). Returns the number of
+  // bytes displaced.
+  long invalidateBackingPages(int tenant, uintptr_t addr_start,
+                              uintptr_t addr_end);
+
+  // Dirty the cached nodes holding page `page` of `tenant`, which the DRAM
+  // tier just wrote back. Uncached nodes live in far memory, where the write
+  // back lands directly.
+  void dirtyCachedPageNodes(int tenant, uintptr_t page);
+
+  // Bring `pool`'s heat up to the current dematerialization epoch.
+  void decayPoolHeat(pool_entry *pool) const;
+
+  // Start a new dematerialization epoch, dematerializing the OCS pools that
+  // have stayed cold for long enough.
+  void dematerializeColdPools();
+
+  // Remember the evicted `pool` in its tier's ghost tags.
+  void rememberEvicted(const pool_entry *pool);
+
+  // Count a miss on `pool` as a ghost hit if its tier evicted it recently.
+  void recordGhostHit(const pool_entry *pool);
+
+  // Move a slot to the tier whose ghost tags were hit more this epoch.
+  void repartitionSlots();
+
+  // Give up the last slot of the OCS (or backing store) cache, evicting what
+  // it holds.
+  virtual void releaseSlot(bool is_ocs_pool);
+
+  // Invalidate the OCS pool `pool`, so its range is served by backing store
+  // pages (materialized again on demand) from now on.
+  void dematerialize(pool_entry *pool);
+
+  // Return if the OCS port `pool` is configured on is still reconfiguring.
+  bool reconfigurationPending(const pool_entry *pool) const {
+    return pool->ready_at > reconfiguration_now;
+  }
+
+  // Mark `pool` as no longer cached, writing it back (or flushing it, for OCS
+  // pools) if it's dirty.
+  void evict(pool_entry *pool);
+
+  // Add a newly created valid pool to `pools` and the pool index.
+  void addPool(pool_entry *pool);
+
+  // `getPoolNodes` for pages of `kPageSize` bytes, or of `page_size` bytes
+  // if `kPageSize` is 0 (sizes without a specialization).
+  template <uintptr_t kPageSize>
+  [[nodiscard]] Status
+  getPoolNodesForPageSize(mem_access access,
+                          std::vector<pool_entry *> *parent_nodes);
+
+  // Train the prefetcher on the backing store pages in `triggers` (demand
+  // misses and first hits on prefetched pages) and bring the pages it
+  // suggests into the backing store cache. Never evicts a page in `pinned`.
+  [[nodiscard]] Status prefetchAfter(int tenant,
+                                     const std::vector<pool_entry *> &triggers,
+                                     const std::vector<pool_entry *> &pinned);
+
+  // Take a free pool slot (or a new one) and return an id for it.
+  pool_id allocatePoolId();
+
+  // Reclaim invalidated pools once they make up a large enough fraction of
+  // `pools`, so compaction is amortized over the invalidations.
+  void maybeCompactPools();
+
+  // Add (`sign == 1`) or remove (`sign == -1`) a valid `pool` from the pool
+  // counts and memory usage in `stats`. Must be called whenever a pool is
+  // created or invalidated.
+  void accountPool(const pool_entry &pool, int sign);
+
+  // Make `tenant`/`thread` the owner of the counters that change from here
+  // on, settling those owed to the previous owner first.
+  void attributeTo(int tenant, int thread);
+
+  // Add the counters that changed since the last settlement to the per-tenant
+  // and per-thread stats of their owner.
+  void settleAttribution();
+
+  // Return the OCS cache index to evict for `incoming` under tenant fair-share
+  // arbitration, given the replacement policy's choice `policy_victim`.
+  size_t arbitrateOCSVictim(const pool_entry *incoming, size_t policy_victim);
+
+  // Materialize the (eligible) candidate at index `candidate` as an OCS pool
+  // of its touched extent plus those of other hot candidates that fit (see
+  // `setPoolPacking`), and remove them all from candidacy.
+  [[nodiscard]] Status materializePacked(int candidate);
+
+  // `updateClusteringRun` for caches whose `updateClustering` counts every
+  // access against the candidates with `invalidation_ratio`, then
+  // materializes the access' candidate if it's eligible.
+  [[nodiscard]] Status updateCandidatesRun(const mem_access *accesses,
+                                           size_t count,
+                                           const access_run_bounds &run,
+                                           bool is_clustering_candidate,
+                                           int invalidation_ratio,
+                                           size_t *applied);
+
+  // Apply as many of the `count` `accesses` (see `handleOffNodeRun`) as
+  // possible in one step, if they can only hit nodes that are already
+  // cached. Sets `*applied` to how many that was (0 if the next access has to
+  // be simulated on its own).
+  [[nodiscard]] Status applyRepeatedHits(const mem_access *accesses,
+                                         size_t count, uintptr_t first_page,
+                                         size_t *applied);
+
   // Return if the given `candidate` is eligible to be materialized (turned
   // into a `pool_entry` entry).
   virtual bool
   eligibleForMaterialization(const candidate_cluster &candidate) = 0;
 
-  // Materialize a `candidate` if it's eligible, and remove the `candidate`
-  // from candidacy.
-  [[nodiscard]] virtual Status
-  materializeIfEligible(candidate_cluster *candidate);
+  // Materialize the candidate at index `candidate` (if not -1) if it's
+  // eligible, and remove it from candidacy.
+  [[nodiscard]] virtual Status materializeIfEligible(int candidate);
 
-  // Returns if an address will always be in DRAM (for now, this is if it's a
-  // stack address).
+  // Returns if an address will always be in DRAM (i.e. it's in one of the
+  // `dram_regions`, such as the stack).
   bool addrAlwaysInDRAM(mem_access access) {
-    return access.addr > STACK_FLOOR; //&& access.size < pool_size_bytes; causes problems
+    for (const addr_subspace &region : dram_regions) {
+      if (access.addr >= region.addr_start && access.addr < region.addr_end) {
+        return true;
+      }
+    }
+    return false;
   }
 
   // Returns if a given `node` is in the OCS cache.
@@ -85,24 +403,27 @@ protected:
                       std::vector<pool_entry *> *associated_nodes,
                       std::vector<bool> *in_cache, bool *dram_hit);
 
-  // Return the candidate cluster if it exists, otherwise create one and
-  // return that.
-  [[nodiscard]] Status getOrCreateCandidate(mem_access access,
-                                            candidate_cluster **candidate);
+  // Return the index of the candidate cluster if it exists, otherwise create
+  // one and return that.
+  [[nodiscard]] Status getOrCreateCandidate(mem_access access, int *candidate);
 
   // Choosing the bounds for a new candidate is a design decision.
-  [[nodiscard]] virtual Status
-  createCandidate(mem_access access_t, candidate_cluster **candidate) = 0;
+  [[nodiscard]] virtual Status createCandidate(mem_access access_t,
+                                               addr_subspace *range) = 0;
 
   // Create a pool entry from a candidate cluster
   [[nodiscard]] Status
   createPoolFromCandidate(const candidate_cluster &candidate, pool_entry **pool,
                           bool is_ocs_node);
 
-  // Return a candidate cluster if it exists, otherwise `*candidate ==
-  // nullptr`
-  [[nodiscard]] Status getCandidateIfExists(mem_access access,
-                                            candidate_cluster **candidate);
+  // Create a pool entry holding the sorted, disjoint `intervals` of `tenant`.
+  [[nodiscard]] Status createPool(int tenant,
+                                  const std::vector<addr_interval> &intervals,
+                                  pool_entry **pool, bool is_ocs_node);
+
+  // Return the index of a candidate cluster if it exists, otherwise
+  // `*candidate == -1`
+  [[nodiscard]] Status getCandidateIfExists(mem_access access, int *candidate);
 
   int pool_size_bytes;
 
@@ -111,17 +432,82 @@ protected:
   // this is probably traditional, networked-backed far memory
   std::vector<pool_entry *> cached_backing_store_pools;
 
-  std::vector<candidate_cluster *> candidates;
+  CandidateTable candidates;
 
   // contains all (ocs + backing store) pools
   std::vector<pool_entry *> pools;
 
+  // Backing store prefetcher, if any.
+  std::shared_ptr<Prefetcher> prefetcher;
+
+  // Size of backing store pages.
+  uintptr_t page_size = PAGE_SIZE;
+
+  // Index of the valid pools: OCS pools in creation order, and backing store
+  // pages by (tenant, page address).
+  std::vector<pool_entry *> ocs_pool_index;
+  std::map<std::pair<int, uintptr_t>, pool_entry *> backing_page_index;
+
   perf_stats stats;
 
+  // Event counters broken down by tenant id.
+  std::vector<perf_stats> tenant_stats;
+
+  bool tenant_fair_share = false;
+
+  bool pool_packing = false;
+
+  LocalDramTier dram_tier;
+
+  reconfiguration_params reconfiguration;
+
+  dematerialization_params dematerialization;
+  uint32_t pool_heat_epoch = 0;
+
+  slot_partitioning_params slot_partitioning;
+  // ids of the pools each tier evicted last, most recent first
+  std::deque<pool_id> ocs_ghosts;
+  std::deque<pool_id> backing_store_ghosts;
+  // ghost hits of the current partitioning epoch
+  long ocs_epoch_ghost_hits = 0;
+  long backing_store_epoch_ghost_hits = 0;
+  std::vector<slot_partition> slot_partition_history;
+
+  // The current time of `reconfiguration`'s clock.
+  long reconfiguration_now = 0;
+
+  // Event counters broken down by thread id, if `thread_attribution`.
+  std::vector<perf_stats> thread_stats;
+
+  bool thread_attribution = false;
+
+  // Counters at the last settlement; the difference to `stats` is owed to
+  // `attributed_tenant` and `attributed_thread`. Back to back accesses by one
+  // owner share a settlement, so the access path doesn't snapshot `stats`.
+  perf_stats attribution_start;
+  int attributed_tenant = -1;
+  int attributed_thread = -1;
+
   // The number of pools we can concurrently point to is our 'cache' size.
   // Note that the 'cache' state is just the OCS configuation state, caching
   // data on a pool node does not physically move it.
   int max_ocs_cache_size;
 
   int max_backing_store_cache_size;
+
+  // Generation of every pool slot, and the slots that are free for reuse.
+  std::vector<uint32_t> slot_generations;
+  std::vector<uint32_t> free_slots;
+
+  // The number of invalidated pools still in `pools`.
+  size_t invalid_pools = 0;
+
+  // Address ranges that are always served by local DRAM. Everything above
+  // `STACK_FLOOR` by default.
+  std::vector<addr_subspace> dram_regions = {
+      {STACK_FLOOR + 1, UINTPTR_MAX}};
+
+  // Source of randomness for replacement policies (see `indexToReplace`).
+  uint64_t seed = 0;
+  std::mt19937_64 rng;
 };
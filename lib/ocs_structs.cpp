@@ -1,8 +1,11 @@
 #include "ocs_structs.h"
 
 std::ostream &operator<<(std::ostream &os, const addr_subspace &subspace) {
-  os << "Address Subspace {" << subspace.addr_start << ":" << subspace.addr_end
-     << "}";
+  os << "Address Subspace {" << subspace.addr_start << ":" << subspace.addr_end;
+  if (subspace.tenant != 0) {
+    os << " (tenant " << subspace.tenant << ")";
+  }
+  os << "}";
   return os;
 }
 
@@ -29,9 +32,18 @@ std::ostream &operator<<(std::ostream &os, const pool_entry &entry) {
   } else {
     os << "Backing Store Pool Entry {\n";
   }
-  os << "  Id: " << entry.id << ",\n"
-     << "  Range: " << entry.range << ",\n"
-     << "  Valid: " << (entry.valid ? "true" : "false") << ",\n"
+  os << "  Id: " << poolIdSlot(entry.id) << " (generation "
+     << poolIdGeneration(entry.id) << "),\n"
+     << "  Range: " << entry.range << ",\n";
+  if (entry.num_intervals > 1) {
+    os << "  Intervals: ";
+    for (int idx = 0; idx < entry.num_intervals; idx++) {
+      os << "[" << entry.intervals[idx].addr_start << ", "
+         << entry.intervals[idx].addr_end << ") ";
+    }
+    os << ",\n";
+  }
+  os << "  Valid: " << (entry.valid ? "true" : "false") << ",\n"
      << "  In Cache: " << (entry.in_cache ? "true" : "false") << "\n"
      << "}";
   return os;
@@ -70,12 +82,44 @@ std::ostream &operator<<(std::ostream &os, const perf_stats &stats) {
     os << "Cache Performance Summary:" << std::endl;
     os << "Total off-node Memory Usage (Assuming no Defragmentation): "
        << total_off_node_mem_usage << std::endl;
-    os << "Memory Latency: "
-       << "TODO" << std::endl;
+    if (stats.latency.count > 0) {
+      os << "Memory Latency (Mean/p50/p99/Max): " << stats.latency.mean_ns
+         << "/" << stats.latency.p50_ns << "/" << stats.latency.p99_ns << "/"
+         << stats.latency.max_ns << "ns" << std::endl;
+    } else {
+      os << "Memory Latency: "
+         << "TODO" << std::endl;
+    }
     os << std::endl;
 
     os << "Total Accesses: " << stats.accesses << std::endl;
     os << "DRAM Accesses: " << stats.dram_hits << std::endl;
+    os << "Off-Node Loads: " << stats.off_node_loads << std::endl;
+    os << "Off-Node Stores: " << stats.off_node_stores << std::endl;
+    if (stats.dram_tier_hits + stats.dram_tier_misses > 0) {
+      os << "\n------------------------------Local DRAM Tier "
+            "Performance------------------------------\n";
+      os << "DRAM Tier Hits: " << stats.dram_tier_hits << std::endl;
+      os << "DRAM Tier Misses: " << stats.dram_tier_misses << std::endl;
+      os << "DRAM Tier Hit Rate: "
+         << 100.0 * stats.dram_tier_hits /
+                (stats.dram_tier_hits + stats.dram_tier_misses)
+         << "%" << std::endl;
+      os << "DRAM Tier Evictions: " << stats.dram_tier_evictions << std::endl;
+      os << "DRAM Tier Write-backs: " << stats.dram_tier_writebacks << " ("
+         << stats.dram_tier_writeback_bytes << "B)" << std::endl;
+    }
+    if (stats.ocs_ghost_hits + stats.backing_store_ghost_hits +
+            stats.slot_repartitions >
+        0) {
+      os << "Ghost Hits (OCS/Backing Store): " << stats.ocs_ghost_hits << "/"
+         << stats.backing_store_ghost_hits << std::endl;
+      os << "Slot Repartitions: " << stats.slot_repartitions << std::endl;
+    }
+    if (stats.replacement_policy_switches > 0) {
+      os << "Replacement Policy Switches: "
+         << stats.replacement_policy_switches << std::endl;
+    }
 
     os << "\n------------------------------OCS "
           "Performance------------------------------\n";
@@ -86,6 +130,18 @@ std::ostream &operator<<(std::ostream &os, const perf_stats &stats) {
     os << "OCS Pool Hits: " << stats.ocs_pool_hits << std::endl;
     os << "OCS Hit Rate: " << ocs_hit_rate * 100 << "%" << std::endl;
     os << "OCS Reconfigurations: " << stats.ocs_reconfigurations << std::endl;
+    os << "OCS Flushes: " << stats.ocs_flushes << " (" << stats.ocs_flush_bytes
+       << "B)" << std::endl;
+    os << "OCS Pools Dematerialized: " << stats.ocs_pools_dematerialized
+       << " (" << stats.dematerialized_bytes << "B migrated)" << std::endl;
+    os << "Wasted OCS Reconfigurations: " << stats.wasted_reconfigurations
+       << std::endl;
+    os << "Accesses Overlapped With Reconfigurations: "
+       << stats.reconfiguration_overlapped_accesses << std::endl;
+    os << "Pending Reconfiguration Fallbacks: "
+       << stats.reconfiguration_fallbacks << std::endl;
+    os << "Pending Reconfiguration Stall: " << stats.reconfiguration_stall
+       << std::endl;
 
     os << "\n------------------------------Backing Store "
           "Performance------------------------------\n";
@@ -99,6 +155,21 @@ std::ostream &operator<<(std::ostream &os, const perf_stats &stats) {
     os << "Backing Store Hit Rate: " << backing_hit_rate * 100 << "%"
        << std::endl;
     os << "Backing Store Misses: " << stats.backing_store_misses << std::endl;
+    os << "Backing Store Bytes Displaced By OCS Pools: "
+       << stats.backing_store_bytes_displaced << std::endl;
+    os << "Backing Store Write-backs: " << stats.backing_store_writebacks
+       << " (" << stats.backing_store_writeback_bytes << "B)" << std::endl;
+    if (stats.prefetches_issued > 0) {
+      os << "Prefetches Issued: " << stats.prefetches_issued << std::endl;
+      os << "Prefetch Accuracy: "
+         << 100.0 * stats.prefetch_hits / stats.prefetches_issued << "%"
+         << std::endl;
+      os << "Prefetch Coverage: "
+         << 100.0 * stats.prefetch_hits /
+                (stats.prefetch_hits + stats.backing_store_misses)
+         << "%" << std::endl;
+      os << "Prefetch Transfer Bytes: " << stats.prefetch_bytes << std::endl;
+    }
 
     os << "\n------------------------------Clustering Policy "
           "Performance------------------------------\n";
@@ -106,6 +177,8 @@ std::ostream &operator<<(std::ostream &os, const perf_stats &stats) {
        << std::endl;
     os << "Cluster Candidates Created: " << stats.candidates_created
        << std::endl;
+    os << "Cluster Candidates Packed: " << stats.candidates_packed
+       << std::endl;
     os << "Candidate Promotion Rate: " << promotion_rate * 100 << "%"
        << std::endl;
     // TODO figure out + report what % of memory is now off DRAM
@@ -117,8 +190,13 @@ std::ostream &operator<<(std::ostream &os, const perf_stats &stats) {
 
   os << "\n------------------------------"
         "Performance Summary---------------------------\n";
-  os << "Overall Memory Latency: "
-     << "TODO" << std::endl;
+  if (stats.latency.count > 0) {
+    os << "Overall Memory Latency (p50/p99): " << stats.latency.p50_ns << "/"
+       << stats.latency.p99_ns << "ns" << std::endl;
+  } else {
+    os << "Overall Memory Latency: "
+       << "TODO" << std::endl;
+  }
   os << "Total off-node Memory Usage (Assuming no Defragmentation): "
      << total_off_node_mem_usage << "B" << std::endl;
 
@@ -144,3 +222,57 @@ bool operator==(const perf_stats &lhs, const perf_stats &rhs) {
          lhs.backing_store_hits == rhs.backing_store_hits;
 
 }
+
+void perf_stats::accumulateDelta(const perf_stats &before,
+                                 const perf_stats &after) {
+  accesses += after.accesses - before.accesses;
+  ocs_reconfigurations +=
+      after.ocs_reconfigurations - before.ocs_reconfigurations;
+  backing_store_misses +=
+      after.backing_store_misses - before.backing_store_misses;
+  dram_hits += after.dram_hits - before.dram_hits;
+  ocs_pool_hits += after.ocs_pool_hits - before.ocs_pool_hits;
+  backing_store_hits += after.backing_store_hits - before.backing_store_hits;
+  candidates_created += after.candidates_created - before.candidates_created;
+  candidates_promoted +=
+      after.candidates_promoted - before.candidates_promoted;
+  backing_store_bytes_displaced +=
+      after.backing_store_bytes_displaced - before.backing_store_bytes_displaced;
+  prefetches_issued += after.prefetches_issued - before.prefetches_issued;
+  prefetch_hits += after.prefetch_hits - before.prefetch_hits;
+  prefetch_bytes += after.prefetch_bytes - before.prefetch_bytes;
+  off_node_loads += after.off_node_loads - before.off_node_loads;
+  off_node_stores += after.off_node_stores - before.off_node_stores;
+  backing_store_writebacks +=
+      after.backing_store_writebacks - before.backing_store_writebacks;
+  backing_store_writeback_bytes +=
+      after.backing_store_writeback_bytes - before.backing_store_writeback_bytes;
+  ocs_flushes += after.ocs_flushes - before.ocs_flushes;
+  ocs_flush_bytes += after.ocs_flush_bytes - before.ocs_flush_bytes;
+  reconfiguration_fallbacks +=
+      after.reconfiguration_fallbacks - before.reconfiguration_fallbacks;
+  reconfiguration_stall +=
+      after.reconfiguration_stall - before.reconfiguration_stall;
+  reconfiguration_overlapped_accesses +=
+      after.reconfiguration_overlapped_accesses -
+      before.reconfiguration_overlapped_accesses;
+  wasted_reconfigurations +=
+      after.wasted_reconfigurations - before.wasted_reconfigurations;
+  dram_tier_hits += after.dram_tier_hits - before.dram_tier_hits;
+  dram_tier_misses += after.dram_tier_misses - before.dram_tier_misses;
+  dram_tier_evictions += after.dram_tier_evictions - before.dram_tier_evictions;
+  dram_tier_writebacks +=
+      after.dram_tier_writebacks - before.dram_tier_writebacks;
+  dram_tier_writeback_bytes +=
+      after.dram_tier_writeback_bytes - before.dram_tier_writeback_bytes;
+  ocs_pools_dematerialized +=
+      after.ocs_pools_dematerialized - before.ocs_pools_dematerialized;
+  dematerialized_bytes += after.dematerialized_bytes - before.dematerialized_bytes;
+  candidates_packed += after.candidates_packed - before.candidates_packed;
+  ocs_ghost_hits += after.ocs_ghost_hits - before.ocs_ghost_hits;
+  backing_store_ghost_hits +=
+      after.backing_store_ghost_hits - before.backing_store_ghost_hits;
+  slot_repartitions += after.slot_repartitions - before.slot_repartitions;
+  replacement_policy_switches +=
+      after.replacement_policy_switches - before.replacement_policy_switches;
+}
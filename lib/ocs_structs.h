@@ -1,14 +1,20 @@
 #pragma once
 
+#include <algorithm>
+#include <cstdint>
 #include <numbers>
 #include <sstream>
 #include <string>
 
 typedef struct addr_subspace {
-  // TODO should support a set of intervals
+  // A single interval; pools holding several keep them in
+  // `pool_entry::intervals`.
   uintptr_t
       addr_start; // TODO should prob use addr_t to support 32bit addresses
   uintptr_t addr_end;
+
+  // The tenant (process) whose virtual address space this range lives in.
+  int tenant = 0;
   friend std::ostream &operator<<(std::ostream &os, const addr_subspace &e);
   long size() const { return addr_end - addr_start; }
 } addr_subspace;
@@ -32,12 +38,42 @@ typedef struct candidate_cluster {
   bool operator==(const candidate_cluster &A) const { return id == A.id; };
 } candidate_cluster;
 
+// A pool holds at most this many disjoint address intervals.
+constexpr int kMaxPoolIntervals = 4;
+
+typedef struct addr_interval {
+  uintptr_t addr_start;
+  uintptr_t addr_end;
+} addr_interval;
+
+struct mem_access;
+
+// Pool ids pack the index of a reusable slot (low 32 bits) with the
+// generation of that slot (high 32 bits). A slot's generation is bumped when
+// its pool is reclaimed, so ids of reclaimed pools never match a live pool.
+typedef uint64_t pool_id;
+
+inline pool_id makePoolId(uint32_t slot, uint32_t generation) {
+  return (static_cast<pool_id>(generation) << 32) | slot;
+}
+inline uint32_t poolIdSlot(pool_id id) { return static_cast<uint32_t>(id); }
+inline uint32_t poolIdGeneration(pool_id id) {
+  return static_cast<uint32_t>(id >> 32);
+}
+
 typedef struct pool_entry {
-  int id;
+  pool_id id;
 
-  // The (virtual) address range offloaded to this node.
+  // The (virtual) address range offloaded to this node. For nodes that hold
+  // several intervals, this is their bounding range.
   addr_subspace range;
 
+  // The address intervals (in `range.tenant`'s address space) offloaded to
+  // this node, sorted and disjoint. Held inline so lookups don't chase
+  // pointers; most nodes hold the single interval `range`.
+  int num_intervals = 1;
+  addr_interval intervals[kMaxPoolIntervals];
+
   // Wether this node contains offloaded data
   bool valid = false;
 
@@ -47,26 +83,176 @@ typedef struct pool_entry {
   // Wether this node is 'in cache' (pointed to by OCS)
   bool in_cache = false;
 
+  // Wether this node was written while cached, so evicting it writes it back
+  bool dirty = false;
+
+  // Wether this node was brought into cache by a prefetch and hasn't been
+  // accessed since
+  bool prefetched = false;
+
+  // When the OCS port this (OCS) node is configured on finishes
+  // reconfiguring, see `reconfiguration_params`.
+  long ready_at = 0;
+
+  // Wether an access was served by this (OCS) node since it was configured
+  bool served = false;
+
+  // Accesses to this (OCS) node, halved every dematerialization epoch, as of
+  // epoch `heat_epoch`, and the consecutive epochs it has been cold for (see
+  // `dematerialization_params`).
+  uint32_t heat = 0;
+  uint32_t heat_epoch = 0;
+  int cold_epochs = 0;
+
   friend std::ostream &operator<<(std::ostream &os, const pool_entry &e);
   bool operator==(const pool_entry &A) const { return id == A.id; };
-  long size() const { return range.size(); }
+  // Bytes offloaded to this node (the size of its intervals).
+  long size() const {
+    long bytes = 0;
+    for (int idx = 0; idx < num_intervals; idx++) {
+      bytes += intervals[idx].addr_end - intervals[idx].addr_start;
+    }
+    return bytes;
+  }
+
+  // Return if `access` touches one of this node's intervals.
+  bool touches(const mem_access &access) const;
+
+  // Return if [addr_start, addr_end) lies within one of this node's intervals.
+  bool covers(uintptr_t addr_start, uintptr_t addr_end) const {
+    for (int idx = 0; idx < num_intervals; idx++) {
+      if (intervals[idx].addr_start <= addr_start &&
+          addr_end <= intervals[idx].addr_end) {
+        return true;
+      }
+    }
+    return false;
+  }
 } pool_entry;
 
 typedef struct mem_access {
   uintptr_t addr;
   int size;
 
+  // The tenant (process) that issued this access. Addresses are only
+  // meaningful within a tenant's own virtual address space.
+  int tenant = 0;
+
+  // Trace timestamp of the access (0 if unknown).
+  long timestamp = 0;
+
+  // The application thread (i.e. per-thread trace) that issued this access.
+  // Threads share their tenant's address space.
+  int thread = 0;
+
+  // Stores dirty the pools they touch, loads don't.
+  bool is_write = false;
+
   friend std::ostream &operator<<(std::ostream &os, const mem_access &a);
 } mem_access;
 
+// Same overlap test as `OCSCache::accessInRange`, for each interval.
+inline bool pool_entry::touches(const mem_access &access) const {
+  if (range.tenant != access.tenant) {
+    return false;
+  }
+  uintptr_t access_end = access.addr + (access.size > 0 ? access.size : 1);
+  for (int idx = 0; idx < num_intervals; idx++) {
+    if (access.addr < intervals[idx].addr_end &&
+        access_end > intervals[idx].addr_start) {
+      return true;
+    }
+  }
+  return false;
+}
+
+// The extent of a run of accesses from one tenant: every access starts in
+// [lo, last_start] and ends in [first_end, hi].
+typedef struct access_run_bounds {
+  int tenant = 0;
+  uintptr_t lo = UINTPTR_MAX;
+  uintptr_t last_start = 0;
+  uintptr_t first_end = UINTPTR_MAX;
+  uintptr_t hi = 0;
+
+  void add(const mem_access &access) {
+    uintptr_t access_end = access.addr + (access.size > 0 ? access.size : 1);
+    tenant = access.tenant;
+    lo = std::min(lo, access.addr);
+    last_start = std::max(last_start, access.addr);
+    first_end = std::min(first_end, access_end);
+    hi = std::max(hi, access_end);
+  }
+
+  // If every access of the run overlaps [addr_start, addr_end).
+  bool allTouch(uintptr_t addr_start, uintptr_t addr_end) const {
+    return last_start < addr_end && first_end > addr_start;
+  }
+
+  // If no access of the run overlaps [addr_start, addr_end).
+  bool noneTouch(uintptr_t addr_start, uintptr_t addr_end) const {
+    return hi <= addr_start || lo >= addr_end;
+  }
+} access_run_bounds;
+
+// Asynchronous OCS reconfiguration. A reconfigured port stays in flight for
+// `delay` trace timestamp ticks (or off-node accesses, if
+// `delay_in_accesses`); 0 reconfigures instantly.
+typedef struct reconfiguration_params {
+  long delay = 0;
+  bool delay_in_accesses = false;
+
+  // Accesses to a pool whose port is in flight wait for it if set, otherwise
+  // they fall back to far memory.
+  bool stall_pending = false;
+} reconfiguration_params;
+
+// Dematerialization of cold OCS pools. Every `epoch_accesses` off-node
+// accesses (0 never), each OCS pool's heat is checked, and pools with less
+// than `cold_heat` for `cold_epochs` epochs in a row are turned back into
+// backing store pages.
+typedef struct dematerialization_params {
+  long epoch_accesses = 0;
+  uint32_t cold_heat = 16;
+  int cold_epochs = 2;
+} dematerialization_params;
+
+// Adaptive partitioning of a fixed total of OCS and backing store slots.
+// Each tier keeps ghost tags of the last `ghost_slots` pools it evicted; a
+// miss on a ghost tag is one a few more slots would have turned into a hit.
+// Every `epoch_accesses` off-node accesses (0 never), one slot moves to the
+// tier with more ghost hits in the epoch, leaving each at least `min_slots`.
+typedef struct slot_partitioning_params {
+  long epoch_accesses = 0;
+  int ghost_slots = 4;
+  int min_slots = 1;
+} slot_partitioning_params;
+
+// The slots of each tier from `off_node_accesses` on.
+typedef struct slot_partition {
+  long off_node_accesses;
+  int ocs_slots;
+  int backing_store_slots;
+} slot_partition;
+
+// Latency distribution of the timed accesses of a run (see `TimingModel`).
+typedef struct latency_summary {
+  // 0 if the run wasn't timed.
+  long count = 0;
+  double mean_ns = 0.0;
+  long p50_ns = 0;
+  long p99_ns = 0;
+  long max_ns = 0;
+} latency_summary;
+
 typedef struct perf_stats {
   // NOTE that this is the number of cache/node accesses, which might be greater than
   // the number of memory accesses, because memory accesses (such as those
   // bigger than a page) might lead to multiple cache accesses (misses/hits).
   long accesses = 0;
-  long ocs_pool_mem_usage = 0; // updated at getPerformanceStats() call time
-  long backing_store_mem_usage =
-      0; // updated at getPerformanceStats() call time
+  // kept up to date as pools are created and invalidated
+  long ocs_pool_mem_usage = 0;
+  long backing_store_mem_usage = 0;
 
   long ocs_reconfigurations = 0;
   long backing_store_misses = 0;
@@ -78,14 +264,79 @@ typedef struct perf_stats {
   long ocs_pool_hits = 0;
   long backing_store_hits = 0;
 
-  long num_ocs_pools = 0; // updated at getPerformanceStats() call time
-  long num_backing_store_pools =
-      0; // updated at getPerformanceStats() call time
+  // kept up to date as pools are created and invalidated
+  long num_ocs_pools = 0;
+  long num_backing_store_pools = 0;
   long candidates_created = 0;
   long candidates_promoted = 0;
+
+  // bytes of backing store pages displaced by newly materialized OCS pools
+  long backing_store_bytes_displaced = 0;
+
+  // backing store pages brought into cache by the prefetcher, the ones of
+  // those later accessed, and the bytes transferred for them
+  long prefetches_issued = 0;
+  long prefetch_hits = 0;
+  long prefetch_bytes = 0;
+
+  // off-node (i.e. non-DRAM) memory accesses by type
+  long off_node_loads = 0;
+  long off_node_stores = 0;
+
+  // dirty backing store pages written back to far memory on eviction (or
+  // when an OCS pool displaces them), and dirty OCS pools flushed when
+  // reconfigured out
+  long backing_store_writebacks = 0;
+  long backing_store_writeback_bytes = 0;
+  long ocs_flushes = 0;
+  long ocs_flush_bytes = 0;
+
+  // with asynchronous reconfiguration: accesses to pools whose port was in
+  // flight that fell back to far memory, the time (in the delay's unit)
+  // accesses stalled for ports instead, off-node accesses served while a
+  // reconfiguration was in flight, and OCS pools evicted before serving any
+  // access
+  long reconfiguration_fallbacks = 0;
+  long reconfiguration_stall = 0;
+  long reconfiguration_overlapped_accesses = 0;
+  long wasted_reconfigurations = 0;
+
+  // the capacity-limited local DRAM tier (see `OCSCache::setDramTier`):
+  // accesses it served (also counted as `dram_hits`), accesses that missed it
+  // and were passed on to the off-node tiers, and dirty pages it wrote back
+  long dram_tier_hits = 0;
+  long dram_tier_misses = 0;
+  long dram_tier_evictions = 0;
+  long dram_tier_writebacks = 0;
+  long dram_tier_writeback_bytes = 0;
+
+  // cold OCS pools turned back into backing store pages, and the bytes
+  // migrated back to the backing store for them
+  long ocs_pools_dematerialized = 0;
+  long dematerialized_bytes = 0;
+
+  // hot candidates packed into another candidate's OCS pool as extra
+  // intervals (see `OCSCache::setPoolPacking`)
+  long candidates_packed = 0;
+
+  // misses on ghost tags, and slots moved between the tiers (see
+  // `slot_partitioning_params`)
+  long ocs_ghost_hits = 0;
+  long backing_store_ghost_hits = 0;
+  long slot_repartitions = 0;
+
+  // times the followers of a dueling replacement policy changed policy
+  long replacement_policy_switches = 0;
+
+  // not an event counter, set once a timed run completes
+  latency_summary latency;
   friend std::ostream &operator<<(std::ostream &os, const perf_stats &stats);
   friend bool operator==(const perf_stats& lhs, const perf_stats& rhs);
 
+  // Add the event counters accumulated between `before` and `after` (two
+  // snapshots of the same cache's stats) to these stats.
+  void accumulateDelta(const perf_stats &before, const perf_stats &after);
+
 
   bool summary = false;
 } perf_stats;
@@ -0,0 +1,78 @@
+#include "page_resolution.h"
+#include "dram_filter.h"
+
+#include <algorithm>
+
+void PageResolvedTrace::resolve(const std::vector<mem_access> &accesses,
+                                uintptr_t new_page_size,
+                                const std::vector<addr_subspace> &regions) {
+  source = accesses.data();
+  source_size = accesses.size();
+  page_size = new_page_size;
+  dram_regions = regions;
+  resolved.clear();
+
+  // DRAM accesses are found in batches, then runs of them are merged
+  constexpr size_t kBatchSize = 4096;
+  std::vector<uint32_t> off_node;
+  off_node.reserve(kBatchSize);
+  for (size_t batch = 0; batch < accesses.size(); batch += kBatchSize) {
+    size_t batch_size = std::min(kBatchSize, accesses.size() - batch);
+    const mem_access *batch_accesses = accesses.data() + batch;
+    off_node.clear();
+    prefilterDramAccesses(batch_accesses, batch_size, dram_regions, &off_node);
+
+    size_t next_off_node = 0;
+    for (size_t idx = 0; idx < batch_size; idx++) {
+      const mem_access &access = batch_accesses[idx];
+      if (next_off_node < off_node.size() && off_node[next_off_node] == idx) {
+        next_off_node++;
+        uintptr_t last_byte = access.addr + std::max(access.size, 1) - 1;
+        uintptr_t first_page = access.addr / page_size;
+        uint32_t pages =
+            static_cast<uint32_t>(last_byte / page_size - first_page + 1);
+        // back-to-back accesses to the same page collapse into one record
+        if (pages == 1 && !resolved.empty() && !resolved.back().is_dram) {
+          resolved_access &previous = resolved.back();
+          const mem_access &run_start = accesses[previous.index];
+          if (previous.count == 1 && previous.first_page == first_page &&
+              previous.index + previous.repeats == batch + idx &&
+              run_start.tenant == access.tenant &&
+              run_start.thread == access.thread) {
+            previous.repeats++;
+            continue;
+          }
+        }
+        resolved.push_back(
+            {batch + idx, first_page, pages, 1, /*is_dram=*/false});
+        continue;
+      }
+      if (!resolved.empty() && resolved.back().is_dram) {
+        const mem_access &run_start = accesses[resolved.back().index];
+        if (run_start.tenant == access.tenant &&
+            run_start.thread == access.thread) {
+          resolved.back().count++;
+          continue;
+        }
+      }
+      resolved.push_back({batch + idx, 0, 1, 1, /*is_dram=*/true});
+    }
+  }
+}
+
+bool PageResolvedTrace::matches(
+    const std::vector<mem_access> &accesses, uintptr_t other_page_size,
+    const std::vector<addr_subspace> &regions) const {
+  if (source != accesses.data() || source_size != accesses.size() ||
+      page_size != other_page_size || dram_regions.size() != regions.size()) {
+    return false;
+  }
+  for (size_t idx = 0; idx < regions.size(); idx++) {
+    if (dram_regions[idx].addr_start != regions[idx].addr_start ||
+        dram_regions[idx].addr_end != regions[idx].addr_end ||
+        dram_regions[idx].tenant != regions[idx].tenant) {
+      return false;
+    }
+  }
+  return true;
+}
@@ -0,0 +1,46 @@
+#pragma once
+
+#include "ocs_structs.h"
+#include <cstdint>
+#include <vector>
+
+// One record of a trace resolved by `PageResolvedTrace`: either a run of
+// consecutive DRAM accesses from the same tenant and thread, or an off-node
+// access, possibly repeated by consecutive accesses from the same tenant and
+// thread to the same page.
+typedef struct resolved_access {
+  // Index of the (first) access in the decoded trace.
+  uint64_t index;
+  // The page an off-node access starts in (its address / the page size).
+  uintptr_t first_page;
+  // The length of a DRAM run, or the number of pages an off-node access
+  // spans.
+  uint32_t count;
+  // The number of consecutive off-node accesses (starting at `index`) that
+  // make up the record; more than 1 only for accesses within a single page.
+  uint32_t repeats;
+  bool is_dram;
+} resolved_access;
+
+// A decoded trace resolved once against a page size and the DRAM regions, so
+// every cache simulated with that page size can consume the same records
+// instead of filtering DRAM accesses and computing page numbers itself.
+class PageResolvedTrace {
+public:
+  void resolve(const std::vector<mem_access> &accesses, uintptr_t page_size,
+               const std::vector<addr_subspace> &dram_regions);
+
+  // If this resolution can stand in for `accesses` in a cache with
+  // `page_size` and `dram_regions`.
+  bool matches(const std::vector<mem_access> &accesses, uintptr_t page_size,
+               const std::vector<addr_subspace> &dram_regions) const;
+
+  const std::vector<resolved_access> &records() const { return resolved; }
+
+private:
+  const mem_access *source = nullptr;
+  size_t source_size = 0;
+  uintptr_t page_size = 0;
+  std::vector<addr_subspace> dram_regions;
+  std::vector<resolved_access> resolved;
+};
@@ -0,0 +1,113 @@
+#include "prefetcher.h"
+
+#include <algorithm>
+
+void NextNLinePrefetcher::train(int tenant, uintptr_t page,
+                                uintptr_t page_size,
+                                std::vector<uintptr_t> *prefetch) {
+  for (int next = 1; next <= degree; next++) {
+    prefetch->push_back(page + next * page_size);
+  }
+}
+
+void StridePrefetcher::train(int tenant, uintptr_t page, uintptr_t page_size,
+                             std::vector<uintptr_t> *prefetch) {
+  uintptr_t region = page / region_bytes;
+  stride_entry &entry =
+      table[(region ^ tenant) % table.size()];
+  if (!entry.valid || entry.tenant != tenant || entry.region != region) {
+    entry = {true, tenant, region, page, 0, 0};
+    return;
+  }
+
+  long stride = static_cast<long>(page - entry.last_page);
+  if (stride == entry.stride) {
+    entry.confidence = std::min(entry.confidence + 1, 3);
+  } else {
+    entry.stride = stride;
+    entry.confidence = 0;
+  }
+  entry.last_page = page;
+
+  if (entry.confidence > 0 && entry.stride != 0) {
+    for (int next = 1; next <= degree; next++) {
+      prefetch->push_back(page + next * entry.stride);
+    }
+  }
+}
+
+void StridePrefetcher::appendStateSignature(
+    std::vector<uint64_t> *signature) const {
+  for (const stride_entry &entry : table) {
+    if (entry.valid) {
+      signature->push_back(entry.tenant);
+      signature->push_back(entry.region);
+      signature->push_back(entry.last_page);
+      signature->push_back(entry.stride);
+      signature->push_back(entry.confidence);
+    }
+  }
+}
+
+MarkovPrefetcher::markov_entry &
+MarkovPrefetcher::entryFor(int tenant, uintptr_t page, uintptr_t page_size) {
+  // pages are aligned, index by page number so they spread over the table
+  return table[((page / page_size) ^ tenant) % table.size()];
+}
+
+void MarkovPrefetcher::train(int tenant, uintptr_t page, uintptr_t page_size,
+                             std::vector<uintptr_t> *prefetch) {
+  // record `page` as a successor of the tenant's previous page
+  auto last = last_page.find(tenant);
+  if (last != last_page.end() && last->second != page) {
+    markov_entry &previous = entryFor(tenant, last->second, page_size);
+    if (!previous.valid || previous.tenant != tenant ||
+        previous.page != last->second) {
+      previous = {true, tenant, last->second, {}};
+    }
+    std::vector<uintptr_t> &successors = previous.successors;
+    successors.erase(std::remove(successors.begin(), successors.end(), page),
+                     successors.end());
+    successors.insert(successors.begin(), page);
+    if (successors.size() > static_cast<size_t>(degree)) {
+      successors.pop_back();
+    }
+  }
+  last_page[tenant] = page;
+
+  const markov_entry &current = entryFor(tenant, page, page_size);
+  if (current.valid && current.tenant == tenant && current.page == page) {
+    prefetch->insert(prefetch->end(), current.successors.begin(),
+                     current.successors.end());
+  }
+}
+
+void MarkovPrefetcher::appendStateSignature(
+    std::vector<uint64_t> *signature) const {
+  for (const markov_entry &entry : table) {
+    if (entry.valid) {
+      signature->push_back(entry.tenant);
+      signature->push_back(entry.page);
+      signature->push_back(entry.successors.size());
+      signature->insert(signature->end(), entry.successors.begin(),
+                        entry.successors.end());
+    }
+  }
+  for (const auto &last : last_page) {
+    signature->push_back(last.first);
+    signature->push_back(last.second);
+  }
+}
+
+Prefetcher *makePrefetcher(const std::string &kind, int degree) {
+  if (kind == "next_n") {
+    return new NextNLinePrefetcher(degree);
+  }
+  if (kind == "stride") {
+    return new StridePrefetcher(degree);
+  }
+  if (kind == "markov") {
+    return new MarkovPrefetcher(degree);
+  }
+  return nullptr;
+}
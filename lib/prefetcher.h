@@ -0,0 +1,114 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <string>
+#include <vector>
+
+// A backing store prefetcher. It is trained with the page of every demand
+// miss (and of the first hit on a prefetched page, so streams keep going)
+// and returns the pages to fetch ahead of time.
+class Prefetcher {
+public:
+  virtual ~Prefetcher() = default;
+
+  // Train on an access to the page starting at `page` (of `page_size` bytes)
+  // in `tenant`'s address space and append the start addresses of the pages
+  // to prefetch to `prefetch`.
+  virtual void train(int tenant, uintptr_t page, uintptr_t page_size,
+                     std::vector<uintptr_t> *prefetch) = 0;
+
+  virtual std::string getName() const = 0;
+
+  // Return a deep copy of this prefetcher, including its tables.
+  virtual Prefetcher *clone() const = 0;
+
+  // Append everything that decides future prefetches (see
+  // `OCSCache::appendStateSignature`).
+  virtual void appendStateSignature(std::vector<uint64_t> *signature) const {}
+};
+
+// Fetches the `degree` pages following every trained page.
+class NextNLinePrefetcher : public Prefetcher {
+public:
+  NextNLinePrefetcher(int degree) : degree(degree) {}
+
+  void train(int tenant, uintptr_t page, uintptr_t page_size,
+             std::vector<uintptr_t> *prefetch) override;
+  std::string getName() const override {
+    return "next-" + std::to_string(degree) + "-line";
+  }
+  Prefetcher *clone() const override { return new NextNLinePrefetcher(*this); }
+
+private:
+  int degree;
+};
+
+// Detects a constant stride between consecutive trained pages of a region
+// (`region_bytes` of address space) and, once it has repeated, fetches the
+// next `degree` pages along it. Regions share a direct-mapped table.
+class StridePrefetcher : public Prefetcher {
+public:
+  StridePrefetcher(int degree, uintptr_t region_bytes = 1 << 20,
+                   size_t table_size = 256)
+      : degree(degree), region_bytes(region_bytes), table(table_size) {}
+
+  void train(int tenant, uintptr_t page, uintptr_t page_size,
+             std::vector<uintptr_t> *prefetch) override;
+  std::string getName() const override {
+    return "stride-" + std::to_string(degree);
+  }
+  Prefetcher *clone() const override { return new StridePrefetcher(*this); }
+  void appendStateSignature(std::vector<uint64_t> *signature) const override;
+
+private:
+  typedef struct stride_entry {
+    bool valid = false;
+    int tenant = 0;
+    uintptr_t region = 0;
+    uintptr_t last_page = 0;
+    long stride = 0;
+    // times in a row `stride` was seen
+    int confidence = 0;
+  } stride_entry;
+
+  int degree;
+  uintptr_t region_bytes;
+  std::vector<stride_entry> table;
+};
+
+// Remembers, in a direct-mapped table, the pages trained right after each
+// page (most recent first) and fetches up to `degree` of them when that page
+// is trained again.
+class MarkovPrefetcher : public Prefetcher {
+public:
+  MarkovPrefetcher(int degree, size_t table_size = 4096)
+      : degree(degree), table(table_size) {}
+
+  void train(int tenant, uintptr_t page, uintptr_t page_size,
+             std::vector<uintptr_t> *prefetch) override;
+  std::string getName() const override {
+    return "markov-" + std::to_string(degree);
+  }
+  Prefetcher *clone() const override { return new MarkovPrefetcher(*this); }
+  void appendStateSignature(std::vector<uint64_t> *signature) const override;
+
+private:
+  typedef struct markov_entry {
+    bool valid = false;
+    int tenant = 0;
+    uintptr_t page = 0;
+    std::vector<uintptr_t> successors;
+  } markov_entry;
+
+  markov_entry &entryFor(int tenant, uintptr_t page, uintptr_t page_size);
+
+  int degree;
+  std::vector<markov_entry> table;
+  // the last trained page of every tenant
+  std::map<int, uintptr_t> last_page;
+};
+
+// Build a prefetcher from its `kind` ("next_n", "stride" or "markov").
+// Returns nullptr for "none" or an unknown kind.
+Prefetcher *makePrefetcher(const std::string &kind, int degree);
@@ -0,0 +1,117 @@
+#include "region_heat.h"
+
+#include <algorithm>
+
+void RegionHeatTable::configure(uintptr_t region_bytes_,
+                                uintptr_t min_block_bytes) {
+  region_bytes = region_bytes_;
+  block_bytes = std::max<uintptr_t>(min_block_bytes, (region_bytes + 63) / 64);
+  blocks_per_region =
+      std::max<uintptr_t>(1, (region_bytes + block_bytes - 1) / block_bytes);
+  std::fill(entries.begin(), entries.end(), entry());
+  epoch = 0;
+}
+
+size_t RegionHeatTable::slotOf(int tenant, uint64_t region) const {
+  uint64_t key = region ^ (static_cast<uint64_t>(tenant) << 48);
+  return (key * 0x9e3779b97f4a7c15ULL >> 20) % entries.size();
+}
+
+void RegionHeatTable::decay(entry *e) const {
+  uint32_t elapsed = epoch - e->epoch;
+  if (elapsed == 0) {
+    return;
+  }
+  e->heat = elapsed >= 32 ? 0 : e->heat >> elapsed;
+  e->previous_blocks = elapsed == 1 ? e->blocks : 0;
+  e->blocks = 0;
+  e->epoch = epoch;
+}
+
+void RegionHeatTable::record(int tenant, uintptr_t addr) {
+  uint64_t region = addr / region_bytes;
+  size_t slot = slotOf(tenant, region);
+  entry *coldest = nullptr;
+  entry *target = nullptr;
+  for (size_t probe = 0; probe < kProbeWindow; probe++) {
+    entry *e = &entries[(slot + probe) % entries.size()];
+    if (!e->used) {
+      if (coldest == nullptr || coldest->used) {
+        coldest = e;
+      }
+      continue;
+    }
+    if (e->region == region && e->tenant == tenant) {
+      target = e;
+      break;
+    }
+    decay(e);
+    if (coldest == nullptr || (coldest->used && e->heat < coldest->heat)) {
+      coldest = e;
+    }
+  }
+  if (target == nullptr) {
+    target = coldest;
+    *target = entry();
+    target->region = region;
+    target->tenant = tenant;
+    target->used = true;
+    target->epoch = epoch;
+  }
+  decay(target);
+  if (target->heat < UINT32_MAX) {
+    target->heat++;
+  }
+  target->blocks |= 1ULL << ((addr - region * region_bytes) / block_bytes);
+}
+
+void RegionHeatTable::extractHot(uint32_t min_heat, double min_density,
+                                 std::vector<hot_region> *hot) {
+  size_t first = hot->size();
+  for (entry &e : entries) {
+    if (!e.used) {
+      continue;
+    }
+    decay(&e);
+    if (e.heat < min_heat) {
+      continue;
+    }
+    double density =
+        static_cast<double>(__builtin_popcountll(e.blocks | e.previous_blocks)) /
+        blocks_per_region;
+    if (density >= min_density) {
+      hot->push_back({e.tenant, e.region * region_bytes, e.heat, density});
+    }
+  }
+  std::sort(hot->begin() + first, hot->end(),
+            [](const hot_region &a, const hot_region &b) {
+              return a.heat > b.heat;
+            });
+}
+
+void RegionHeatTable::forget(int tenant, uintptr_t addr_start) {
+  uint64_t region = addr_start / region_bytes;
+  size_t slot = slotOf(tenant, region);
+  for (size_t probe = 0; probe < kProbeWindow; probe++) {
+    entry &e = entries[(slot + probe) % entries.size()];
+    if (e.used && e.region == region && e.tenant == tenant) {
+      e = entry();
+      return;
+    }
+  }
+}
+
+void RegionHeatTable::appendStateSignature(
+    std::vector<uint64_t> *signature) const {
+  signature->push_back(epoch);
+  for (const entry &e : entries) {
+    if (e.used) {
+      signature->push_back(e.region);
+      signature->push_back(e.tenant);
+      signature->push_back(e.heat);
+      signature->push_back(e.epoch);
+      signature->push_back(e.blocks);
+      signature->push_back(e.previous_blocks);
+    }
+  }
+}
@@ -0,0 +1,74 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A region picked out by `RegionHeatTable::extractHot`.
+typedef struct hot_region {
+  int tenant;
+  uintptr_t addr_start;
+  uint32_t heat;
+  // Fraction of the region's blocks touched recently.
+  double density;
+} hot_region;
+
+// Decayed access heat of aligned address regions, kept in a fixed-size
+// open-addressed hash table so recording an access is O(1) and the table
+// never grows. Heat halves every epoch (applied lazily, when an entry is next
+// touched), and each entry remembers which of up to 64 blocks of its region
+// were touched in the current and the previous epoch, so hot regions can be
+// told apart from regions with a few hot bytes. When a region's probe window
+// is full, the coldest entry in it is replaced.
+class RegionHeatTable {
+public:
+  RegionHeatTable(size_t capacity = 4096) : entries(capacity) {}
+
+  // Track regions of `region_bytes`, split into blocks of at least
+  // `min_block_bytes`. Clears the table.
+  void configure(uintptr_t region_bytes, uintptr_t min_block_bytes);
+  bool configured() const { return region_bytes > 0; }
+
+  uintptr_t regionStart(uintptr_t addr) const {
+    return addr / region_bytes * region_bytes;
+  }
+
+  void record(int tenant, uintptr_t addr);
+
+  // Start a new epoch, halving every region's heat.
+  void advanceEpoch() { epoch++; }
+
+  // Append every region with at least `min_heat` whose density is at least
+  // `min_density` to `hot`, hottest first.
+  void extractHot(uint32_t min_heat, double min_density,
+                  std::vector<hot_region> *hot);
+
+  // Stop tracking the region starting at `addr_start`.
+  void forget(int tenant, uintptr_t addr_start);
+
+  // Append the table's contents (see `OCSCache::appendStateSignature`).
+  void appendStateSignature(std::vector<uint64_t> *signature) const;
+
+private:
+  typedef struct entry {
+    uint64_t region = 0;
+    int tenant = 0;
+    bool used = false;
+    uint32_t heat = 0;
+    uint32_t epoch = 0;
+    uint64_t blocks = 0;
+    uint64_t previous_blocks = 0;
+  } entry;
+
+  static constexpr size_t kProbeWindow = 8;
+
+  // Apply the decay of the epochs since `e` was last touched.
+  void decay(entry *e) const;
+  size_t slotOf(int tenant, uint64_t region) const;
+
+  std::vector<entry> entries;
+  uintptr_t region_bytes = 0;
+  uintptr_t block_bytes = 0;
+  int blocks_per_region = 1;
+  uint32_t epoch = 0;
+};
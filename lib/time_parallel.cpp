@@ -0,0 +1,235 @@
+#include "time_parallel.h"
+
+#include <algorithm>
+#include <chrono>
+#include <future>
+#include <iostream>
+
+// A cache's event counters, overall and per tenant and thread.
+typedef struct stats_snapshot {
+  perf_stats totals;
+  std::vector<perf_stats> tenants;
+  std::vector<perf_stats> threads;
+} stats_snapshot;
+
+static stats_snapshot snapshotStats(OCSCache *cache) {
+  return {cache->getPerformanceStats(), cache->getTenantPerformanceStats(),
+          cache->getThreadPerformanceStats()};
+}
+
+// Add the counters accumulated between `before` and `after` (snapshots of the
+// same cache, whose breakdowns only ever grow) to `sum`.
+static void accumulateBreakdownDelta(const std::vector<perf_stats> &before,
+                                     const std::vector<perf_stats> &after,
+                                     std::vector<perf_stats> *sum) {
+  if (sum->size() < after.size()) {
+    sum->resize(after.size());
+  }
+  for (size_t idx = 0; idx < after.size(); idx++) {
+    (*sum)[idx].accumulateDelta(idx < before.size() ? before[idx] : perf_stats(),
+                                after[idx]);
+  }
+}
+
+static void accumulateDelta(const stats_snapshot &before,
+                            const stats_snapshot &after, stats_snapshot *sum) {
+  sum->totals.accumulateDelta(before.totals, after.totals);
+  accumulateBreakdownDelta(before.tenants, after.tenants, &sum->tenants);
+  accumulateBreakdownDelta(before.threads, after.threads, &sum->threads);
+}
+
+// The speculative simulation of one chunk.
+typedef struct speculative_chunk {
+  size_t begin;
+  size_t end;
+  OCSCache *cache = nullptr;
+  // Stats right before the chunk's first access (i.e. after warming up).
+  stats_snapshot start_stats;
+  // State signature and stats after each checkpoint; checkpoint `i` is taken
+  // after `(i + 1) * checkpoint_interval` accesses of the chunk (or at its
+  // end).
+  std::vector<std::vector<uint64_t>> signatures;
+  std::vector<stats_snapshot> checkpoint_stats;
+} speculative_chunk;
+
+static size_t checkpointEnd(const speculative_chunk &chunk, size_t checkpoint,
+                            long interval) {
+  return std::min(chunk.begin + (checkpoint + 1) * interval, chunk.end);
+}
+
+static OCSCache::Status runSpeculativeChunk(
+    const std::vector<mem_access> &accesses, const OCSCache *initial_state,
+    const time_parallel_options &options, speculative_chunk *chunk) {
+  chunk->cache = initial_state->clone();
+  bool hit;
+  size_t warmup_begin =
+      chunk->begin - std::min<size_t>(chunk->begin, options.warmup_accesses);
+  for (size_t idx = warmup_begin; idx < chunk->begin; idx++) {
+    if (chunk->cache->handleMemoryAccess(accesses[idx], &hit) !=
+        OCSCache::Status::OK) {
+      return OCSCache::Status::BAD;
+    }
+  }
+  chunk->start_stats = snapshotStats(chunk->cache);
+
+  for (size_t checkpoint = 0;; checkpoint++) {
+    size_t from = chunk->begin + checkpoint * options.checkpoint_interval;
+    size_t to = checkpointEnd(*chunk, checkpoint, options.checkpoint_interval);
+    if (from >= to) {
+      break;
+    }
+    for (size_t idx = from; idx < to; idx++) {
+      if (chunk->cache->handleMemoryAccess(accesses[idx], &hit) !=
+          OCSCache::Status::OK) {
+        return OCSCache::Status::BAD;
+      }
+    }
+    chunk->signatures.emplace_back();
+    chunk->cache->appendStateSignature(&chunk->signatures.back());
+    chunk->checkpoint_stats.push_back(snapshotStats(chunk->cache));
+  }
+  return OCSCache::Status::OK;
+}
+
+// Reconcile `chunk` given the true state at its start, `true_start`. Adds the
+// chunk's true event counters to `totals` and returns the chunk's true (or,
+// if the budget ran out, best known) end state.
+static OCSCache::Status
+reconcileChunk(const std::vector<mem_access> &accesses,
+               const OCSCache &true_start, const time_parallel_options &options,
+               speculative_chunk *chunk, stats_snapshot *totals,
+               time_parallel_report *report, OCSCache **true_end) {
+  OCSCache *resim = true_start.clone();
+  stats_snapshot resim_start = snapshotStats(resim);
+  bool hit;
+  long budget = options.reconcile_budget;
+
+  for (size_t checkpoint = 0; checkpoint < chunk->signatures.size();
+       checkpoint++) {
+    size_t from = chunk->begin + checkpoint * options.checkpoint_interval;
+    size_t to = checkpointEnd(*chunk, checkpoint, options.checkpoint_interval);
+    for (size_t idx = from; idx < to; idx++) {
+      if (resim->handleMemoryAccess(accesses[idx], &hit) !=
+          OCSCache::Status::OK) {
+        delete resim;
+        return OCSCache::Status::BAD;
+      }
+    }
+    report->reconciled_accesses += to - from;
+
+    std::vector<uint64_t> signature;
+    resim->appendStateSignature(&signature);
+    bool converged = signature == chunk->signatures[checkpoint];
+    bool out_of_budget =
+        budget >= 0 && static_cast<long>(to - chunk->begin) >= budget;
+    bool last_checkpoint = checkpoint + 1 == chunk->signatures.size();
+
+    if (converged || (out_of_budget && !last_checkpoint)) {
+      // Everything up to here is verified, the rest of the chunk is taken
+      // from the speculative simulation (exact iff converged).
+      accumulateDelta(resim_start, snapshotStats(resim), totals);
+      accumulateDelta(chunk->checkpoint_stats[checkpoint],
+                      chunk->checkpoint_stats.back(), totals);
+      if (converged) {
+        report->converged_chunks++;
+      } else {
+        report->unverified_accesses += chunk->end - to;
+      }
+      chunk->cache->mergeBackingPagesFrom(*resim);
+      delete resim;
+      *true_end = chunk->cache;
+      chunk->cache = nullptr;
+      return OCSCache::Status::OK;
+    }
+  }
+
+  // Never converged: the re-simulation covered the whole chunk.
+  accumulateDelta(resim_start, snapshotStats(resim), totals);
+  *true_end = resim;
+  return OCSCache::Status::OK;
+}
+
+OCSCache::Status simulateTimeParallel(const std::vector<mem_access> &accesses,
+                                      OCSCache **cache,
+                                      const time_parallel_options &options,
+                                      time_parallel_report *report) {
+  auto start_time = std::chrono::steady_clock::now();
+  size_t num_chunks = std::max<size_t>(
+      1, std::min<size_t>(options.chunks, accesses.size()));
+  size_t chunk_size = (accesses.size() + num_chunks - 1) / num_chunks;
+  std::vector<speculative_chunk> chunks(num_chunks);
+  for (size_t idx = 0; idx < num_chunks; idx++) {
+    chunks[idx].begin = std::min(idx * chunk_size, accesses.size());
+    chunks[idx].end = std::min((idx + 1) * chunk_size, accesses.size());
+  }
+
+  std::vector<std::future<OCSCache::Status>> futures;
+  for (speculative_chunk &chunk : chunks) {
+    futures.push_back(std::async(std::launch::async, runSpeculativeChunk,
+                                 std::cref(accesses), *cache,
+                                 std::cref(options), &chunk));
+  }
+  OCSCache::Status status = OCSCache::Status::OK;
+  for (auto &future : futures) {
+    if (future.get() != OCSCache::Status::OK) {
+      status = OCSCache::Status::BAD;
+    }
+  }
+  auto speculated_time = std::chrono::steady_clock::now();
+
+  // The first chunk started from the true (initial) state.
+  stats_snapshot totals;
+  OCSCache *true_end = nullptr;
+  if (status == OCSCache::Status::OK) {
+    accumulateDelta(chunks[0].start_stats, snapshotStats(chunks[0].cache),
+                    &totals);
+    true_end = chunks[0].cache;
+    chunks[0].cache = nullptr;
+    report->converged_chunks = 1;
+  }
+
+  for (size_t idx = 1; idx < num_chunks && status == OCSCache::Status::OK;
+       idx++) {
+    OCSCache *next_true_end = nullptr;
+    status = reconcileChunk(accesses, *true_end, options, &chunks[idx],
+                            &totals, report, &next_true_end);
+    delete true_end;
+    true_end = next_true_end;
+  }
+
+  for (speculative_chunk &chunk : chunks) {
+    delete chunk.cache;
+  }
+  if (status != OCSCache::Status::OK) {
+    delete true_end;
+    return status;
+  }
+
+  report->chunks = num_chunks;
+  report->speculative_seconds =
+      std::chrono::duration<double>(speculated_time - start_time).count();
+  report->reconcile_seconds = std::chrono::duration<double>(
+                                  std::chrono::steady_clock::now() -
+                                  speculated_time)
+                                  .count();
+
+  true_end->restoreStats(totals.totals, totals.tenants, totals.threads);
+  delete *cache;
+  *cache = true_end;
+  return OCSCache::Status::OK;
+}
+
+std::ostream &operator<<(std::ostream &os,
+                         const time_parallel_report &report) {
+  os << "Time-Parallel Simulation {\n"
+     << "  Chunks: " << report.chunks << ",\n"
+     << "  Converged Chunks: " << report.converged_chunks << ",\n"
+     << "  Reconciled (Re-simulated) Accesses: " << report.reconciled_accesses
+     << ",\n"
+     << "  Unverified Accesses (Error Bound): " << report.unverified_accesses
+     << ",\n"
+     << "  Speculative Phase: " << report.speculative_seconds << "s,\n"
+     << "  Reconciliation Phase: " << report.reconcile_seconds << "s\n"
+     << "}";
+  return os;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include "ocs_cache.h"
+#include "ocs_structs.h"
+#include <vector>
+
+typedef struct time_parallel_options {
+  // Number of chunks the trace is split into (and threads used).
+  int chunks = 1;
+
+  // Accesses between two state checkpoints of a speculative chunk
+  // simulation. Convergence can only be detected at a checkpoint.
+  long checkpoint_interval = 4096;
+
+  // Accesses preceding a chunk that are simulated (but not counted) to warm
+  // up its approximate starting state.
+  long warmup_accesses = 4096;
+
+  // The most accesses re-simulated while reconciling one chunk (-1 for no
+  // limit). Chunks that don't converge within the budget keep their
+  // speculative results for the rest of the chunk, which bounds the error.
+  long reconcile_budget = -1;
+} time_parallel_options;
+
+typedef struct time_parallel_report {
+  int chunks = 0;
+  // Chunks whose speculative state converged to the true state.
+  int converged_chunks = 0;
+  // Accesses re-simulated during reconciliation (the cost of reconciling).
+  long reconciled_accesses = 0;
+  // Accesses whose outcome was never verified against the true state. Every
+  // event counter is within this many (times the pools per access) of the
+  // sequential result; 0 means the stats are exact.
+  long unverified_accesses = 0;
+  double speculative_seconds = 0.0;
+  double reconcile_seconds = 0.0;
+
+  friend std::ostream &operator<<(std::ostream &os,
+                                  const time_parallel_report &report);
+} time_parallel_report;
+
+// Simulate `accesses` on `*cache` by splitting the trace into chunks that are
+// simulated concurrently, each from an approximate (cold, briefly warmed up)
+// starting state. Chunk boundaries are then reconciled in order by
+// re-simulating each chunk from its predecessor's true end state until the
+// state matches the speculative simulation at a checkpoint, from where the
+// speculative results are exact.
+//
+// `*cache` must be in its initial state. It is replaced by a cache holding
+// the reconstructed end state and event counters of the whole run.
+// Stats are exact for deterministic replacement policies; random replacement
+// is exact up to the choice of random stream per chunk.
+[[nodiscard]] OCSCache::Status
+simulateTimeParallel(const std::vector<mem_access> &accesses, OCSCache **cache,
+                     const time_parallel_options &options,
+                     time_parallel_report *report);
@@ -0,0 +1,262 @@
+#include "timing_model.h"
+
+#include <algorithm>
+#include <cmath>
+
+// The counters an access's latency depends on.
+typedef struct timed_counters {
+  long writeback_bytes;
+  long ocs_pool_hits;
+  long ocs_reconfigurations;
+  long dram_tier_hits;
+  long backing_store_hits;
+  long backing_store_misses;
+  long reconfiguration_fallbacks;
+  long prefetch_bytes;
+} timed_counters;
+
+static timed_counters timedCounters(const perf_stats &stats) {
+  return {stats.backing_store_writeback_bytes + stats.ocs_flush_bytes +
+              stats.dram_tier_writeback_bytes,
+          stats.ocs_pool_hits,
+          stats.ocs_reconfigurations,
+          stats.dram_tier_hits,
+          stats.backing_store_hits,
+          stats.backing_store_misses,
+          stats.reconfiguration_fallbacks,
+          stats.prefetch_bytes};
+}
+
+CalendarQueue::CalendarQueue(long bucket_width_ns, size_t num_buckets)
+    : bucket_width(bucket_width_ns), buckets(num_buckets) {}
+
+void CalendarQueue::push(long time) {
+  size_++;
+  if (time >= cursor_time + bucket_width * static_cast<long>(buckets.size())) {
+    overflow.push(time);
+    return;
+  }
+  // events in the past are due in the current bucket
+  buckets[bucketOf(std::max(time, cursor_time))].push_back(time);
+  in_ring++;
+}
+
+void CalendarQueue::advance() {
+  long year = bucket_width * static_cast<long>(buckets.size());
+  if (in_ring == 0 && !overflow.empty()) {
+    cursor_time = overflow.top() / bucket_width * bucket_width;
+    cursor = bucketOf(cursor_time);
+  }
+  while (true) {
+    while (!overflow.empty() && overflow.top() < cursor_time + year) {
+      buckets[bucketOf(overflow.top())].push_back(overflow.top());
+      overflow.pop();
+      in_ring++;
+    }
+    if (!buckets[cursor].empty()) {
+      return;
+    }
+    cursor_time += bucket_width;
+    cursor = (cursor + 1) % buckets.size();
+  }
+}
+
+long CalendarQueue::top() {
+  advance();
+  const std::vector<long> &bucket = buckets[cursor];
+  return *std::min_element(bucket.begin(), bucket.end());
+}
+
+void CalendarQueue::pop() {
+  advance();
+  std::vector<long> &bucket = buckets[cursor];
+  auto earliest = std::min_element(bucket.begin(), bucket.end());
+  *earliest = bucket.back();
+  bucket.pop_back();
+  in_ring--;
+  size_--;
+}
+
+size_t LatencyHistogram::bucketOf(long latency_ns) {
+  if (latency_ns < kSubBuckets) {
+    return std::max(latency_ns, 0L);
+  }
+  int msb = 63 - __builtin_clzl(latency_ns);
+  size_t sub = (latency_ns >> (msb - 4)) & (kSubBuckets - 1);
+  return (msb - 3) * kSubBuckets + sub;
+}
+
+long LatencyHistogram::bucketBound(size_t bucket) {
+  if (bucket < kSubBuckets) {
+    return bucket;
+  }
+  int msb = bucket / kSubBuckets + 3;
+  long sub = bucket % kSubBuckets;
+  return ((kSubBuckets + sub + 1) << (msb - 4)) - 1;
+}
+
+void LatencyHistogram::record(long latency_ns) {
+  counts[bucketOf(latency_ns)]++;
+  total++;
+  sum += latency_ns;
+  max_latency = std::max(max_latency, latency_ns);
+}
+
+long LatencyHistogram::percentile(double quantile) const {
+  if (total == 0) {
+    return 0;
+  }
+  long rank = std::max(1L, static_cast<long>(std::ceil(quantile * total)));
+  long seen = 0;
+  for (size_t bucket = 0; bucket < counts.size(); bucket++) {
+    seen += counts[bucket];
+    if (seen >= rank) {
+      return std::min(bucketBound(bucket), max_latency);
+    }
+  }
+  return max_latency;
+}
+
+long TimingModel::transfer(long time, long bytes) {
+  long start = std::max(time, link_free_ns);
+  long duration = static_cast<long>(
+      std::ceil(static_cast<double>(bytes) / params.link_bytes_per_ns));
+  link_free_ns = start + duration;
+  report.link_busy_ns += duration;
+  return link_free_ns;
+}
+
+void TimingModel::completeUntil(long time) {
+  while (!completions.empty() && completions.top() <= time) {
+    completions.pop();
+    outstanding_misses--;
+    report.events++;
+  }
+}
+
+[[nodiscard]] OCSCache::Status
+TimingModel::handleMemoryAccess(OCSCache *cache, const mem_access &access,
+                                bool *hit) {
+  long arrival = std::llround(access.timestamp * params.ns_per_timestamp);
+  long issue = started ? std::max(arrival, last_issue_ns) : arrival;
+  if (!started) {
+    first_issue_ns = issue;
+    started = true;
+  }
+  last_issue_ns = issue;
+  completeUntil(issue);
+  report.events++;
+
+  timed_counters before = timedCounters(cache->getStats());
+  if (cache->handleMemoryAccess(access, hit) != OCSCache::Status::OK) {
+    return OCSCache::Status::BAD;
+  }
+  timed_counters after = timedCounters(cache->getStats());
+  timed_counters delta = {
+      after.writeback_bytes - before.writeback_bytes,
+      after.ocs_pool_hits - before.ocs_pool_hits,
+      after.ocs_reconfigurations - before.ocs_reconfigurations,
+      after.dram_tier_hits - before.dram_tier_hits,
+      after.backing_store_hits - before.backing_store_hits,
+      after.backing_store_misses - before.backing_store_misses,
+      after.reconfiguration_fallbacks - before.reconfiguration_fallbacks,
+      after.prefetch_bytes - before.prefetch_bytes};
+
+  long done = issue;
+
+  // victims are written back before their replacements are filled
+  if (delta.writeback_bytes > 0) {
+    transfer(issue, delta.writeback_bytes);
+  }
+
+  if (delta.ocs_pool_hits > 0 || delta.ocs_reconfigurations > 0) {
+    const std::vector<pool_entry *> &ports = cache->getCachedOCSPools();
+    if (port_free_ns.size() < ports.size()) {
+      port_free_ns.resize(ports.size(), 0);
+    }
+    for (size_t port = 0; port < ports.size(); port++) {
+      if (!ports[port]->valid || !ports[port]->touches(access)) {
+        continue;
+      }
+      if (delta.ocs_reconfigurations > 0) {
+        port_free_ns[port] = std::max(issue, port_free_ns[port]) +
+                             params.ocs_reconfiguration_ns;
+        report.events++;
+      }
+      long start = std::max(issue, port_free_ns[port]);
+      report.port_stall_ns += start - issue;
+      done = std::max(done, start + params.ocs_hit_latency_ns);
+    }
+  }
+
+  if (delta.dram_tier_hits > 0) {
+    done = std::max(done, issue + params.dram_hit_latency_ns);
+  }
+
+  if (delta.backing_store_hits > 0) {
+    done = std::max(done, issue + params.backing_hit_latency_ns);
+  }
+
+  for (long miss = 0; miss < delta.backing_store_misses; miss++) {
+    long slot_free = issue;
+    while (outstanding_misses >= std::max(params.max_outstanding_misses, 1)) {
+      slot_free = std::max(slot_free, completions.top());
+      completions.pop();
+      outstanding_misses--;
+      report.events++;
+    }
+    report.mlp_stall_ns += slot_free - issue;
+    long complete = transfer(slot_free, cache->getPageSize()) +
+                    params.far_memory_latency_ns;
+    completions.push(complete);
+    outstanding_misses++;
+    done = std::max(done, complete);
+  }
+
+  // accesses to pools whose port is still reconfiguring go to far memory
+  for (long fallback = 0; fallback < delta.reconfiguration_fallbacks;
+       fallback++) {
+    done = std::max(done, transfer(issue, std::max(access.size, 1)) +
+                              params.far_memory_latency_ns);
+  }
+
+  // prefetches follow the demand fill they were triggered by
+  if (delta.prefetch_bytes > 0) {
+    transfer(issue, delta.prefetch_bytes);
+  }
+
+  last_completion_ns = std::max({last_completion_ns, done, link_free_ns});
+  latencies.record(done - issue);
+  report.timed_accesses++;
+  return OCSCache::Status::OK;
+}
+
+timing_report TimingModel::finish() {
+  completeUntil(last_completion_ns);
+  report.makespan_ns = last_completion_ns - first_issue_ns;
+  report.latency.count = latencies.count();
+  report.latency.mean_ns = latencies.mean();
+  report.latency.p50_ns = latencies.percentile(0.5);
+  report.latency.p99_ns = latencies.percentile(0.99);
+  report.latency.max_ns = latencies.max();
+  return report;
+}
+
+std::ostream &operator<<(std::ostream &os, const timing_report &report) {
+  double link_utilization =
+      report.makespan_ns > 0
+          ? static_cast<double>(report.link_busy_ns) / report.makespan_ns
+          : 0.0;
+  os << "Timing {\n"
+     << "  Timed Accesses: " << report.timed_accesses << ",\n"
+     << "  Events: " << report.events << ",\n"
+     << "  Makespan: " << report.makespan_ns << "ns,\n"
+     << "  Link Utilization: " << link_utilization * 100 << "%,\n"
+     << "  Outstanding Miss Stalls: " << report.mlp_stall_ns << "ns,\n"
+     << "  OCS Port Stalls: " << report.port_stall_ns << "ns,\n"
+     << "  Latency Mean/p50/p99/Max: " << report.latency.mean_ns << "/"
+     << report.latency.p50_ns << "/" << report.latency.p99_ns << "/"
+     << report.latency.max_ns << "ns\n"
+     << "}";
+  return os;
+}
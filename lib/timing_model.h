@@ -0,0 +1,158 @@
+#pragma once
+
+#include "ocs_cache.h"
+#include "ocs_structs.h"
+
+#include <array>
+#include <functional>
+#include <queue>
+#include <vector>
+
+// Parameters of the timing model. Times are in nanoseconds.
+typedef struct timing_params {
+  // Far memory link bandwidth, in bytes per nanosecond (i.e. GB/s).
+  double link_bytes_per_ns = 12.5;
+
+  // Latency of a page transfer from far memory, on top of its serialization
+  // on the link.
+  long far_memory_latency_ns = 1000;
+
+  // Latency of an access served by the local DRAM tier.
+  long dram_hit_latency_ns = 100;
+
+  // Latency of an access to a cached backing store page.
+  long backing_hit_latency_ns = 150;
+
+  // Latency of an access through a configured OCS port.
+  long ocs_hit_latency_ns = 300;
+
+  // Time an OCS port is unavailable while the switch reconfigures it.
+  long ocs_reconfiguration_ns = 10000;
+
+  // The most demand misses outstanding at once (memory-level parallelism).
+  int max_outstanding_misses = 16;
+
+  // Nanoseconds per trace timestamp tick. Accesses are issued in trace order
+  // at their timestamp, but no earlier than the previous access.
+  double ns_per_timestamp = 1.0;
+} timing_params;
+
+// Calendar queue of event times: a ring of fixed-width buckets covering one
+// "year" from the current bucket, and a heap for events beyond it. Events
+// are pushed close to the current time, so push and pop are O(1) amortized.
+class CalendarQueue {
+public:
+  CalendarQueue(long bucket_width_ns = 64, size_t num_buckets = 4096);
+
+  void push(long time);
+  bool empty() const { return size_ == 0; }
+  size_t size() const { return size_; }
+
+  // The earliest event time. The queue must not be empty.
+  long top();
+  void pop();
+
+private:
+  // Move to the bucket holding the earliest event, pulling events from the
+  // overflow heap into the ring as it comes within a year of the cursor.
+  void advance();
+  size_t bucketOf(long time) const {
+    return static_cast<size_t>(time / bucket_width) % buckets.size();
+  }
+
+  long bucket_width;
+  std::vector<std::vector<long>> buckets;
+  // Start time of the current bucket.
+  long cursor_time = 0;
+  size_t cursor = 0;
+  size_t in_ring = 0;
+  size_t size_ = 0;
+  std::priority_queue<long, std::vector<long>, std::greater<long>> overflow;
+};
+
+// Log-linear histogram of latencies: 16 sub-buckets per power of two, so
+// percentiles are exact below 16ns and within 1/16 above.
+class LatencyHistogram {
+public:
+  void record(long latency_ns);
+  // The smallest latency at or above the `quantile` (0 to 1) of recorded
+  // latencies, rounded up to its bucket's bound.
+  long percentile(double quantile) const;
+  long count() const { return total; }
+  double mean() const {
+    return total > 0 ? static_cast<double>(sum) / total : 0.0;
+  }
+  long max() const { return max_latency; }
+
+private:
+  static constexpr int kSubBuckets = 16;
+  static size_t bucketOf(long latency_ns);
+  static long bucketBound(size_t bucket);
+
+  std::array<long, 64 * kSubBuckets> counts = {};
+  long total = 0;
+  long sum = 0;
+  long max_latency = 0;
+};
+
+typedef struct timing_report {
+  long timed_accesses = 0;
+  // Simulated time from the first access until the last transfer completes.
+  long makespan_ns = 0;
+  // Time the far memory link spent transferring.
+  long link_busy_ns = 0;
+  // Time demand misses waited for an outstanding miss slot.
+  long mlp_stall_ns = 0;
+  // Time accesses waited for an OCS port under reconfiguration.
+  long port_stall_ns = 0;
+  long events = 0;
+  latency_summary latency;
+
+  friend std::ostream &operator<<(std::ostream &os,
+                                  const timing_report &report);
+} timing_report;
+
+// Discrete-event timing layered on `OCSCache::handleMemoryAccess`. Every
+// access is run through the cache and classified by the events it caused;
+// its latency then follows from the contention it meets:
+//  - demand misses take an outstanding miss slot (waiting for the earliest
+//    completion if none is free) and are serialized on the far memory link,
+//  - write-backs, flushes and prefetches occupy the link without being waited
+//    for,
+//  - OCS reconfigurations make their port (cache slot) unavailable for
+//    `ocs_reconfiguration_ns`, delaying every access through it,
+//  - accesses the cache served from far memory while their OCS pool was
+//    still being configured (see `reconfiguration_params`) are transferred
+//    over the link.
+// Only off-node accesses are timed; DRAM accesses never reach the model.
+class TimingModel {
+public:
+  TimingModel(const timing_params &params) : params(params) {}
+
+  [[nodiscard]] OCSCache::Status handleMemoryAccess(OCSCache *cache,
+                                                    const mem_access &access,
+                                                    bool *hit);
+
+  // Drain outstanding events and summarize the run.
+  timing_report finish();
+
+private:
+  // Occupy the link with `bytes` starting no earlier than `time`, returning
+  // when the transfer leaves the link.
+  long transfer(long time, long bytes);
+  void completeUntil(long time);
+
+  timing_params params;
+  CalendarQueue completions;
+  LatencyHistogram latencies;
+  timing_report report;
+
+  long last_issue_ns = 0;
+  long link_free_ns = 0;
+  long last_completion_ns = 0;
+  int outstanding_misses = 0;
+  // Time each OCS port (slot of the OCS cache) becomes available again.
+  std::vector<long> port_free_ns;
+  bool started = false;
+  long first_issue_ns = 0;
+};
@@ -0,0 +1,283 @@
+#include "trace_merge.h"
+
+#include <cerrno>
+#include <climits>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <iostream>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedTraceCursor::~MappedTraceCursor() {
+  if (stream_fd >= 0) {
+    if (stream_fd != STDIN_FILENO) {
+      close(stream_fd);
+    }
+  } else if (data != nullptr) {
+    munmap(const_cast<char *>(data), length);
+  }
+}
+
+OCSCache::Status MappedTraceCursor::open(const std::string &trace_filename) {
+  int fd = trace_filename == "-" ? STDIN_FILENO
+                                 : ::open(trace_filename.c_str(), O_RDONLY);
+  if (fd < 0) {
+    std::cerr << "Error opening file " << trace_filename << std::endl;
+    return OCSCache::Status::BAD;
+  }
+  struct stat st;
+  if (fstat(fd, &st) != 0) {
+    if (fd != STDIN_FILENO) {
+      close(fd);
+    }
+    return OCSCache::Status::BAD;
+  }
+  bool streamable = S_ISFIFO(st.st_mode) || S_ISCHR(st.st_mode) ||
+                    S_ISSOCK(st.st_mode) || fd == STDIN_FILENO;
+  if (!S_ISREG(st.st_mode) && !streamable) {
+    if (fd != STDIN_FILENO) {
+      close(fd);
+    }
+    std::cerr << trace_filename << " is neither a file nor a stream"
+              << std::endl;
+    return OCSCache::Status::BAD;
+  }
+  if (!S_ISREG(st.st_mode)) {
+    stream_fd = fd;
+    // enough to tell a compressed trace apart
+    while (stream_buffer.size() < 8 && readStream()) {
+    }
+    if (CompressedTraceDecoder::isCompressed(data, length)) {
+      while (readStream()) {
+      }
+      if (stream_failed) {
+        return OCSCache::Status::BAD;
+      }
+      is_compressed = true;
+      return compressed.attach(data, length);
+    }
+    scanMetadata();
+    return stream_failed ? OCSCache::Status::BAD : OCSCache::Status::OK;
+  }
+  length = st.st_size;
+  if (length > 0) {
+    void *mapping = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (mapping == MAP_FAILED) {
+      if (fd != STDIN_FILENO) {
+        close(fd);
+      }
+      std::cerr << "Error mapping file " << trace_filename << std::endl;
+      return OCSCache::Status::BAD;
+    }
+    madvise(mapping, length, MADV_SEQUENTIAL);
+    data = static_cast<const char *>(mapping);
+  }
+  if (fd != STDIN_FILENO) {
+    close(fd); // the mapping stays valid
+  }
+  if (CompressedTraceDecoder::isCompressed(data, length)) {
+    is_compressed = true;
+    return compressed.attach(data, length);
+  }
+  scanMetadata();
+  return OCSCache::Status::OK;
+}
+
+bool MappedTraceCursor::isStream(const std::string &trace_filename) {
+  struct stat st;
+  if (trace_filename == "-") {
+    return true;
+  }
+  return stat(trace_filename.c_str(), &st) == 0 &&
+         (S_ISFIFO(st.st_mode) || S_ISCHR(st.st_mode) ||
+          S_ISSOCK(st.st_mode));
+}
+
+bool MappedTraceCursor::readStream() {
+  if (stream_fd < 0 || stream_ended) {
+    return false;
+  }
+  size_t filled = stream_buffer.size();
+  stream_buffer.resize(filled + kStreamChunkBytes);
+  ssize_t bytes;
+  do {
+    bytes = read(stream_fd, &stream_buffer[filled], kStreamChunkBytes);
+  } while (bytes < 0 && errno == EINTR);
+  if (bytes <= 0) {
+    if (bytes < 0) {
+      std::cerr << "Error reading trace stream: " << strerror(errno)
+                << std::endl;
+      stream_failed = true;
+    }
+    stream_ended = true;
+    bytes = 0;
+  }
+  stream_buffer.resize(filled + bytes);
+  data = stream_buffer.data();
+  length = stream_buffer.size();
+  return bytes > 0;
+}
+
+const char *MappedTraceCursor::lineEnd(size_t line_start) {
+  while (true) {
+    const char *end = static_cast<const char *>(
+        memchr(data + line_start, '\n', length - line_start));
+    if (end != nullptr || !readStream()) {
+      return end == nullptr ? data + length : end;
+    }
+  }
+}
+
+void MappedTraceCursor::scanMetadata() {
+  static const char kDramRegion[] = "#dram_region,";
+  size_t scan = 0;
+  int headers = header_lines;
+  while (scan < length || readStream()) {
+    const char *end = lineEnd(scan);
+    const char *line = data + scan;
+    scan = end - data + 1;
+
+    if (line < end && *line == '#') {
+      if (static_cast<size_t>(end - line) > strlen(kDramRegion) &&
+          strncmp(line, kDramRegion, strlen(kDramRegion)) == 0) {
+        // copy the line out, the mapping isn't null-terminated
+        std::string fields(line + strlen(kDramRegion), end);
+        char *field_end;
+        uintptr_t start = strtoull(fields.c_str(), &field_end, 0);
+        uintptr_t region_end =
+            *field_end == ',' ? strtoull(field_end + 1, nullptr, 0) : 0;
+        if (region_end > start) {
+          dram_regions.push_back({start, region_end});
+        }
+      }
+      continue;
+    }
+    if (headers > 0) {
+      headers--;
+      continue;
+    }
+    if (line == end || *line == '\r') {
+      continue;
+    }
+    break; // first record
+  }
+}
+
+// Advance `*p` past the next comma (or to `end`).
+static void skipField(const char **p, const char *end) {
+  const char *c = static_cast<const char *>(memchr(*p, ',', end - *p));
+  *p = c != nullptr ? c + 1 : end;
+}
+
+// Parse a (possibly negative) decimal field starting at `*p` and advance `*p`
+// past the following comma. Fields without a leading number parse as 0 and
+// clear `*valid`.
+static long parseField(const char **p, const char *end, bool *valid) {
+  const char *c = *p;
+  bool negative = c < end && *c == '-';
+  c += negative ? 1 : 0;
+  const char *digits = c;
+  long value = 0;
+  while (c < end && *c >= '0' && *c <= '9') {
+    value = value * 10 + (*c - '0');
+    c++;
+  }
+  *valid &= c > digits;
+  *p = c;
+  skipField(p, end);
+  return negative ? -value : value;
+}
+
+bool MappedTraceCursor::next(mem_access *access) {
+  if (is_compressed) {
+    return compressed.next(access);
+  }
+  while (pos < length || readStream()) {
+    if (stream_fd >= 0 && pos >= kStreamChunkBytes) {
+      // drop the records already parsed, so a stream is never held in full
+      stream_buffer.erase(0, pos);
+      data = stream_buffer.data();
+      length = stream_buffer.size();
+      pos = 0;
+    }
+    const char *end = lineEnd(pos);
+    const char *line = data + pos;
+    pos = end - data + 1;
+
+    if (line < end && *line == '#') { // metadata, see scanMetadata
+      continue;
+    }
+    if (header_lines > 0) {
+      header_lines--;
+      continue;
+    }
+    if (line == end || *line == '\r') { // blank line
+      continue;
+    }
+
+    const char *p = line;
+    bool valid = true;
+    access->timestamp = parseField(&p, end, &valid);
+    long addr = parseField(&p, end, &valid);
+    long size = parseField(&p, end, &valid);
+    // access type, `W` for stores (anything else is a load)
+    access->is_write = p < end && (*p == 'W' || *p == 'w');
+    skipField(&p, end);
+    // an optional fifth column tags the access with its tenant
+    long tenant = p < end ? parseField(&p, end, &valid) : 0;
+    // tenants index per-tenant state, and every access covers some bytes
+    valid &= addr >= 0 && size > 0 && size <= INT_MAX && tenant >= 0 &&
+             tenant <= INT_MAX;
+    access->addr = static_cast<uintptr_t>(addr);
+    access->size = static_cast<int>(size);
+    access->tenant = static_cast<int>(tenant);
+    if (!valid) {
+      // e.g. a corrupt or truncated line, rather than an access to address 0
+      malformed_records++;
+      continue;
+    }
+    return true;
+  }
+  return false;
+}
+
+OCSCache::Status
+TraceMerger::open(const std::vector<std::string> &trace_filenames) {
+  cursors = std::vector<MappedTraceCursor>(trace_filenames.size());
+  heads.resize(trace_filenames.size());
+  for (size_t idx = 0; idx < trace_filenames.size(); idx++) {
+    if (cursors[idx].open(trace_filenames[idx]) != OCSCache::Status::OK) {
+      return OCSCache::Status::BAD;
+    }
+    if (cursors[idx].next(&heads[idx])) {
+      heads[idx].thread = idx;
+      heap.push({heads[idx].timestamp, idx});
+    }
+  }
+  return OCSCache::Status::OK;
+}
+
+std::vector<addr_subspace> TraceMerger::getDramRegions() const {
+  std::vector<addr_subspace> regions;
+  for (const MappedTraceCursor &cursor : cursors) {
+    regions.insert(regions.end(), cursor.getDramRegions().begin(),
+                   cursor.getDramRegions().end());
+  }
+  return regions;
+}
+
+bool TraceMerger::next(mem_access *access) {
+  if (heap.empty()) {
+    return false;
+  }
+  size_t idx = heap.top().second;
+  heap.pop();
+  *access = heads[idx];
+  if (cursors[idx].next(&heads[idx])) {
+    heads[idx].thread = idx;
+    heap.push({heads[idx].timestamp, idx});
+  }
+  return true;
+}
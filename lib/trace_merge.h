@@ -0,0 +1,118 @@
+#pragma once
+
+#include "compressed_trace.h"
+#include "ocs_cache.h"
+#include "ocs_structs.h"
+#include <queue>
+#include <string>
+#include <vector>
+
+// A forward-only cursor over a memory-mapped CSV trace
+// (`timestamp,address,size,type[,tenant]` after two header lines). Records
+// are parsed in place, nothing is copied out of the mapping.
+//
+// Lines starting with `#` carry metadata and are not records. A
+// `#dram_region,<start>,<end>` line (decimal or 0x-prefixed hex) declares an
+// address range that is always served by local DRAM.
+//
+// Traces in the compressed format (see `CompressedTraceDecoder`) are detected
+// by their magic and decoded a block at a time instead.
+//
+// Pipes, FIFOs and stdin (`-`) can't be mapped, so they are streamed: CSV
+// traces are read in large chunks as the records are parsed, compressed ones
+// (whose block index trails the blocks) in full before decoding. Either way
+// the stream is read exactly once.
+class MappedTraceCursor {
+public:
+  MappedTraceCursor() = default;
+  ~MappedTraceCursor();
+  MappedTraceCursor(const MappedTraceCursor &) = delete;
+  MappedTraceCursor &operator=(const MappedTraceCursor &) = delete;
+
+  [[nodiscard]] OCSCache::Status open(const std::string &trace_filename);
+
+  // If `open` would stream `trace_filename` (stdin, a pipe, a character device
+  // or a socket) rather than map it.
+  static bool isStream(const std::string &trace_filename);
+
+  // Parse the next record into `access`, skipping malformed ones (whose
+  // timestamp, address, size or tenant isn't a number, or whose address or
+  // tenant is negative or size isn't positive). Returns false at the end of
+  // the trace.
+  bool next(mem_access *access);
+
+  // The records `next` skipped so far.
+  size_t malformedRecords() const { return malformed_records; }
+
+  // If reading a streamed trace failed, so `next` ended it early.
+  bool failed() const { return stream_failed; }
+
+  // DRAM regions declared by metadata lines ahead of the first record.
+  const std::vector<addr_subspace> &getDramRegions() const {
+    return is_compressed ? compressed.getDramRegions() : dram_regions;
+  }
+
+  // The decoder of a compressed trace, null for CSV traces.
+  const CompressedTraceDecoder *getCompressed() const {
+    return is_compressed ? &compressed : nullptr;
+  }
+
+  static constexpr size_t kStreamChunkBytes = 1 << 20;
+
+private:
+  // Collect the metadata lines that precede the first record.
+  void scanMetadata();
+
+  // The end of the line starting at `line_start`, reading more of a stream
+  // until it is complete. Streaming may move `data`.
+  const char *lineEnd(size_t line_start);
+
+  // Append up to `kStreamChunkBytes` of the stream to `stream_buffer`.
+  // Returns false at the end of the stream.
+  bool readStream();
+
+  const char *data = nullptr;
+  size_t length = 0;
+  size_t pos = 0;
+
+  // -1 unless the trace is streamed, in which case [data, data + length) is
+  // the part of it in `stream_buffer`
+  int stream_fd = -1;
+  bool stream_ended = false;
+  bool stream_failed = false;
+  std::string stream_buffer;
+
+  int header_lines = 2;
+  size_t malformed_records = 0;
+  std::vector<addr_subspace> dram_regions;
+
+  bool is_compressed = false;
+  CompressedTraceDecoder compressed;
+};
+
+// Streams the records of several traces (e.g. one per application thread)
+// merged by timestamp, using a min-heap over one cursor per trace. Ties are
+// broken by trace index. Each record is tagged with the index of the trace it
+// came from in `mem_access::thread`.
+class TraceMerger {
+public:
+  [[nodiscard]] OCSCache::Status
+  open(const std::vector<std::string> &trace_filenames);
+
+  // Pop the next record in timestamp order. Returns false once every trace
+  // is exhausted.
+  bool next(mem_access *access);
+
+  // Union of the DRAM regions declared by every trace.
+  std::vector<addr_subspace> getDramRegions() const;
+
+private:
+  typedef std::pair<long, size_t> heap_entry; // (timestamp, trace index)
+
+  std::vector<MappedTraceCursor> cursors;
+  // The record each cursor is currently positioned on.
+  std::vector<mem_access> heads;
+  std::priority_queue<heap_entry, std::vector<heap_entry>,
+                      std::greater<heap_entry>>
+      heap;
+};
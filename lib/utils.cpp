@@ -1,7 +1,15 @@
 #include "utils.h"
+#include "ocs_cache_sim/lib/compressed_trace.h"
+#include "ocs_cache_sim/lib/dram_filter.h"
 #include "ocs_cache_sim/lib/ocs_structs.h"
+#include "ocs_cache_sim/lib/trace_merge.h"
+#include <algorithm>
+#include <cmath>
 #include <fstream>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <thread>
 
 std::vector<addr_subspace>
 findUncoveredRanges(const mem_access &access,
@@ -14,10 +22,16 @@ findUncoveredRanges(const mem_access &access,
     bool uncovered = true;
 
     for (const auto &page : *pages) {
-      if (page->range.addr_start <= currentAddress &&
-          currentAddress < page->range.addr_end) {
-        currentAddress = page->range.addr_end;
-        uncovered = false;
+      for (int idx = 0; idx < page->num_intervals; idx++) {
+        const addr_interval &interval = page->intervals[idx];
+        if (interval.addr_start <= currentAddress &&
+            currentAddress < interval.addr_end) {
+          currentAddress = interval.addr_end;
+          uncovered = false;
+          break;
+        }
+      }
+      if (!uncovered) {
         break;
       }
     }
@@ -25,11 +39,14 @@ findUncoveredRanges(const mem_access &access,
     if (uncovered) {
       uintptr_t nextCovered = endAddress;
       for (const auto &page : *pages) {
-        if (page->range.addr_start > currentAddress) {
-          nextCovered = std::min(nextCovered, page->range.addr_start);
+        for (int idx = 0; idx < page->num_intervals; idx++) {
+          if (page->intervals[idx].addr_start > currentAddress) {
+            nextCovered =
+                std::min(nextCovered, page->intervals[idx].addr_start);
+          }
         }
       }
-      addr_subspace sp = {currentAddress, nextCovered};
+      addr_subspace sp = {currentAddress, nextCovered, access.tenant};
       uncoveredRanges.emplace_back(sp);
       DEBUG_LOG("uncovered range from " << access << ": " << sp << std::endl);
       currentAddress = nextCovered;
@@ -39,70 +56,521 @@ findUncoveredRanges(const mem_access &access,
   return uncoveredRanges;
 }
 
-[[nodiscard]] OCSCache::Status simulateTrace(const std::string &trace_filename, int n_lines, int sim_first_n_lines,
-                                             OCSCache *cache, bool summarize_perf) {
-  std::ifstream trace(trace_filename);
-  if (!trace.is_open()) {
-    std::cerr << "Error opening file" << std::endl;
+// Print how the slots were split between the OCS and backing store caches
+// over the run, if the cache repartitioned them.
+static void reportSlotPartitions(const OCSCache &cache) {
+  const std::vector<slot_partition> &history = cache.getSlotPartitionHistory();
+  if (history.empty()) {
+    return;
+  }
+  std::cerr << "Slot partition over time (off-node accesses: OCS/backing "
+               "store slots):";
+  for (const slot_partition &partition : history) {
+    std::cerr << " " << partition.off_node_accesses << ": "
+              << partition.ocs_slots << "/" << partition.backing_store_slots;
+  }
+  std::cerr << std::endl;
+}
+
+[[nodiscard]] OCSCache::Status loadTrace(const std::string &trace_filename,
+                                         int sim_first_n_lines,
+                                         std::vector<mem_access> *accesses,
+                                         std::vector<addr_subspace> *dram_regions) {
+  MappedTraceCursor trace;
+  if (trace.open(trace_filename) != OCSCache::Status::OK) {
     return OCSCache::Status::BAD;
   }
-  std::string line;
-  // Reading the header line
-  int header_lines = 2;
-  int line_number = 0;
+  if (dram_regions != nullptr) {
+    *dram_regions = trace.getDramRegions();
+  }
 
-  if (n_lines != -1) {
-    std::cout << "trace has " << n_lines - header_lines << " accesses"
-              << std::endl;
-  } else {
-    std::cout << "trace has an unkown number of accesses" << std::endl;
+  std::cerr << "Decoding Trace...\n";
+  if (const CompressedTraceDecoder *compressed = trace.getCompressed()) {
+    // blocks decode independently, so spread them over every core
+    int threads = std::max<int>(std::thread::hardware_concurrency(), 1);
+    if (compressed->decodeAll(std::max(sim_first_n_lines, 0), threads,
+                              accesses) != OCSCache::Status::OK) {
+      return OCSCache::Status::BAD;
+    }
+    std::cerr << "Decoded " << accesses->size() << " accesses" << std::endl;
+    return OCSCache::Status::OK;
   }
-  std::cerr << "Simulating Trace...\n";
-  // Reading each line of the file
-  while (getline(trace, line)) {
-    if (header_lines > 0) {
-      header_lines--;
-      continue;
+  mem_access access;
+  while (trace.next(&access)) {
+    accesses->push_back(access);
+
+    if (sim_first_n_lines > 0 &&
+        accesses->size() >= static_cast<size_t>(sim_first_n_lines)) {
+      break;
     }
+  }
+  if (trace.failed()) {
+    return OCSCache::Status::BAD;
+  }
+  if (trace.malformedRecords() > 0) {
+    std::cerr << "Skipped " << trace.malformedRecords()
+              << " malformed records" << std::endl;
+  }
+  std::cerr << "Decoded " << accesses->size() << " accesses" << std::endl;
 
-    std::istringstream ss(line);
-    std::string token;
-    std::vector<std::string> columns;
+  return OCSCache::Status::OK;
+}
 
-    // Splitting line into columns
-    while (getline(ss, token, ',')) {
-      columns.push_back(token);
+[[nodiscard]] OCSCache::Status
+loadTenantTraces(const std::vector<std::string> &trace_filenames,
+                 int sim_first_n_lines, std::vector<mem_access> *accesses,
+                 std::vector<addr_subspace> *dram_regions) {
+  TraceMerger merger;
+  if (merger.open(trace_filenames) != OCSCache::Status::OK) {
+    return OCSCache::Status::BAD;
+  }
+  if (dram_regions != nullptr) {
+    *dram_regions = merger.getDramRegions();
+  }
+
+  mem_access access;
+  while (merger.next(&access)) {
+    // every trace is its own tenant (single-threaded) process
+    access.tenant = access.thread;
+    access.thread = 0;
+    accesses->push_back(access);
+
+    if (sim_first_n_lines > 0 &&
+        accesses->size() >= static_cast<size_t>(sim_first_n_lines)) {
+      break;
     }
+  }
+  std::cerr << "Interleaved " << accesses->size() << " accesses from "
+            << trace_filenames.size() << " tenants" << std::endl;
+
+  return OCSCache::Status::OK;
+}
+
+[[nodiscard]] OCSCache::Status
+findMergedTraceDramRegions(const std::vector<std::string> &trace_filenames,
+                           int sim_first_n_lines, bool detect_stack,
+                           std::vector<addr_subspace> *dram_regions) {
+  TraceMerger merger;
+  if (merger.open(trace_filenames) != OCSCache::Status::OK) {
+    return OCSCache::Status::BAD;
+  }
+  *dram_regions = merger.getDramRegions();
+  if (!dram_regions->empty() || !detect_stack) {
+    return OCSCache::Status::OK;
+  }
+
+  StackRegionDetector detector;
+  mem_access access;
+  long scanned = 0;
+  while (merger.next(&access) &&
+         (sim_first_n_lines <= 0 || scanned++ < sim_first_n_lines)) {
+    detector.observe(access.addr);
+  }
+  detector.detect(dram_regions);
+  return OCSCache::Status::OK;
+}
 
-    // long timestamp = stol(columns[1]);
-    uintptr_t address = stol(columns[1]);
-    int size = stoi(columns[2]);
-    // std::string type = columns[3];
+[[nodiscard]] OCSCache::Status
+simulateMergedTraces(const std::vector<std::string> &trace_filenames,
+                     int sim_first_n_lines, OCSCache *cache,
+                     bool summarize_perf, const timing_params *timing) {
+  TraceMerger merger;
+  if (merger.open(trace_filenames) != OCSCache::Status::OK) {
+    return OCSCache::Status::BAD;
+  }
 
+  std::cerr << "Simulating " << trace_filenames.size()
+            << " merged per-thread traces...\n";
+  mem_access access;
+  long simulated = 0;
+  std::unique_ptr<TimingModel> timing_model;
+  if (timing != nullptr) {
+    timing_model = std::make_unique<TimingModel>(*timing);
+  }
+  while (merger.next(&access)) {
     bool hit = false;
-    if (cache->handleMemoryAccess({address, size}, &hit) !=
-        OCSCache::Status::OK) {
+    OCSCache::Status status =
+        timing_model ? timing_model->handleMemoryAccess(cache, access, &hit)
+                     : cache->handleMemoryAccess(access, &hit);
+    if (status != OCSCache::Status::OK) {
+      std::cout << "handleMemoryAccess failed somewhere :(\n";
+      return OCSCache::Status::BAD;
+    }
+
+    simulated++;
+    if (sim_first_n_lines > 0 && simulated >= sim_first_n_lines) {
+      break;
+    }
+  }
+
+  std::cerr << std::endl << "Simulation complete!" << std::endl;
+  if (timing_model) {
+    timing_report report = timing_model->finish();
+    cache->setLatencySummary(report.latency);
+    std::cerr << report << std::endl;
+  }
+  std::cerr << cache->getPerformanceStats(/*summary=*/summarize_perf);
+  reportSlotPartitions(*cache);
+  return OCSCache::Status::OK;
+}
+
+[[nodiscard]] OCSCache::Status
+simulateAccesses(const std::vector<mem_access> &accesses, OCSCache *cache,
+                 bool summarize_perf, const timing_params *timing,
+                 const PageResolvedTrace *resolved) {
+  std::cerr << "Simulating Trace...\n";
+  std::unique_ptr<TimingModel> timing_model;
+  if (timing != nullptr) {
+    timing_model = std::make_unique<TimingModel>(*timing);
+  }
+  // Accesses to local DRAM don't touch the cache's state, so runs of them are
+  // only counted. Runs of off-node accesses to one page are handed to the
+  // cache together, unless they have to be timed one by one.
+  PageResolvedTrace own_resolution;
+  if (resolved == nullptr ||
+      !resolved->matches(accesses, cache->getPageSize(),
+                         cache->getDramRegions())) {
+    own_resolution.resolve(accesses, cache->getPageSize(),
+                           cache->getDramRegions());
+    resolved = &own_resolution;
+  }
+
+  constexpr size_t kProgressInterval = 4096;
+  const std::vector<resolved_access> &records = resolved->records();
+  for (size_t idx = 0; idx < records.size(); idx++) {
+    const resolved_access &record = records[idx];
+    const mem_access &access = accesses[record.index];
+    if (record.is_dram) {
+      cache->recordDramHits(access.tenant, access.thread, record.count);
+      continue;
+    }
+    OCSCache::Status status = OCSCache::Status::OK;
+    if (timing_model) {
+      for (uint32_t repeat = 0;
+           repeat < record.repeats && status == OCSCache::Status::OK;
+           repeat++) {
+        bool hit = false;
+        status = timing_model->handleMemoryAccess(
+            cache, accesses[record.index + repeat], &hit);
+      }
+    } else if (record.repeats == 1) {
+      bool hit = false;
+      status = cache->handleOffNodeAccess(access, record.first_page, &hit);
+    } else {
+      long hits = 0;
+      status = cache->handleOffNodeRun(&access, record.repeats,
+                                       record.first_page, &hits);
+    }
+    if (status != OCSCache::Status::OK) {
       std::cout << "handleMemoryAccess failed somewhere :(\n";
       return OCSCache::Status::BAD;
     }
 
-	int total_line_number = sim_first_n_lines > 0 ? sim_first_n_lines : n_lines;
+    if (!DEBUG && idx % kProgressInterval == 0) {
+      printProgress(static_cast<double>(record.index) / accesses.size());
+    }
+  }
+
+  std::cerr << std::endl << "Simulation complete!" << std::endl;
+  if (timing_model) {
+    timing_report report = timing_model->finish();
+    cache->setLatencySummary(report.latency);
+    std::cerr << report << std::endl;
+  }
+  std::cerr << cache->getPerformanceStats(/*summary=*/summarize_perf);
+  reportSlotPartitions(*cache);
+  return OCSCache::Status::OK;
+}
+
+[[nodiscard]] OCSCache::Status
+simulateTrace(const std::string &trace_filename, int n_lines,
+              int sim_first_n_lines, const std::vector<OCSCache *> &caches,
+              bool summarize_perf, const timing_params *timing) {
+  MappedTraceCursor trace;
+  if (trace.open(trace_filename) != OCSCache::Status::OK) {
+    return OCSCache::Status::BAD;
+  }
+  if (!trace.getDramRegions().empty()) {
+    for (OCSCache *cache : caches) {
+      cache->setDramRegions(trace.getDramRegions());
+    }
+  }
+  std::vector<std::unique_ptr<TimingModel>> timing_models(caches.size());
+  if (timing != nullptr) {
+    for (std::unique_ptr<TimingModel> &timing_model : timing_models) {
+      timing_model = std::make_unique<TimingModel>(*timing);
+    }
+  }
+  int header_lines = 2;
+  int line_number = 0;
+
+  if (n_lines != -1) {
+    std::cout << "trace has " << n_lines - header_lines << " accesses"
+              << std::endl;
+  } else {
+    std::cout << "trace has an unkown number of accesses" << std::endl;
+  }
+  std::cerr << "Simulating Trace...\n";
+  // Reading each record of the file
+  mem_access access;
+  while (trace.next(&access)) {
+    for (size_t idx = 0; idx < caches.size(); idx++) {
+      bool hit = false;
+      OCSCache::Status status =
+          timing_models[idx]
+              ? timing_models[idx]->handleMemoryAccess(caches[idx], access,
+                                                       &hit)
+              : caches[idx]->handleMemoryAccess(access, &hit);
+      if (status != OCSCache::Status::OK) {
+        std::cout << "handleMemoryAccess failed somewhere :(\n";
+        return OCSCache::Status::BAD;
+      }
+    }
+
+    int total_line_number = sim_first_n_lines > 0 ? sim_first_n_lines : n_lines;
     if (!DEBUG && n_lines > 0) { // TODO this shouldn't be done every line
       printProgress(static_cast<double>(line_number) / total_line_number);
     }
 
     line_number++;
-	if (line_number >= sim_first_n_lines && sim_first_n_lines > 0) {
+    if (line_number >= sim_first_n_lines && sim_first_n_lines > 0) {
       break;
-	}
+    }
+  }
+  if (trace.failed()) {
+    return OCSCache::Status::BAD;
+  }
+  if (trace.malformedRecords() > 0) {
+    std::cerr << "Skipped " << trace.malformedRecords()
+              << " malformed records" << std::endl;
   }
 
   std::cerr << std::endl << "Simulation complete!" << std::endl;
-  std::cerr << cache->getPerformanceStats(/*summary=*/summarize_perf);
-  trace.close();
+  for (size_t idx = 0; idx < caches.size(); idx++) {
+    std::cerr << caches[idx]->getName() << std::endl;
+    if (timing_models[idx]) {
+      timing_report report = timing_models[idx]->finish();
+      caches[idx]->setLatencySummary(report.latency);
+      std::cerr << report << std::endl;
+    }
+    std::cerr << caches[idx]->getPerformanceStats(/*summary=*/summarize_perf);
+    reportSlotPartitions(*caches[idx]);
+  }
   return OCSCache::Status::OK;
 }
 
+// The derived rates reported for every cache.
+typedef struct perf_rates {
+  double ocs_utilization;
+  double backing_store_utilization;
+  double ocs_hit_rate;
+  double backing_store_hit_rate;
+  double promotion_rate;
+  // prefetched pages later used, per prefetch and per would-be miss
+  double prefetch_accuracy;
+  double prefetch_coverage;
+} perf_rates;
+
+static perf_rates computeRates(const perf_stats &stats) {
+  long backing_store_accesses =
+      (stats.backing_store_hits + stats.backing_store_misses);
+  long ocs_accesses = (stats.ocs_pool_hits + stats.ocs_reconfigurations);
+
+  perf_rates rates;
+  rates.ocs_hit_rate =
+      ocs_accesses > 0 ? static_cast<double>(stats.ocs_pool_hits) / ocs_accesses
+                       : 0.0;
+
+  rates.ocs_utilization = static_cast<double>(ocs_accesses) / stats.accesses;
+  rates.backing_store_utilization =
+      static_cast<double>(backing_store_accesses) / stats.accesses;
+
+  rates.backing_store_hit_rate =
+      backing_store_accesses > 0
+          ? static_cast<double>(stats.backing_store_hits) /
+                backing_store_accesses
+          : 0.0;
+
+  rates.promotion_rate = stats.candidates_created > 0
+                             ? static_cast<double>(stats.candidates_promoted) /
+                                   stats.candidates_created
+                             : 0.0;
+
+  rates.prefetch_accuracy =
+      stats.prefetches_issued > 0
+          ? static_cast<double>(stats.prefetch_hits) / stats.prefetches_issued
+          : 0.0;
+  long would_be_misses = stats.prefetch_hits + stats.backing_store_misses;
+  rates.prefetch_coverage =
+      would_be_misses > 0
+          ? static_cast<double>(stats.prefetch_hits) / would_be_misses
+          : 0.0;
+  return rates;
+}
+
+// Two-sided 95% Student-t critical values for 1..30 degrees of freedom; we
+// fall back to the normal approximation past that.
+static double tCritical95(size_t degrees_of_freedom) {
+  static const double table[] = {
+      12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+      2.201,  2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+      2.080,  2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042};
+  if (degrees_of_freedom == 0) {
+    return 0.0;
+  }
+  if (degrees_of_freedom <= 30) {
+    return table[degrees_of_freedom - 1];
+  }
+  return 1.960;
+}
+
+// Write the mean, standard deviation and 95% confidence interval of every
+// rate for each group of caches sharing a name (i.e. the same policy run with
+// different seeds). Groups with a single member are skipped.
+static void writeEnsembleSummary(const std::vector<OCSCache *> &caches,
+                                 const std::string &trace_filename,
+                                 std::ofstream &results_file) {
+  // keep groups (a policy at a page size) in the order the caches were given
+  typedef std::pair<std::string, uintptr_t> group_key;
+  std::vector<group_key> keys;
+  std::map<group_key, std::vector<perf_rates>> groups;
+  for (OCSCache *cache : caches) {
+    group_key key = {cache->getName(), cache->getPageSize()};
+    if (groups.find(key) == groups.end()) {
+      keys.push_back(key);
+    }
+    groups[key].push_back(computeRates(cache->getPerformanceStats()));
+  }
+
+  bool wrote_header = false;
+  for (const group_key &key : keys) {
+    const std::vector<perf_rates> &group = groups[key];
+    if (group.size() < 2) {
+      continue;
+    }
+    if (!wrote_header) {
+      results_file << std::endl
+                   << "Cache Name, Trace File, Page Size, Seeds, Metric, Mean, "
+                      "Std Dev, 95% CI Low, 95% CI High"
+                   << std::endl;
+      wrote_header = true;
+    }
+
+    std::vector<std::pair<std::string, double perf_rates::*>> metrics = {
+        {"NFM Utilization", &perf_rates::ocs_utilization},
+        {"Backing Store Utilization", &perf_rates::backing_store_utilization},
+        {"NFM Hit Rate", &perf_rates::ocs_hit_rate},
+        {"Backing Store Hit Rate", &perf_rates::backing_store_hit_rate},
+        {"Candidate Promotion Rate", &perf_rates::promotion_rate},
+        {"Prefetch Accuracy", &perf_rates::prefetch_accuracy},
+        {"Prefetch Coverage", &perf_rates::prefetch_coverage}};
+
+    for (const auto &metric : metrics) {
+      double mean = 0.0;
+      for (const perf_rates &rates : group) {
+        mean += rates.*metric.second;
+      }
+      mean /= group.size();
+
+      double variance = 0.0;
+      for (const perf_rates &rates : group) {
+        double diff = rates.*metric.second - mean;
+        variance += diff * diff;
+      }
+      double stddev = std::sqrt(variance / (group.size() - 1)); // sample sd
+      double half_width =
+          tCritical95(group.size() - 1) * stddev / std::sqrt(group.size());
+
+      results_file << key.first << "," << trace_filename << "," << key.second
+                   << "," << group.size()
+                   << "," << metric.first << "," << mean << "," << stddev
+                   << "," << mean - half_width << "," << mean + half_width
+                   << std::endl;
+    }
+  }
+}
+
+// For caches whose stats are broken down by more than one `source` (tenant or
+// thread), write each source's rates followed by fairness metrics across
+// sources: Jain's fairness index of their off-node hit rates
+// ((sum x)^2 / (n * sum x^2), 1 is perfectly fair) and the ratio of the worst
+// to the best hit rate.
+static void writeAttributedSummary(
+    const std::vector<OCSCache *> &caches, const std::string &trace_filename,
+    std::ofstream &results_file, const std::string &source,
+    std::vector<perf_stats> (OCSCache::*attributed_stats)()) {
+  bool wrote_header = false;
+  for (OCSCache *cache : caches) {
+    std::vector<perf_stats> breakdown = (cache->*attributed_stats)();
+    if (breakdown.size() < 2) {
+      continue;
+    }
+    if (!wrote_header) {
+      results_file << std::endl
+                   << "Cache Name, Trace File, " << source
+                   << ", Total Accesses, DRAM "
+                      "Accesses, Off-Node Memory Usage, NFM Hit Rate, Backing "
+                      "Store Hit Rate, Off-Node Hit Rate, NFM Slots Share"
+                   << std::endl;
+      wrote_header = true;
+    }
+
+    long total_ocs_accesses = 0;
+    for (const perf_stats &source_stats : breakdown) {
+      total_ocs_accesses +=
+          source_stats.ocs_pool_hits + source_stats.ocs_reconfigurations;
+    }
+
+    double sum = 0.0, sum_squares = 0.0;
+    double worst = 1.0, best = 0.0;
+    int active_sources = 0;
+    for (size_t id = 0; id < breakdown.size(); id++) {
+      const perf_stats &source_stats = breakdown[id];
+      perf_rates rates = computeRates(source_stats);
+      long off_node_accesses = source_stats.ocs_pool_hits +
+                               source_stats.ocs_reconfigurations +
+                               source_stats.backing_store_hits +
+                               source_stats.backing_store_misses;
+      double off_node_hit_rate =
+          off_node_accesses > 0
+              ? static_cast<double>(source_stats.ocs_pool_hits +
+                                    source_stats.backing_store_hits) /
+                    off_node_accesses
+              : 0.0;
+      double ocs_share =
+          total_ocs_accesses > 0
+              ? static_cast<double>(source_stats.ocs_pool_hits +
+                                    source_stats.ocs_reconfigurations) /
+                    total_ocs_accesses
+              : 0.0;
+
+      results_file << cache->getName() << "," << trace_filename << "," << id
+                   << "," << source_stats.accesses << ","
+                   << source_stats.dram_hits << ","
+                   << source_stats.ocs_pool_mem_usage +
+                          source_stats.backing_store_mem_usage
+                   << "," << rates.ocs_hit_rate << ","
+                   << rates.backing_store_hit_rate << "," << off_node_hit_rate
+                   << "," << ocs_share << std::endl;
+
+      if (off_node_accesses > 0) {
+        active_sources++;
+        sum += off_node_hit_rate;
+        sum_squares += off_node_hit_rate * off_node_hit_rate;
+        worst = std::min(worst, off_node_hit_rate);
+        best = std::max(best, off_node_hit_rate);
+      }
+    }
+
+    double jain_index =
+        sum_squares > 0 ? (sum * sum) / (active_sources * sum_squares) : 1.0;
+    double worst_to_best = best > 0 ? worst / best : 1.0;
+    results_file << cache->getName() << "," << trace_filename
+                 << ",Fairness (Jain's Index / Worst-to-Best Hit Rate),"
+                 << jain_index << "," << worst_to_best << std::endl;
+  }
+}
+
 OCSCache::Status writePerfSummary(std::vector<OCSCache *> caches,
                                   const std::string &trace_filename,
                                   std::ofstream &results_file) {
@@ -116,52 +584,72 @@ OCSCache::Status writePerfSummary(std::vector<OCSCache *> caches,
          "latency, #NFM nodes, #Backing Store nodes, NFM Utilization, "
          "Backing Store Utilization, NFM Hit Rate, Backing Store Hit "
          "Rate, NFM hits, Backing Store hits, NFM Misses, Backing Store "
-         "Misses, Cluster Candidates Created, Candidate Promotion Rate"
+         "Misses, Cluster Candidates Created, Candidate Promotion Rate, Seed, "
+         "Page Size, Metadata Bytes, Prefetcher, Prefetch Accuracy, "
+         "Prefetch Coverage, Prefetch Bytes, Off-Node Loads, Off-Node Stores, "
+         "Backing Store Write-backs, Write-back Bytes, NFM Flushes, NFM Flush "
+         "Bytes, p50 Latency (ns), p99 Latency (ns), Reconfiguration Fallbacks, "
+         "Reconfiguration Stall, Reconfiguration-Overlapped Accesses, Wasted "
+         "Reconfigurations, DRAM Tier Hits, DRAM Tier Misses, DRAM Tier "
+         "Write-backs, Dematerialized NFM Pools, Dematerialized Bytes, Packed "
+         "Candidates, NFM Slots, Backing Store Slots, Slot Repartitions, "
+         "Replacement Policy Switches"
       << std::endl;
   for (OCSCache *cache : caches) {
     perf_stats stats = cache->getPerformanceStats();
-    long backing_store_accesses =
-        (stats.backing_store_hits + stats.backing_store_misses);
-    long ocs_accesses = (stats.ocs_pool_hits + stats.ocs_reconfigurations);
-
-    double ocs_hit_rate =
-        ocs_accesses > 0
-            ? static_cast<double>(stats.ocs_pool_hits) / ocs_accesses
-            : 0.0;
-
-    double ocs_utilization = static_cast<double>(ocs_accesses) / stats.accesses;
-    double backing_store_utilization =
-        static_cast<double>(backing_store_accesses) / stats.accesses;
-
-    double backing_store_hit_rate =
-        backing_store_accesses > 0
-            ? static_cast<double>(stats.backing_store_hits) /
-                  backing_store_accesses
-            : 0.0;
-
-    double promotion_rate =
-        stats.candidates_created > 0
-            ? static_cast<double>(stats.candidates_promoted) /
-                  stats.candidates_created
-            : 0.0;
+    perf_rates rates = computeRates(stats);
     long total_off_node_mem_usage =
         stats.ocs_pool_mem_usage + stats.backing_store_mem_usage;
 
     // TODO there has to be a better way
     results_file << cache->getName() << "," << trace_filename << ","
                  << total_off_node_mem_usage << "," << stats.accesses << ","
-                 << stats.dram_hits << ","
-                 << "TODO"
-                 << "," << stats.num_ocs_pools << ","
-                 << stats.num_backing_store_pools << "," << ocs_utilization
-                 << "," << backing_store_utilization << "," << ocs_hit_rate
-                 << "," << backing_store_hit_rate << "," << stats.ocs_pool_hits
-                 << "," << stats.backing_store_hits << ","
+                 << stats.dram_hits << ",";
+    // the mean latency, if the run was timed
+    if (stats.latency.count > 0) {
+      results_file << stats.latency.mean_ns;
+    } else {
+      results_file << "TODO";
+    }
+    results_file << "," << stats.num_ocs_pools << ","
+                 << stats.num_backing_store_pools << ","
+                 << rates.ocs_utilization << ","
+                 << rates.backing_store_utilization << ","
+                 << rates.ocs_hit_rate << "," << rates.backing_store_hit_rate
+                 << "," << stats.ocs_pool_hits << ","
+                 << stats.backing_store_hits << ","
                  << stats.ocs_reconfigurations << ","
                  << stats.backing_store_misses << ","
-                 << stats.candidates_created << "," << promotion_rate
-                 << std::endl;
+                 << stats.candidates_created << "," << rates.promotion_rate
+                 << "," << cache->getSeed() << "," << cache->getPageSize()
+                 << "," << cache->metadataBytes() << ","
+                 << cache->getPrefetcherName() << "," << rates.prefetch_accuracy
+                 << "," << rates.prefetch_coverage << ","
+                 << stats.prefetch_bytes << "," << stats.off_node_loads << ","
+                 << stats.off_node_stores << ","
+                 << stats.backing_store_writebacks << ","
+                 << stats.backing_store_writeback_bytes << ","
+                 << stats.ocs_flushes << "," << stats.ocs_flush_bytes << ","
+                 << stats.latency.p50_ns << "," << stats.latency.p99_ns << ","
+                 << stats.reconfiguration_fallbacks << ","
+                 << stats.reconfiguration_stall << ","
+                 << stats.reconfiguration_overlapped_accesses << ","
+                 << stats.wasted_reconfigurations << ","
+                 << stats.dram_tier_hits << "," << stats.dram_tier_misses
+                 << "," << stats.dram_tier_writebacks << ","
+                 << stats.ocs_pools_dematerialized << ","
+                 << stats.dematerialized_bytes << ","
+                 << stats.candidates_packed << "," << cache->getOCSSlots()
+                 << "," << cache->getBackingStoreSlots() << ","
+                 << stats.slot_repartitions << ","
+                 << stats.replacement_policy_switches << std::endl;
   }
 
+  writeEnsembleSummary(caches, trace_filename, results_file);
+  writeAttributedSummary(caches, trace_filename, results_file, "Tenant",
+                         &OCSCache::getTenantPerformanceStats);
+  writeAttributedSummary(caches, trace_filename, results_file, "Thread",
+                         &OCSCache::getThreadPerformanceStats);
+
   return OCSCache::Status::OK;
 }
@@ -2,14 +2,68 @@
 
 #include "ocs_cache.h"
 #include "ocs_structs.h"
+#include "page_resolution.h"
+#include "timing_model.h"
 #include <vector>
 
 // Returns the ranges touched by `access` that aren't covered by `pages`
 std::vector<addr_subspace> findUncoveredRanges(const mem_access & access, std::vector<pool_entry *> *pages);
 
-[[nodiscard]] OCSCache::Status simulateTrace(const std::string &trace_filename, int n_lines, int sim_first_n_lines,
-                                             OCSCache *cache, bool summarize_perf);
+// Decode the trace at `trace_filename` into `accesses`, stopping after
+// `sim_first_n_lines` accesses if it is positive. The decoded trace can then
+// be shared (read-only) by every simulated cache. The DRAM regions the trace
+// declares (if any) are stored in `dram_regions`.
+[[nodiscard]] OCSCache::Status
+loadTrace(const std::string &trace_filename, int sim_first_n_lines,
+          std::vector<mem_access> *accesses,
+          std::vector<addr_subspace> *dram_regions = nullptr);
+
+// Decode one trace per tenant (concurrently) and interleave them by timestamp
+// into `accesses`. Accesses from `trace_filenames[i]` are tagged tenant `i`.
+[[nodiscard]] OCSCache::Status
+loadTenantTraces(const std::vector<std::string> &trace_filenames,
+                 int sim_first_n_lines, std::vector<mem_access> *accesses,
+                 std::vector<addr_subspace> *dram_regions = nullptr);
+
+// Find the DRAM regions of the per-thread traces `trace_filenames`: the ones
+// they declare or, if they declare none and `detect_stack` is set, the stack
+// detected from a pass over the merged trace.
+[[nodiscard]] OCSCache::Status
+findMergedTraceDramRegions(const std::vector<std::string> &trace_filenames,
+                           int sim_first_n_lines, bool detect_stack,
+                           std::vector<addr_subspace> *dram_regions);
+
+// Stream the per-thread traces `trace_filenames`, merged by timestamp, through
+// `cache` without materializing the merged trace. Accesses are tagged with
+// the index of their trace in `mem_access::thread`. If `timing` is set, the
+// accesses are also timed with a `TimingModel`.
+[[nodiscard]] OCSCache::Status
+simulateMergedTraces(const std::vector<std::string> &trace_filenames,
+                     int sim_first_n_lines, OCSCache *cache,
+                     bool summarize_perf,
+                     const timing_params *timing = nullptr);
+
+// Run every access in an already-decoded trace through `cache`. Accesses to
+// the cache's DRAM regions are filtered out in batches and only counted. If
+// `timing` is set, the off-node accesses are also timed with a `TimingModel`.
+// `resolved` (if it matches the cache's page size and DRAM regions) saves
+// resolving the trace again for this cache.
+[[nodiscard]] OCSCache::Status
+simulateAccesses(const std::vector<mem_access> &accesses, OCSCache *cache,
+                 bool summarize_perf, const timing_params *timing = nullptr,
+                 const PageResolvedTrace *resolved = nullptr);
+
+// Stream the trace at `trace_filename` (`-` for stdin, or a pipe) once,
+// running every access through each of `caches` as it is parsed, so the trace
+// is never held in memory in full. DRAM regions declared by the trace are
+// applied to every cache. If `timing` is set, each cache is also timed with
+// its own `TimingModel`.
+[[nodiscard]] OCSCache::Status
+simulateTrace(const std::string &trace_filename, int n_lines,
+              int sim_first_n_lines, const std::vector<OCSCache *> &caches,
+              bool summarize_perf, const timing_params *timing = nullptr);
 
 [[nodiscard]] OCSCache::Status writePerfSummary(std::vector<OCSCache *> caches,
                                   const std::string &trace_filename,
                                   std::ofstream &results_file);
+
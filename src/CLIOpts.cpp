@@ -1,15 +1,91 @@
 #include "ocs_cache_sim/src/CLIOpts.h"
 #include <boost/program_options.hpp>
 #include <iostream>
+#include <sys/stat.h>
 
 namespace po = boost::program_options;
 
 CLIOpts::CLIOpts()
     : desc("Allowed options"), num_lines(0), outputFile("test.csv") {
   // Define command line options
-  desc.add_options()("input_file",
-                     po::value<std::string>(&inputFile)->required(),
-                     "The trace file to be simulated")(
+  desc.add_options()("input_file", po::value<std::string>(&inputFile),
+                     "The trace file to be simulated, CSV or compressed "
+                     "(`-` reads it from stdin; pipes are streamed)")(
+      "tenant_traces", po::value<std::vector<std::string>>()->multitoken(),
+      "One trace file per tenant, interleaved by timestamp and simulated on "
+      "shared caches (replaces input_file)")(
+      "thread_traces", po::value<std::vector<std::string>>()->multitoken(),
+      "One trace file per application thread, streamed merged by timestamp "
+      "(replaces input_file)")(
+      "attribute_threads", po::bool_switch(&attribute_threads),
+      "Report hits and misses per application thread")(
+      "tenant_fair_share", po::bool_switch(&tenant_fair_share),
+      "Arbitrate OCS slots so no tenant takes more than its fair share from "
+      "another tenant")(
+      "page_sizes", po::value<std::vector<long>>()->multitoken(),
+      "Backing store page sizes in bytes (powers of two) to simulate every "
+      "cache with, e.g. 4096 65536 2097152 (default 4096)")(
+      "prefetcher", po::value<std::string>(&prefetcher)->default_value("none"),
+      "Backing store prefetcher for every cache: none, next_n, stride or "
+      "markov")(
+      "prefetch_degree", po::value<int>(&prefetch_degree)->default_value(1),
+      "The most pages the prefetcher fetches per trigger")(
+      "timing", po::bool_switch(&timing),
+      "Time every off-node access with a discrete-event model of the far "
+      "memory link and the OCS, and report latency percentiles")(
+      "link_gbps", po::value<double>(&link_gbps)->default_value(12.5),
+      "Far memory link bandwidth in GB/s (with --timing)")(
+      "far_memory_latency_ns",
+      po::value<long>(&far_memory_latency_ns)->default_value(1000),
+      "Far memory page transfer latency in ns (with --timing)")(
+      "ocs_reconfig_ns",
+      po::value<long>(&ocs_reconfiguration_ns)->default_value(10000),
+      "Time an OCS port is unavailable while reconfiguring, in ns (with "
+      "--timing)")(
+      "max_outstanding_misses",
+      po::value<int>(&max_outstanding_misses)->default_value(16),
+      "The most demand misses in flight at once (with --timing)")(
+      "reconfig_delay",
+      po::value<long>(&reconfiguration_delay)->default_value(0),
+      "Keep OCS reconfigurations in flight for this many trace timestamp "
+      "ticks (0 reconfigures instantly)")(
+      "reconfig_delay_in_accesses",
+      po::bool_switch(&reconfiguration_delay_in_accesses),
+      "Measure --reconfig_delay in off-node accesses instead of timestamps")(
+      "stall_pending_reconfigs",
+      po::bool_switch(&stall_pending_reconfigurations),
+      "Stall accesses to a pool whose reconfiguration is in flight instead of "
+      "serving them from far memory")(
+      "dram_tier_pages", po::value<long>(&dram_tier_pages)->default_value(0),
+      "Cache this many backing store pages in local DRAM in front of the "
+      "OCS and far memory (0 for no DRAM tier)")(
+      "dram_tier_policy",
+      po::value<std::string>(&dram_tier_policy)->default_value("lru"),
+      "Replacement policy of the local DRAM tier: lru or clock")(
+      "dematerialize_epoch",
+      po::value<long>(&dematerialization_epoch)->default_value(0),
+      "Check OCS pools for dematerialization every this many off-node "
+      "accesses (0 never dematerializes)")(
+      "cold_pool_heat", po::value<long>(&cold_pool_heat)->default_value(16),
+      "OCS pools with less decayed heat (accesses, halved every epoch) are "
+      "cold")(
+      "cold_pool_epochs", po::value<int>(&cold_pool_epochs)->default_value(2),
+      "Epochs in a row an OCS pool has to be cold to be dematerialized")(
+      "pack_pools", po::bool_switch(&pack_pools),
+      "Pack several hot clustering candidates into each promoted OCS pool")(
+      "partition_epoch", po::value<long>(&partition_epoch)->default_value(0),
+      "Move a slot between the OCS and backing store caches, towards the one "
+      "with more ghost hits, every this many off-node accesses (0 keeps the "
+      "partition fixed)")(
+      "ghost_slots", po::value<int>(&ghost_slots)->default_value(4),
+      "Ghost tags each cache keeps of the pools it evicted last")(
+      "write_compressed_trace",
+      po::value<std::string>(&compressed_trace_output)->default_value(""),
+      "Write the loaded trace to this file in the compressed binary format "
+      "(which can be simulated like a CSV trace) and exit")(
+      "no_dram_detection", po::bool_switch(&no_dram_detection),
+      "Don't detect the stack from the trace when it declares no DRAM "
+      "regions; fall back to the fixed stack floor instead")(
       "num_lines,n", po::value<int>(&num_lines)->default_value(-1),
       "The number of lines in the trace file, so a progress bar can be "
       "displayed during simulation")(
@@ -18,7 +94,19 @@ CLIOpts::CLIOpts()
       "output_file,o", po::value<std::string>(&outputFile)->default_value(""),
       "The filename to write results to, if desired")
       ("display_full_results,v", po::bool_switch(&verbose),
-       "Enable verbose output"); // Boolean switch
+       "Enable verbose output") // Boolean switch
+      ("time_parallel_chunks", po::value<int>(&time_parallel_chunks)->default_value(1),
+       "Split the trace into this many chunks, simulate them concurrently "
+       "and reconcile the chunk boundaries")
+      ("checkpoint_interval", po::value<long>(&checkpoint_interval)->default_value(4096),
+       "Accesses between state checkpoints in time-parallel simulation")
+      ("reconcile_budget", po::value<long>(&reconcile_budget)->default_value(-1),
+       "The most accesses to re-simulate per chunk while reconciling a "
+       "time-parallel simulation (-1 for exact results)")
+      ("ensemble_seeds,k", po::value<int>(&ensemble_seeds)->default_value(1),
+       "The number of seeds to run each random-replacement policy with. "
+       "Results across seeds are summarized with a mean, standard deviation "
+       "and confidence interval");
 }
 
 void CLIOpts::parse(int argc, char *argv[]) {
@@ -36,6 +124,50 @@ void CLIOpts::parse(int argc, char *argv[]) {
     if (vm.count("input_file")) {
       inputFile = vm["input_file"].as<std::string>();
     }
+    if (vm.count("tenant_traces")) {
+      tenantTraces = vm["tenant_traces"].as<std::vector<std::string>>();
+    }
+    if (vm.count("thread_traces")) {
+      threadTraces = vm["thread_traces"].as<std::vector<std::string>>();
+    }
+    if (vm.count("page_sizes")) {
+      pageSizes = vm["page_sizes"].as<std::vector<long>>();
+    }
+    if (prefetcher != "none" && prefetcher != "next_n" &&
+        prefetcher != "stride" && prefetcher != "markov") {
+      throw po::error("unknown prefetcher " + prefetcher);
+    }
+    if (dram_tier_policy != "lru" && dram_tier_policy != "clock") {
+      throw po::error("unknown dram_tier_policy " + dram_tier_policy);
+    }
+    if (dematerialization_epoch < 0 || cold_pool_heat < 0 ||
+        cold_pool_epochs < 1) {
+      throw po::error("dematerialization settings out of range");
+    }
+    if (partition_epoch < 0 || ghost_slots < 1) {
+      throw po::error("slot partitioning settings out of range");
+    }
+    if (dram_tier_pages < 0) {
+      throw po::error("dram_tier_pages can't be negative");
+    }
+    if (link_gbps <= 0 || max_outstanding_misses < 1) {
+      throw po::error("link_gbps and max_outstanding_misses must be positive");
+    }
+    // stdin, pipes and devices can only be read once
+    for (const std::string &trace : threadTraces) {
+      struct stat info;
+      if (stat(trace.c_str(), &info) != 0 || !S_ISREG(info.st_mode)) {
+        throw po::error("thread_traces are read once per cache, so each must "
+                        "be a regular file: " + trace);
+      }
+    }
+    if (!compressed_trace_output.empty() && !threadTraces.empty()) {
+      throw po::error("write_compressed_trace doesn't support thread_traces");
+    }
+    if (inputFile.empty() && tenantTraces.empty() && threadTraces.empty()) {
+      throw po::error(
+          "an input_file, tenant_traces or thread_traces is required");
+    }
     if (vm.count("num_lines")) {
       num_lines = vm["num_lines"].as<int>();
     }
@@ -45,6 +177,9 @@ void CLIOpts::parse(int argc, char *argv[]) {
     if (vm.count("output_file")) {
       outputFile = vm["output_file"].as<std::string>();
     }
+    if (vm.count("ensemble_seeds")) {
+      ensemble_seeds = vm["ensemble_seeds"].as<int>();
+    }
     if (vm.count("display_full_results")) {
       verbose = vm["display_full_results"].as<bool>();
     }
@@ -56,9 +191,52 @@ void CLIOpts::parse(int argc, char *argv[]) {
 }
 
 std::string CLIOpts::getInputFile() const { return inputFile; }
+std::vector<std::string> CLIOpts::getTenantTraces() const {
+  return tenantTraces;
+}
+std::vector<std::string> CLIOpts::getThreadTraces() const {
+  return threadTraces;
+}
+std::vector<long> CLIOpts::getPageSizes() const { return pageSizes; }
+std::string CLIOpts::getPrefetcher() const { return prefetcher; }
+int CLIOpts::getPrefetchDegree() const { return prefetch_degree; }
+bool CLIOpts::enableTenantFairShare() const { return tenant_fair_share; }
+bool CLIOpts::enableThreadAttribution() const { return attribute_threads; }
+bool CLIOpts::enableDramDetection() const { return !no_dram_detection; }
 
 int CLIOpts::getNumLines() const { return num_lines; }
 int CLIOpts::getSimFirstNumLines() const { return sim_first_n_lines; }
 bool CLIOpts::enableVerboseOutput() const { return verbose; }
+int CLIOpts::getEnsembleSeeds() const { return ensemble_seeds; }
+int CLIOpts::getTimeParallelChunks() const { return time_parallel_chunks; }
+long CLIOpts::getCheckpointInterval() const { return checkpoint_interval; }
+long CLIOpts::getReconcileBudget() const { return reconcile_budget; }
+bool CLIOpts::enableTiming() const { return timing; }
+double CLIOpts::getLinkGBps() const { return link_gbps; }
+long CLIOpts::getFarMemoryLatencyNs() const { return far_memory_latency_ns; }
+long CLIOpts::getOcsReconfigurationNs() const {
+  return ocs_reconfiguration_ns;
+}
+int CLIOpts::getMaxOutstandingMisses() const { return max_outstanding_misses; }
+long CLIOpts::getReconfigurationDelay() const { return reconfiguration_delay; }
+bool CLIOpts::reconfigurationDelayInAccesses() const {
+  return reconfiguration_delay_in_accesses;
+}
+bool CLIOpts::stallPendingReconfigurations() const {
+  return stall_pending_reconfigurations;
+}
+long CLIOpts::getDramTierPages() const { return dram_tier_pages; }
+std::string CLIOpts::getDramTierPolicy() const { return dram_tier_policy; }
+long CLIOpts::getDematerializationEpoch() const {
+  return dematerialization_epoch;
+}
+long CLIOpts::getColdPoolHeat() const { return cold_pool_heat; }
+int CLIOpts::getColdPoolEpochs() const { return cold_pool_epochs; }
+bool CLIOpts::enablePoolPacking() const { return pack_pools; }
+long CLIOpts::getPartitionEpoch() const { return partition_epoch; }
+int CLIOpts::getGhostSlots() const { return ghost_slots; }
+std::string CLIOpts::getCompressedTraceOutput() const {
+  return compressed_trace_output;
+}
 
 std::string CLIOpts::getOutputFile() const { return outputFile; }
@@ -2,6 +2,7 @@
 #define COMMAND_LINE_OPTIONS_H
 
 #include <string>
+#include <vector>
 #include <boost/program_options.hpp>
 
 class CLIOpts {
@@ -14,18 +15,76 @@ public:
 
     // Getters for the command line options
     std::string getInputFile() const;
+    std::vector<std::string> getTenantTraces() const;
+    std::vector<std::string> getThreadTraces() const;
+    std::vector<long> getPageSizes() const;
+    std::string getPrefetcher() const;
+    int getPrefetchDegree() const;
+    bool enableTenantFairShare() const;
+    bool enableThreadAttribution() const;
+    bool enableDramDetection() const;
     int getNumLines() const;
     int getSimFirstNumLines() const;
     std::string getOutputFile() const;
     bool enableVerboseOutput() const;
+    int getEnsembleSeeds() const;
+    int getTimeParallelChunks() const;
+    long getCheckpointInterval() const;
+    long getReconcileBudget() const;
+    bool enableTiming() const;
+    double getLinkGBps() const;
+    long getFarMemoryLatencyNs() const;
+    long getOcsReconfigurationNs() const;
+    int getMaxOutstandingMisses() const;
+    long getReconfigurationDelay() const;
+    bool reconfigurationDelayInAccesses() const;
+    bool stallPendingReconfigurations() const;
+    long getDramTierPages() const;
+    std::string getDramTierPolicy() const;
+    long getDematerializationEpoch() const;
+    long getColdPoolHeat() const;
+    int getColdPoolEpochs() const;
+    bool enablePoolPacking() const;
+    long getPartitionEpoch() const;
+    int getGhostSlots() const;
+    std::string getCompressedTraceOutput() const;
 
 private:
     std::string inputFile;
+    std::vector<std::string> tenantTraces;
+    std::vector<std::string> threadTraces;
+    std::vector<long> pageSizes = {4096};
     boost::program_options::options_description desc;
 
     int num_lines = -1;
     int sim_first_n_lines = -1;
     bool verbose = true;
+    int ensemble_seeds = 1;
+    int time_parallel_chunks = 1;
+    long checkpoint_interval = 4096;
+    long reconcile_budget = -1;
+    bool tenant_fair_share = false;
+    bool attribute_threads = false;
+    bool no_dram_detection = false;
+    std::string prefetcher = "none";
+    int prefetch_degree = 1;
+    bool timing = false;
+    double link_gbps = 12.5;
+    long far_memory_latency_ns = 1000;
+    long ocs_reconfiguration_ns = 10000;
+    int max_outstanding_misses = 16;
+    long reconfiguration_delay = 0;
+    bool reconfiguration_delay_in_accesses = false;
+    bool stall_pending_reconfigurations = false;
+    long dram_tier_pages = 0;
+    std::string dram_tier_policy = "lru";
+    long dematerialization_epoch = 0;
+    long cold_pool_heat = 16;
+    int cold_pool_epochs = 2;
+    bool pack_pools = false;
+    long partition_epoch = 0;
+    int ghost_slots = 4;
+    std::string compressed_trace_output = "";
     std::string outputFile = "";
 
     boost::program_options::variables_map vm;
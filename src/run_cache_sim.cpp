@@ -1,21 +1,51 @@
+#include "ocs_cache_sim/lib/adaptive_ocs_cache.h"
 #include "ocs_cache_sim/lib/clock_eviction_far_mem_cache.h"
 #include "ocs_cache_sim/lib/clock_eviction_ocs_cache.h"
+#include "ocs_cache_sim/lib/compressed_trace.h"
 #include "ocs_cache_sim/lib/conservative_clock_ocs_cache.h"
 #include "ocs_cache_sim/lib/conservative_random_ocs_cache.h"
+#include "ocs_cache_sim/lib/density_ocs_cache.h"
+#include "ocs_cache_sim/lib/dram_filter.h"
+#include "ocs_cache_sim/lib/dueling_ocs_cache.h"
 #include "ocs_cache_sim/lib/far_memory_cache.h"
 #include "ocs_cache_sim/lib/liberal_clock_ocs_cache.h"
 #include "ocs_cache_sim/lib/liberal_random_ocs_cache.h"
 #include "ocs_cache_sim/lib/ocs_cache.h"
 #include "ocs_cache_sim/lib/ocs_structs.h"
+#include "ocs_cache_sim/lib/page_resolution.h"
+#include "ocs_cache_sim/lib/prefetcher.h"
+#include "ocs_cache_sim/lib/time_parallel.h"
+#include "ocs_cache_sim/lib/timing_model.h"
+#include "ocs_cache_sim/lib/trace_merge.h"
 #include "ocs_cache_sim/lib/utils.h"
 #include "ocs_cache_sim/src/CLIOpts.h"
 
+#include <algorithm>
 #include <boost/program_options.hpp>
 #include <fstream>
 #include <future>
 #include <iostream>
+#include <map>
 #include <thread>
 
+// Write the candidates' results to `results_filename`, if one was given.
+static int writeResults(const std::string &results_filename,
+                        const std::vector<OCSCache *> &candidates,
+                        const std::string &trace_fpath) {
+  if (results_filename.length() > 0) {
+    std::ofstream out_file(results_filename, std::ios::out | std::ios::trunc);
+
+    if (writePerfSummary(candidates, trace_fpath, out_file) !=
+        OCSCache::Status::OK) {
+      return -1;
+    }
+    std::cout << "Performance results written to " << results_filename
+              << std::endl;
+    out_file.close();
+  }
+  return 0;
+}
+
 int main(int argc, char *argv[]) {
 
   CLIOpts options;
@@ -41,56 +71,267 @@ int main(int argc, char *argv[]) {
               << "\n";
   }
 
+  int ensemble_seeds = std::max(options.getEnsembleSeeds(), 1);
+
   std::vector<OCSCache *> candidates;
 
-  // Conservative Clustering
-  OCSCache *cons_random_ocs = new ConservativeRandomOCSCache(
-      /*pool_size_bytes=*/8192, /*max_concurrent_pools=*/2,
-      /*max_conrreutn_backing_store_nodes*/ 4);
-  candidates.push_back(cons_random_ocs);
-  OCSCache *lib_random_ocs = new LiberalRandomOCSCache(
-      /*pool_size_bytes=*/8192, /*max_concurrent_pools=*/2,
-      /*max_conrreutn_backing_store_nodes*/ 4);
-  candidates.push_back(lib_random_ocs);
-
-  // Liberal Clustering
-  OCSCache *cons_clock_ocs = new ConservativeClockOCSCache(
-      /*pool_size_bytes=*/8192, /*max_concurrent_pools=*/2,
-      /*max_conrreutn_backing_store_nodes*/ 4);
-  candidates.push_back(cons_clock_ocs);
-  OCSCache *lib_clock_ocs = new LiberalClockOCSCache(
-      /*pool_size_bytes=*/8192, /*max_concurrent_pools=*/2,
-      /*max_conrreutn_backing_store_nodes*/ 4);
-  candidates.push_back(lib_clock_ocs);
-
-  // Control: No OCS
-  OCSCache *farmem_cache_random = new FarMemCache(
-      /*backing_store_cache_size*/ 4);
-  candidates.push_back(farmem_cache_random);
-  OCSCache *farmem_cache_clock = new ClockFMCache(
-      /*backing_store_cache_size*/ 4);
-  candidates.push_back(farmem_cache_clock);
+  // Every cache is simulated once per backing store page size.
+  for (long page_size : options.getPageSizes()) {
+    size_t first_candidate = candidates.size();
+
+    // Random replacement policies are run once per seed so their results can
+    // be reported as an ensemble.
+    for (int seed = 0; seed < ensemble_seeds; seed++) {
+      // Conservative Clustering
+      OCSCache *cons_random_ocs = new ConservativeRandomOCSCache(
+          /*pool_size_bytes=*/8192, /*max_concurrent_pools=*/2,
+          /*max_conrreutn_backing_store_nodes*/ 4);
+      cons_random_ocs->setSeed(seed);
+      candidates.push_back(cons_random_ocs);
+
+      // Liberal Clustering
+      OCSCache *lib_random_ocs = new LiberalRandomOCSCache(
+          /*pool_size_bytes=*/8192, /*max_concurrent_pools=*/2,
+          /*max_conrreutn_backing_store_nodes*/ 4);
+      lib_random_ocs->setSeed(seed);
+      candidates.push_back(lib_random_ocs);
+
+      // Density-based Clustering
+      OCSCache *density_random_ocs = new DensityOCSCache(
+          /*pool_size_bytes=*/8192, /*max_concurrent_pools=*/2,
+          /*max_conrreutn_backing_store_nodes*/ 4);
+      density_random_ocs->setSeed(seed);
+      candidates.push_back(density_random_ocs);
+
+      // Adaptive Clustering
+      OCSCache *adaptive_random_ocs = new AdaptiveOCSCache(
+          /*pool_size_bytes=*/8192, /*max_concurrent_pools=*/2,
+          /*max_conrreutn_backing_store_nodes*/ 4);
+      adaptive_random_ocs->setSeed(seed);
+      candidates.push_back(adaptive_random_ocs);
+
+      // Liberal Clustering, dueling random and clock replacement
+      OCSCache *lib_dueling_ocs = new DuelingOCSCache(
+          /*pool_size_bytes=*/8192, /*max_concurrent_pools=*/2,
+          /*max_conrreutn_backing_store_nodes*/ 4);
+      lib_dueling_ocs->setSeed(seed);
+      candidates.push_back(lib_dueling_ocs);
+    }
+
+    OCSCache *cons_clock_ocs = new ConservativeClockOCSCache(
+        /*pool_size_bytes=*/8192, /*max_concurrent_pools=*/2,
+        /*max_conrreutn_backing_store_nodes*/ 4);
+    candidates.push_back(cons_clock_ocs);
+    OCSCache *lib_clock_ocs = new LiberalClockOCSCache(
+        /*pool_size_bytes=*/8192, /*max_concurrent_pools=*/2,
+        /*max_conrreutn_backing_store_nodes*/ 4);
+    candidates.push_back(lib_clock_ocs);
+
+    // Control: No OCS
+    for (int seed = 0; seed < ensemble_seeds; seed++) {
+      OCSCache *farmem_cache_random = new FarMemCache(
+          /*backing_store_cache_size*/ 4);
+      farmem_cache_random->setSeed(seed);
+      candidates.push_back(farmem_cache_random);
+    }
+    OCSCache *farmem_cache_clock = new ClockFMCache(
+        /*backing_store_cache_size*/ 4);
+    candidates.push_back(farmem_cache_clock);
+
+    for (size_t idx = first_candidate; idx < candidates.size(); idx++) {
+      if (candidates[idx]->setPageSize(page_size) != OCSCache::Status::OK) {
+        return -1;
+      }
+    }
+  }
+
+  reconfiguration_params reconfiguration;
+  reconfiguration.delay = options.getReconfigurationDelay();
+  reconfiguration.delay_in_accesses = options.reconfigurationDelayInAccesses();
+  reconfiguration.stall_pending = options.stallPendingReconfigurations();
+
+  dematerialization_params dematerialization;
+  dematerialization.epoch_accesses = options.getDematerializationEpoch();
+  dematerialization.cold_heat = options.getColdPoolHeat();
+  dematerialization.cold_epochs = options.getColdPoolEpochs();
+
+  slot_partitioning_params slot_partitioning;
+  slot_partitioning.epoch_accesses = options.getPartitionEpoch();
+  slot_partitioning.ghost_slots = options.getGhostSlots();
+
+  for (OCSCache *candidate : candidates) {
+    candidate->setReconfiguration(reconfiguration);
+    if (slot_partitioning.epoch_accesses > 0) {
+      candidate->setSlotPartitioning(slot_partitioning);
+    }
+    candidate->setDematerialization(dematerialization);
+    candidate->setDramTier(options.getDramTierPages(),
+                           options.getDramTierPolicy() == "clock"
+                               ? LocalDramTier::CLOCK
+                               : LocalDramTier::LRU);
+    candidate->setTenantFairShare(options.enableTenantFairShare());
+    candidate->setPoolPacking(options.enablePoolPacking());
+    candidate->setThreadAttribution(options.enableThreadAttribution());
+    candidate->setPrefetcher(
+        makePrefetcher(options.getPrefetcher(), options.getPrefetchDegree()));
+  }
+
+  timing_params timing;
+  timing.link_bytes_per_ns = options.getLinkGBps();
+  timing.far_memory_latency_ns = options.getFarMemoryLatencyNs();
+  timing.ocs_reconfiguration_ns = options.getOcsReconfigurationNs();
+  timing.max_outstanding_misses = options.getMaxOutstandingMisses();
+  const timing_params *timed = options.enableTiming() ? &timing : nullptr;
+
+  // A streamed trace (stdin or a pipe) is read once, every candidate
+  // simulating each access as it is parsed, instead of being staged in memory.
+  std::vector<std::string> tenant_traces = options.getTenantTraces();
+  std::vector<std::string> thread_traces = options.getThreadTraces();
+  if (thread_traces.empty() && tenant_traces.empty() &&
+      options.getCompressedTraceOutput().empty() &&
+      MappedTraceCursor::isStream(trace_fpath)) {
+    if (options.enableDramDetection()) {
+      std::cerr << "Detecting the stack needs the whole trace, skipped for "
+                   "the streamed trace"
+                << std::endl;
+    }
+    if (options.getTimeParallelChunks() > 1) {
+      std::cerr << "Time-parallel simulation needs the whole trace, "
+                   "simulating the streamed trace sequentially"
+                << std::endl;
+    }
+    if (simulateTrace(trace_fpath, n_lines, sim_first_n_lines, candidates,
+                      /*summarize_perf=*/!verbose_output,
+                      timed) != OCSCache::Status::OK) {
+      return -1;
+    }
+    return writeResults(results_filename, candidates, trace_fpath);
+  }
+
+  // Per-thread traces are streamed (merged) by each candidate; otherwise the
+  // trace is decoded once and every candidate reads the same copy.
+  std::vector<mem_access> trace;
+  std::vector<addr_subspace> dram_regions;
+  if (!thread_traces.empty()) {
+    trace_fpath = "";
+    for (const std::string &thread_trace : thread_traces) {
+      trace_fpath += (trace_fpath.empty() ? "" : "+") + thread_trace;
+    }
+    if (findMergedTraceDramRegions(thread_traces, sim_first_n_lines,
+                                   options.enableDramDetection(),
+                                   &dram_regions) != OCSCache::Status::OK) {
+      return -1;
+    }
+  } else if (!tenant_traces.empty()) {
+    trace_fpath = "";
+    for (const std::string &tenant_trace : tenant_traces) {
+      trace_fpath += (trace_fpath.empty() ? "" : "+") + tenant_trace;
+    }
+    if (loadTenantTraces(tenant_traces, sim_first_n_lines, &trace,
+                         &dram_regions) != OCSCache::Status::OK) {
+      return -1;
+    }
+  } else if (loadTrace(trace_fpath, sim_first_n_lines, &trace,
+                       &dram_regions) != OCSCache::Status::OK) {
+    return -1;
+  }
+
+  // Convert the trace (with the regions it declares) instead of simulating it.
+  if (!options.getCompressedTraceOutput().empty()) {
+    if (writeCompressedTrace(options.getCompressedTraceOutput(), trace,
+                             dram_regions) != OCSCache::Status::OK) {
+      return -1;
+    }
+    std::cerr << "Wrote " << trace.size() << " accesses to "
+              << options.getCompressedTraceOutput() << std::endl;
+    return 0;
+  }
+
+  // Regions declared by the trace take precedence, then the detected stack,
+  // then the caches' default stack floor.
+  if (dram_regions.empty() && !trace.empty() &&
+      options.enableDramDetection()) {
+    StackRegionDetector detector;
+    for (const mem_access &access : trace) {
+      detector.observe(access.addr);
+    }
+    detector.detect(&dram_regions);
+  }
+  if (!dram_regions.empty()) {
+    std::cerr << "Local DRAM regions:";
+    for (const addr_subspace &region : dram_regions) {
+      std::cerr << " " << region;
+    }
+    std::cerr << std::endl;
+    for (OCSCache *candidate : candidates) {
+      candidate->setDramRegions(dram_regions);
+    }
+  }
+
+  // Resolve the trace once per page size, for every cache using that size.
+  std::map<uintptr_t, PageResolvedTrace> resolved_traces;
+  if (thread_traces.empty()) {
+    for (OCSCache *candidate : candidates) {
+      if (resolved_traces.count(candidate->getPageSize()) == 0) {
+        resolved_traces[candidate->getPageSize()].resolve(
+            trace, candidate->getPageSize(), candidate->getDramRegions());
+      }
+    }
+  }
 
   std::vector<std::future<OCSCache::Status>> futures;
 
-  for (auto candidate : candidates) {
+  time_parallel_options parallel_options;
+  parallel_options.chunks = options.getTimeParallelChunks();
+  parallel_options.checkpoint_interval =
+      std::max(options.getCheckpointInterval(), 1L);
+  parallel_options.warmup_accesses = parallel_options.checkpoint_interval;
+  parallel_options.reconcile_budget = options.getReconcileBudget();
+  bool time_parallel = parallel_options.chunks > 1 && thread_traces.empty();
+
+  if ((timed != nullptr || reconfiguration.delay > 0 ||
+       slot_partitioning.epoch_accesses > 0) &&
+      time_parallel) {
+    std::cerr << "Timing, in-flight reconfigurations and slot partitioning "
+                 "need the whole trace in order, simulating sequentially"
+              << std::endl;
+    time_parallel = false;
+  }
+
+  for (size_t idx = 0; idx < candidates.size(); idx++) {
+    OCSCache *candidate = candidates[idx];
     std::cout << std::endl
               << "Evaluating candidate: " << candidate->getName() << std::endl;
+    auto simulate = [&, idx, candidate]() {
+      if (time_parallel) {
+        time_parallel_report report;
+        OCSCache::Status status = simulateTimeParallel(
+            trace, &candidates[idx], parallel_options, &report);
+        std::cerr << candidates[idx]->getPerformanceStats(
+                         /*summary=*/!verbose_output)
+                  << std::endl
+                  << report << std::endl;
+        return status;
+      }
+      return thread_traces.empty()
+                 ? simulateAccesses(trace, candidate,
+                                    /*summarize_perf=*/!verbose_output, timed,
+                                    &resolved_traces[candidate->getPageSize()])
+                 : simulateMergedTraces(thread_traces, sim_first_n_lines,
+                                        candidate,
+                                        /*summarize_perf=*/!verbose_output,
+                                        timed);
+    };
     if (ENABLE_MULTITHREADING) {
-      std::ifstream new_fd(trace_fpath);
-      futures.push_back(std::async(std::launch::async,simulateTrace, std::cref(trace_fpath), n_lines,
-                                    sim_first_n_lines, candidate,
-                                    /*summarize_perf=*/!verbose_output));
+      futures.push_back(std::async(std::launch::async, simulate));
     } else {
-      if (simulateTrace(trace_fpath, n_lines, sim_first_n_lines, candidate,
-                        /*summarize_perf=*/!verbose_output) !=
-          OCSCache::Status::OK) {
+      if (simulate() != OCSCache::Status::OK) {
         return -1;
       }
     }
     if (!ENABLE_MULTITHREADING && verbose_output) {
       std::cout << "Final State" << std::endl;
-      std::cout << *candidate;
+      std::cout << *candidates[idx];
     }
   }
 
@@ -103,17 +344,5 @@ int main(int argc, char *argv[]) {
   }
 
 
-  // write results if provided an output fname
-  if (results_filename.length() > 0) {
-    std::ofstream out_file(results_filename, std::ios::out | std::ios::trunc);
-
-    if (writePerfSummary(candidates, trace_fpath, out_file) !=
-        OCSCache::Status::OK) {
-      return -1;
-    }
-    std::cout << "Performance results written to " << results_filename
-              << std::endl;
-    out_file.close();
-  }
-  return 0;
+  return writeResults(results_filename, candidates, trace_fpath);
 }
@@ -1,12 +1,51 @@
 #include <gtest/gtest.h>
 
+#include "ocs_cache_sim/lib/adaptive_ocs_cache.h"
 #include "ocs_cache_sim/lib/basic_ocs_cache.h"
+#include "ocs_cache_sim/lib/candidate_table.h"
+#include "ocs_cache_sim/lib/clock_eviction_far_mem_cache.h"
 #include "ocs_cache_sim/lib/clock_eviction_ocs_cache.h"
+#include "ocs_cache_sim/lib/compressed_trace.h"
+#include "ocs_cache_sim/lib/conservative_clock_ocs_cache.h"
+#include "ocs_cache_sim/lib/cpu_features.h"
+#include "ocs_cache_sim/lib/density_ocs_cache.h"
+#include "ocs_cache_sim/lib/dram_filter.h"
+#include "ocs_cache_sim/lib/dueling_ocs_cache.h"
 #include "ocs_cache_sim/lib/far_memory_cache.h"
 #include "ocs_cache_sim/lib/ocs_structs.h"
+#include "ocs_cache_sim/lib/page_resolution.h"
+#include "ocs_cache_sim/lib/prefetcher.h"
+#include "ocs_cache_sim/lib/time_parallel.h"
+#include "ocs_cache_sim/lib/timing_model.h"
+#include "ocs_cache_sim/lib/trace_merge.h"
+#include "ocs_cache_sim/lib/utils.h"
+
+#include <csignal>
+#include <fstream>
+#include <functional>
+#include <random>
+#include <sstream>
+#include <thread>
+#include <unistd.h>
 
 #define ASSERT_OK(expr) ASSERT_EQ(expr, OCSCache::Status::OK);
 
+// The stats as reported, covering every counter (`operator==` compares only
+// the hit and miss counts).
+static std::string printed(const perf_stats &stats) {
+  std::ostringstream out;
+  out << stats;
+  return out.str();
+}
+
+static std::vector<std::string> printed(const std::vector<perf_stats> &stats) {
+  std::vector<std::string> out;
+  for (const perf_stats &entry : stats) {
+    out.push_back(printed(entry));
+  }
+  return out;
+}
+
 // Demonstrate some basic assertions.
 TEST(BasicSuite, BasicBackingStoreFunctionality) {
   // TODO parameterize and hit all the OCSCache subclasses
@@ -166,3 +205,1296 @@ TEST(BasicSuite, TestDRAMAccessFarMemCache) {
   expected_stats.dram_hits++;
   EXPECT_EQ(ocs_cache->getPerformanceStats(), expected_stats);
 }
+
+TEST(BasicSuite, TestSeededRandomReplacementIsReproducible) {
+  OCSCache *first = new FarMemCache(/*backing_store_cache_size*/ 2);
+  OCSCache *second = new FarMemCache(/*backing_store_cache_size*/ 2);
+  OCSCache *other_seed = new FarMemCache(/*backing_store_cache_size*/ 2);
+  first->setSeed(42);
+  second->setSeed(42);
+  other_seed->setSeed(7);
+  bool hit;
+
+  // reuse among a few pages, so which page is evicted matters
+  std::mt19937_64 pages(1);
+  for (int i = 0; i < 1000; i++) {
+    mem_access access = {static_cast<uintptr_t>(pages() % 4) * PAGE_SIZE, 1};
+    access.is_write = i % 3 == 0;
+    for (OCSCache *cache : {first, second, other_seed}) {
+      ASSERT_OK(cache->handleMemoryAccess(access, &hit));
+    }
+  }
+  EXPECT_EQ(printed(first->getPerformanceStats()),
+            printed(second->getPerformanceStats()));
+  EXPECT_NE(printed(first->getPerformanceStats()),
+            printed(other_seed->getPerformanceStats()));
+  EXPECT_EQ(first->getSeed(), 42);
+  delete first;
+  delete second;
+  delete other_seed;
+}
+
+TEST(BasicSuite, TestTenantsHaveSeparateAddressSpaces) {
+  OCSCache *ocs_cache = new BasicOCSCache(
+      /*pool_size_bytes=*/8192, /*max_concurrent_pools=*/1,
+      /*max_conrreutn_backing_store_nodes*/ 4);
+  bool hit;
+
+  ASSERT_OK(ocs_cache->handleMemoryAccess({1, 1, /*tenant=*/0}, &hit));
+  ASSERT_FALSE(hit);
+  // Same virtual address, different tenant: a different page
+  ASSERT_OK(ocs_cache->handleMemoryAccess({1, 1, /*tenant=*/1}, &hit));
+  ASSERT_FALSE(hit);
+  ASSERT_OK(ocs_cache->handleMemoryAccess({1, 1, /*tenant=*/1}, &hit));
+  ASSERT_TRUE(hit);
+
+  std::vector<perf_stats> tenants = ocs_cache->getTenantPerformanceStats();
+  ASSERT_EQ(tenants.size(), 2);
+  EXPECT_EQ(tenants[0].backing_store_misses, 1);
+  EXPECT_EQ(tenants[0].backing_store_hits, 0);
+  EXPECT_EQ(tenants[1].backing_store_misses, 1);
+  EXPECT_EQ(tenants[1].backing_store_hits, 1);
+  EXPECT_EQ(ocs_cache->getPerformanceStats().num_backing_store_pools, 2);
+}
+
+TEST(BasicSuite, TestBreakdownsAttributeEveryAccessToItsIssuer) {
+  OCSCache *cache = new BasicOCSCache(
+      /*pool_size_bytes=*/2 * PAGE_SIZE, /*max_concurrent_pools=*/2,
+      /*max_conrreutn_backing_store_nodes*/ 4);
+  cache->setDramTier(/*capacity_pages=*/2, LocalDramTier::LRU);
+  cache->setThreadAttribution(true);
+
+  // reference breakdowns from the change of the totals over every access
+  std::vector<perf_stats> tenants(2), threads(3);
+  bool hit;
+  std::mt19937_64 rng(5);
+  for (int i = 0; i < 3000; i++) {
+    mem_access access = {(rng() % 24) * PAGE_SIZE + rng() % PAGE_SIZE, 8};
+    access.is_write = rng() % 4 == 0;
+    // owners change in runs of varying length
+    access.tenant = (i / 7) % 2;
+    access.thread = (i / 3) % 3;
+    perf_stats before = cache->getPerformanceStats();
+    ASSERT_OK(cache->handleMemoryAccess(access, &hit));
+    perf_stats after = cache->getPerformanceStats();
+    tenants[access.tenant].accumulateDelta(before, after);
+    threads[access.thread].accumulateDelta(before, after);
+    if (i % 500 == 0) { // reads in between must not disturb the breakdowns
+      cache->getTenantPerformanceStats();
+      cache->getThreadPerformanceStats();
+    }
+  }
+  EXPECT_GT(cache->getPerformanceStats().dram_tier_hits, 0);
+
+  std::vector<perf_stats> tenant_stats = cache->getTenantPerformanceStats();
+  ASSERT_EQ(tenant_stats.size(), 2);
+  for (size_t tenant = 0; tenant < tenants.size(); tenant++) {
+    // the pool aggregates are recounted, not accumulated
+    perf_stats counters = tenant_stats[tenant];
+    counters.ocs_pool_mem_usage = 0;
+    counters.backing_store_mem_usage = 0;
+    counters.num_ocs_pools = 0;
+    counters.num_backing_store_pools = 0;
+    EXPECT_EQ(printed(counters), printed(tenants[tenant]));
+  }
+  EXPECT_EQ(printed(cache->getThreadPerformanceStats()), printed(threads));
+  delete cache;
+}
+
+TEST(BasicSuite, TestTenantFairShareKeepsEveryTenantASlot) {
+  // tenant 0 materializes one pool, then tenant 1's hot regions would take
+  // every OCS slot
+  auto run = [](bool fair_share) {
+    OCSCache *cache = new BasicOCSCache(
+        /*pool_size_bytes=*/2 * PAGE_SIZE, /*max_concurrent_pools=*/2,
+        /*max_conrreutn_backing_store_nodes*/ 4);
+    cache->setSeed(1);
+    cache->setTenantFairShare(fair_share);
+    bool hit;
+    for (int phase = 0; phase < 6; phase++) {
+      uintptr_t region = (phase + 1) * 1024 * PAGE_SIZE;
+      for (int i = 0; i < 250; i++) {
+        mem_access access = {
+            region + PAGE_SIZE / 2 + (i % 16) * (PAGE_SIZE / 8), 8};
+        access.tenant = phase == 0 ? 0 : 1;
+        EXPECT_EQ(cache->handleMemoryAccess(access, &hit),
+                  OCSCache::Status::OK);
+      }
+    }
+    std::vector<int> slots_held(2, 0);
+    for (const pool_entry *pool : cache->getCachedOCSPools()) {
+      slots_held[pool->range.tenant]++;
+    }
+    EXPECT_GT(cache->getPerformanceStats().ocs_reconfigurations, 2);
+    delete cache;
+    return slots_held;
+  };
+
+  EXPECT_EQ(run(/*fair_share=*/false), std::vector<int>({0, 2}));
+  EXPECT_EQ(run(/*fair_share=*/true), std::vector<int>({1, 1}));
+}
+
+TEST(BasicSuite, TestTraceMergerOrdersByTimestamp) {
+  std::string first_trace = testing::TempDir() + "thread0.csv";
+  std::string second_trace = testing::TempDir() + "thread1.csv";
+  std::ofstream(first_trace) << "header\ntimestamp,address,size,type\n"
+                             << "1,4096,8,R\n5,8192,8,W\n9,4096,8,R\n";
+  std::ofstream(second_trace) << "header\ntimestamp,address,size,type\n"
+                              << "2,100,4,R\n5,200,4,R\n";
+
+  TraceMerger merger;
+  ASSERT_OK(merger.open({first_trace, second_trace}));
+  std::vector<long> timestamps;
+  std::vector<int> threads;
+  mem_access access;
+  while (merger.next(&access)) {
+    timestamps.push_back(access.timestamp);
+    threads.push_back(access.thread);
+  }
+  EXPECT_EQ(timestamps, std::vector<long>({1, 2, 5, 5, 9}));
+  // ties are broken by trace index
+  EXPECT_EQ(threads, std::vector<int>({0, 1, 0, 1, 0}));
+}
+
+TEST(BasicSuite, TestMalformedRecordsAreSkipped) {
+  std::string trace_file = testing::TempDir() + "malformed.csv";
+  std::ofstream(trace_file) << "header\ntimestamp,address,size,type\n"
+                            << "1,4096,8,R\ngarbage\n2,,8,R\n3,8192,x,W\n"
+                            << "4,12288,8,W,\n5,16384,8,R,t\n6,20480,4,R,1\n"
+                            << "7,24576,8,R,-1\n8,-4096,8,R\n9,28672,0,R\n"
+                            << "10,32768,-8,W\n11,36864,8,R,2\n";
+
+  MappedTraceCursor cursor;
+  ASSERT_OK(cursor.open(trace_file));
+  std::vector<long> timestamps;
+  mem_access access;
+  while (cursor.next(&access)) {
+    timestamps.push_back(access.timestamp);
+  }
+  // a missing tenant is tenant 0, a non-numeric or negative one isn't, and
+  // neither are negative addresses or empty accesses
+  EXPECT_EQ(timestamps, std::vector<long>({1, 4, 6, 11}));
+  EXPECT_EQ(cursor.malformedRecords(), 8);
+}
+
+TEST(BasicSuite, TestTimeParallelMatchesSequential) {
+  std::vector<mem_access> trace;
+  for (int i = 0; i < 8000; i++) {
+    // phases of locality with some page-crossing accesses
+    uintptr_t base = (i / 1000) % 3 * 64 * PAGE_SIZE;
+    trace.push_back({base + static_cast<uintptr_t>((i * 2654435761u) % 65536),
+                     (i % 7 == 0) ? 64 : 8});
+    trace.back().tenant = i / 1500 % 2;
+    trace.back().thread = i % 3;
+    trace.back().is_write = i % 4 == 0;
+  }
+  // stores, a DRAM tier and a prefetcher exercise the counters beyond hits
+  // and misses
+  auto configure = [](OCSCache *cache) {
+    cache->setThreadAttribution(true);
+    cache->setDramTier(/*capacity_pages=*/2, LocalDramTier::LRU);
+    cache->setPrefetcher(new NextNLinePrefetcher(1));
+  };
+
+  OCSCache *sequential = new ClockOCSCache(
+      /*pool_size_bytes=*/8192, /*max_concurrent_pools=*/2,
+      /*max_conrreutn_backing_store_nodes*/ 4);
+  configure(sequential);
+  bool hit;
+  for (const mem_access &access : trace) {
+    ASSERT_OK(sequential->handleMemoryAccess(access, &hit));
+  }
+
+  OCSCache *parallel = new ClockOCSCache(
+      /*pool_size_bytes=*/8192, /*max_concurrent_pools=*/2,
+      /*max_conrreutn_backing_store_nodes*/ 4);
+  configure(parallel);
+  time_parallel_options options;
+  options.chunks = 4;
+  options.checkpoint_interval = 256;
+  time_parallel_report report;
+  ASSERT_OK(simulateTimeParallel(trace, &parallel, options, &report));
+
+  EXPECT_EQ(report.unverified_accesses, 0);
+  EXPECT_EQ(printed(parallel->getPerformanceStats()),
+            printed(sequential->getPerformanceStats()));
+  // the per-tenant and per-thread breakdowns are stitched together too
+  EXPECT_EQ(printed(parallel->getTenantPerformanceStats()),
+            printed(sequential->getTenantPerformanceStats()));
+  EXPECT_EQ(printed(parallel->getThreadPerformanceStats()),
+            printed(sequential->getThreadPerformanceStats()));
+  ASSERT_EQ(parallel->getTenantPerformanceStats().size(), 2);
+  EXPECT_GT(parallel->getTenantPerformanceStats()[1].accesses, 0);
+  perf_stats stats = sequential->getPerformanceStats();
+  EXPECT_GT(stats.dram_tier_writebacks, 0);
+  EXPECT_GT(stats.off_node_stores, 0);
+  EXPECT_GT(stats.prefetches_issued, 0);
+}
+
+TEST(BasicSuite, TestDetectedStackIsFilteredAsDRAM) {
+  std::vector<mem_access> trace;
+  for (int i = 0; i < 1000; i++) {
+    // a heap low in the address space and a stack far above it
+    uintptr_t heap = 0x10000000 + (i % 50) * PAGE_SIZE;
+    uintptr_t stack = 0x7ff000000000 - (i % 10) * PAGE_SIZE;
+    trace.push_back({i % 3 == 0 ? stack : heap, 8});
+  }
+
+  StackRegionDetector detector;
+  for (const mem_access &access : trace) {
+    detector.observe(access.addr);
+  }
+  std::vector<addr_subspace> regions;
+  ASSERT_TRUE(detector.detect(&regions));
+  ASSERT_EQ(regions.size(), 1);
+  EXPECT_LE(regions[0].addr_start, 0x7ff000000000 - 9 * PAGE_SIZE);
+  EXPECT_GT(regions[0].addr_start, 0x10000000 + 50 * PAGE_SIZE);
+
+  // the scalar loop, then the AVX2 path where the CPU supports it
+  for (bool avx2 : {false, true}) {
+    SCOPED_TRACE(avx2 ? "avx2" : "scalar");
+    setAvx2Enabled(avx2);
+    std::vector<uint32_t> off_node;
+    size_t dram = prefilterDramAccesses(trace.data(), trace.size(), regions,
+                                        &off_node);
+    EXPECT_EQ(dram, 334);
+    ASSERT_EQ(off_node.size(), 666);
+    for (uint32_t idx : off_node) {
+      EXPECT_NE(idx % 3, 0);
+    }
+  }
+}
+
+TEST(BasicSuite, TestCandidateTableCountsAndInvalidates) {
+  // the scalar loop, then the AVX2 path where the CPU supports it
+  for (bool avx2 : {false, true}) {
+    SCOPED_TRACE(avx2 ? "avx2" : "scalar");
+    setAvx2Enabled(avx2);
+    CandidateTable table;
+    // more candidates than fit in one vector, so the scalar tail runs too
+    for (int i = 0; i < 7; i++) {
+      table.add({static_cast<uintptr_t>(i) * PAGE_SIZE,
+                 static_cast<uintptr_t>(i + 1) * PAGE_SIZE, i % 2});
+    }
+
+    // two accesses to the end of page 2 (tenant 0), one straddling into page 3
+    table.update({3 * PAGE_SIZE - 8, 4}, /*invalidation_ratio=*/2);
+    table.update({3 * PAGE_SIZE - 2, 4}, /*invalidation_ratio=*/2);
+
+    EXPECT_EQ(table.findValid({2 * PAGE_SIZE, 1}), 2);
+    EXPECT_EQ(table.get(2).on_cluster_accesses, 2);
+    EXPECT_EQ(table.get(2).off_cluster_accesses, 0);
+    // page 3 belongs to tenant 1, so the straddling access is off-cluster
+    EXPECT_EQ(table.get(3).on_cluster_accesses, 0);
+    EXPECT_EQ(table.get(3).off_cluster_accesses, 1);
+    for (int i = 0; i < 7; i++) {
+      EXPECT_EQ(table.isValid(i), i == 2) << "candidate " << i;
+    }
+    // invalid candidates stop counting
+    EXPECT_EQ(table.get(6).off_cluster_accesses, 1);
+    EXPECT_EQ(table.findValid({3 * PAGE_SIZE, 1, /*tenant=*/1}), -1);
+
+    // a candidate that counted more than 2^32 accesses in a long run isn't
+    // invalidated by a handful of off-cluster ones
+    access_run_bounds run;
+    run.add({2 * PAGE_SIZE, 8});
+    table.updateRun(run, (1L << 32) + 1, /*invalidation_ratio=*/2);
+    for (int i = 0; i < 10; i++) {
+      table.update({5 * PAGE_SIZE, 8}, /*invalidation_ratio=*/2);
+    }
+    EXPECT_TRUE(table.isValid(2));
+  }
+}
+
+TEST(BasicSuite, TestInvalidatedPoolsAreReclaimed) {
+  OCSCache *cache = new BasicOCSCache(
+      /*pool_size_bytes=*/2 * PAGE_SIZE, /*max_concurrent_pools=*/2,
+      /*max_conrreutn_backing_store_nodes*/ 4);
+
+  // hammer one two-page region after another, so each gets its own OCS pool
+  // that invalidates both backing store pages underneath it
+  bool hit;
+  for (uintptr_t region = 0; region < 100; region++) {
+    uintptr_t base = (region + 1) * 1024 * PAGE_SIZE;
+    for (int i = 0; i < 200; i++) {
+      ASSERT_OK(cache->handleMemoryAccess(
+          {base + PAGE_SIZE / 2 + (i % 16) * (PAGE_SIZE / 8), 8}, &hit));
+    }
+  }
+
+  perf_stats stats = cache->getPerformanceStats();
+  EXPECT_EQ(stats.num_ocs_pools, 100);
+  // only the invalidated pages still held by a cache slot, or invalidated
+  // since the last compaction, may remain
+  EXPECT_LT(cache->numPoolEntries(),
+            stats.num_ocs_pools + stats.num_backing_store_pools + 64 + 4);
+
+  // the first pool, the first region's first page, was invalidated and
+  // reclaimed; its id went stale while its slot was reused
+  EXPECT_FALSE(cache->poolIsLive(makePoolId(0, 0)));
+  ASSERT_EQ(cache->getCachedOCSPools().size(), 2);
+  for (const pool_entry *pool : cache->getCachedOCSPools()) {
+    EXPECT_TRUE(cache->poolIsLive(pool->id));
+    // a slot reclaimed before comes back under a new generation
+    EXPECT_GT(poolIdGeneration(pool->id), 0);
+    EXPECT_FALSE(cache->poolIsLive(
+        makePoolId(poolIdSlot(pool->id), poolIdGeneration(pool->id) - 1)));
+  }
+  delete cache;
+}
+
+TEST(BasicSuite, TestPoolAggregatesMatchARescan) {
+  OCSCache *cache = new BasicOCSCache(
+      /*pool_size_bytes=*/2 * PAGE_SIZE, /*max_concurrent_pools=*/2,
+      /*max_conrreutn_backing_store_nodes*/ 4);
+  dematerialization_params dematerialization;
+  dematerialization.epoch_accesses = 100;
+  cache->setDematerialization(dematerialization);
+
+  // the per-tenant breakdown recounts the pools from scratch
+  auto expectAggregatesMatchRescan = [cache]() {
+    perf_stats stats = cache->getPerformanceStats();
+    perf_stats rescan;
+    for (const perf_stats &tenant : cache->getTenantPerformanceStats()) {
+      rescan.ocs_pool_mem_usage += tenant.ocs_pool_mem_usage;
+      rescan.backing_store_mem_usage += tenant.backing_store_mem_usage;
+      rescan.num_ocs_pools += tenant.num_ocs_pools;
+      rescan.num_backing_store_pools += tenant.num_backing_store_pools;
+    }
+    EXPECT_EQ(stats.ocs_pool_mem_usage, rescan.ocs_pool_mem_usage);
+    EXPECT_EQ(stats.backing_store_mem_usage, rescan.backing_store_mem_usage);
+    EXPECT_EQ(stats.num_ocs_pools, rescan.num_ocs_pools);
+    EXPECT_EQ(stats.num_backing_store_pools, rescan.num_backing_store_pools);
+  };
+
+  // hot regions of two tenants materialize OCS pools over their pages, then
+  // go cold and are dematerialized, with scattered pages in between
+  bool hit;
+  std::mt19937_64 rng(3);
+  for (int phase = 0; phase < 12; phase++) {
+    uintptr_t region = (phase % 5 + 1) * 1024 * PAGE_SIZE;
+    for (int i = 0; i < 250; i++) {
+      mem_access access = {region + PAGE_SIZE / 2 + (i % 16) * (PAGE_SIZE / 8),
+                           8};
+      if (i % 5 == 0) {
+        access.addr = (rng() % 4096 + 8192) * PAGE_SIZE;
+      }
+      access.tenant = phase % 2;
+      ASSERT_OK(cache->handleMemoryAccess(access, &hit));
+    }
+    expectAggregatesMatchRescan();
+  }
+  perf_stats stats = cache->getPerformanceStats();
+  EXPECT_GT(stats.ocs_pools_dematerialized, 0);
+  EXPECT_GT(stats.backing_store_bytes_displaced, 0);
+
+  cache->compactPools();
+  expectAggregatesMatchRescan();
+  delete cache;
+}
+
+TEST(BasicSuite, TestMaterializationDisplacesOnlyCoveredPages) {
+  OCSCache *cache = new BasicOCSCache(
+      /*pool_size_bytes=*/2 * PAGE_SIZE, /*max_concurrent_pools=*/2,
+      /*max_conrreutn_backing_store_nodes*/ 4);
+
+  // the first access places the candidate at [base, base + 2 pages), later
+  // accesses also touch the page after it
+  uintptr_t base = 1024 * PAGE_SIZE;
+  bool hit;
+  for (int i = 0; i < 200; i++) {
+    ASSERT_OK(cache->handleMemoryAccess(
+        {base + PAGE_SIZE / 2 + (i % 16) * (PAGE_SIZE / 8), 8}, &hit));
+  }
+
+  perf_stats stats = cache->getPerformanceStats();
+  ASSERT_EQ(stats.num_ocs_pools, 1);
+  EXPECT_EQ(stats.backing_store_bytes_displaced, 2 * PAGE_SIZE);
+  // the page past the OCS pool stays in the backing store
+  EXPECT_EQ(stats.num_backing_store_pools, 1);
+  delete cache;
+}
+
+TEST(BasicSuite, TestRuntimePageSize) {
+  OCSCache *cache = new FarMemCache(/*backing_store_cache_size*/ 4);
+  EXPECT_EQ(cache->setPageSize(3 * PAGE_SIZE), OCSCache::Status::BAD);
+  ASSERT_OK(cache->setPageSize(64 * 1024));
+
+  bool hit;
+  // sixteen 4KiB pages fit in one 64KiB page, the last access starts another
+  for (uintptr_t addr = 0; addr <= 64 * 1024; addr += PAGE_SIZE) {
+    ASSERT_OK(cache->handleMemoryAccess({0x10000000 + addr, 8}, &hit));
+  }
+  perf_stats stats = cache->getPerformanceStats();
+  EXPECT_EQ(stats.num_backing_store_pools, 2);
+  EXPECT_EQ(stats.backing_store_mem_usage, 2 * 64 * 1024);
+  EXPECT_EQ(stats.backing_store_misses, 2);
+
+  // the page size is fixed once there are pages
+  EXPECT_EQ(cache->setPageSize(4096), OCSCache::Status::BAD);
+  delete cache;
+}
+
+TEST(BasicSuite, TestPrefetchersCoverPredictableMisses) {
+  bool hit;
+
+  // a strided scan: once the stride has repeated, (nearly) every page is
+  // prefetched
+  OCSCache *strided = new FarMemCache(/*backing_store_cache_size*/ 4);
+  strided->setPrefetcher(makePrefetcher("stride", /*degree=*/1));
+  for (uintptr_t page = 0; page < 100; page++) {
+    ASSERT_OK(strided->handleMemoryAccess(
+        {0x10000000 + page * 2 * PAGE_SIZE, 8}, &hit));
+  }
+  perf_stats stats = strided->getPerformanceStats();
+  EXPECT_LE(stats.backing_store_misses, 5);
+  EXPECT_EQ(stats.prefetch_hits, 100 - stats.backing_store_misses);
+  EXPECT_EQ(stats.prefetch_bytes, stats.prefetches_issued * PAGE_SIZE);
+  delete strided;
+
+  // a loop over more pages than fit in cache: once the loop has been seen,
+  // the correlation table predicts every miss
+  OCSCache *looping = new FarMemCache(/*backing_store_cache_size*/ 4);
+  looping->setPrefetcher(makePrefetcher("markov", /*degree=*/1));
+  for (int i = 0; i < 60; i++) {
+    uintptr_t page = (i * 5) % 6; // visits pages 0, 5, 4, ... 1, 0, ...
+    ASSERT_OK(looping->handleMemoryAccess(
+        {0x10000000 + page * PAGE_SIZE, 8}, &hit));
+  }
+  stats = looping->getPerformanceStats();
+  EXPECT_GT(stats.prefetch_hits, 0);
+  EXPECT_LE(stats.prefetch_hits, stats.prefetches_issued);
+  EXPECT_LT(stats.backing_store_misses, 60 - 6);
+  delete looping;
+}
+
+TEST(BasicSuite, TestDirtyPagesAreWrittenBackOnEviction) {
+  OCSCache *cache = new FarMemCache(/*backing_store_cache_size*/ 1);
+  bool hit;
+  mem_access store = {0x10000000, 8};
+  store.is_write = true;
+  mem_access load_other = {0x10000000 + PAGE_SIZE, 8};
+  mem_access load_first = {0x10000000, 8};
+
+  ASSERT_OK(cache->handleMemoryAccess(store, &hit));
+  ASSERT_OK(cache->handleMemoryAccess(load_other, &hit)); // evicts the store
+  ASSERT_OK(cache->handleMemoryAccess(load_first, &hit)); // evicts a clean page
+
+  perf_stats stats = cache->getPerformanceStats();
+  EXPECT_EQ(stats.off_node_stores, 1);
+  EXPECT_EQ(stats.off_node_loads, 2);
+  EXPECT_EQ(stats.backing_store_writebacks, 1);
+  EXPECT_EQ(stats.backing_store_writeback_bytes, PAGE_SIZE);
+  delete cache;
+}
+
+TEST(BasicSuite, TestTimingModelQueuesMissesOnTheLink) {
+  // the calendar queue pops in time order, including events past its year
+  CalendarQueue queue(/*bucket_width_ns=*/10, /*num_buckets=*/8);
+  for (long time : {75, 3, 500, 42, 3, 1000000, 80}) {
+    queue.push(time);
+  }
+  std::vector<long> popped;
+  while (!queue.empty()) {
+    popped.push_back(queue.top());
+    queue.pop();
+  }
+  EXPECT_EQ(popped, std::vector<long>({3, 3, 42, 75, 80, 500, 1000000}));
+
+  // four misses issued at once over a link moving a page per microsecond,
+  // with two misses in flight at most
+  OCSCache *cache = new FarMemCache(/*backing_store_cache_size*/ 4);
+  timing_params params;
+  params.link_bytes_per_ns = PAGE_SIZE / 1000.0;
+  params.far_memory_latency_ns = 0;
+  params.max_outstanding_misses = 2;
+  TimingModel timing(params);
+  bool hit;
+  for (int page = 0; page < 4; page++) {
+    ASSERT_OK(timing.handleMemoryAccess(
+        cache, {0x10000000 + page * static_cast<uintptr_t>(PAGE_SIZE), 8},
+        &hit));
+  }
+
+  timing_report report = timing.finish();
+  EXPECT_EQ(report.timed_accesses, 4);
+  EXPECT_EQ(report.makespan_ns, 4000);
+  EXPECT_EQ(report.link_busy_ns, 4000);
+  // the third and fourth misses wait for the first and second to complete
+  EXPECT_EQ(report.mlp_stall_ns, 1000 + 2000);
+  EXPECT_EQ(report.latency.max_ns, 4000);
+  EXPECT_EQ(report.latency.mean_ns, 2500.0);
+  // percentiles are within a sixteenth of the true latency
+  EXPECT_GE(report.latency.p50_ns, 2000);
+  EXPECT_LE(report.latency.p50_ns, 2000 + 2000 / 16);
+  delete cache;
+}
+
+TEST(BasicSuite, TestPendingReconfigurationsFallBackOrStall) {
+  for (bool stall : {false, true}) {
+    OCSCache *cache = new BasicOCSCache(
+        /*pool_size_bytes=*/2 * PAGE_SIZE, /*max_concurrent_pools=*/2,
+        /*max_conrreutn_backing_store_nodes*/ 4);
+    reconfiguration_params reconfiguration;
+    reconfiguration.delay = 10;
+    reconfiguration.delay_in_accesses = true;
+    reconfiguration.stall_pending = stall;
+    cache->setReconfiguration(reconfiguration);
+
+    // every access falls within the OCS pool materialized for the region
+    uintptr_t base = 1024 * PAGE_SIZE;
+    bool hit;
+    for (int i = 0; i < 200; i++) {
+      ASSERT_OK(cache->handleMemoryAccess(
+          {base + PAGE_SIZE / 2 + (i % 8) * (PAGE_SIZE / 8), 8}, &hit));
+    }
+
+    // the reconfiguring access and the 9 after it find the port in flight
+    perf_stats stats = cache->getPerformanceStats();
+    ASSERT_EQ(stats.ocs_reconfigurations, 1);
+    if (stall) {
+      EXPECT_EQ(stats.reconfiguration_fallbacks, 0);
+      EXPECT_EQ(stats.reconfiguration_stall, 10 + 9 + 8 + 7 + 6 + 5 + 4 + 3 +
+                                                 2 + 1);
+    } else {
+      EXPECT_EQ(stats.reconfiguration_fallbacks, 10);
+      EXPECT_EQ(stats.reconfiguration_stall, 0);
+    }
+    EXPECT_EQ(stats.wasted_reconfigurations, 0);
+    delete cache;
+  }
+}
+
+TEST(BasicSuite, TestDensityClusteringMaterializesDenseAlignedRegions) {
+  OCSCache *cache = new DensityOCSCache(
+      /*pool_size_bytes=*/4 * PAGE_SIZE, /*max_concurrent_pools=*/2,
+      /*max_conrreutn_backing_store_nodes*/ 4, /*epoch_accesses=*/1000);
+
+  // sweep every page of one region, and hammer a single page of another
+  uintptr_t dense = 1024 * PAGE_SIZE;
+  uintptr_t sparse = 2048 * PAGE_SIZE;
+  bool hit;
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_OK(cache->handleMemoryAccess(
+        {dense + (i % 16) * (PAGE_SIZE / 4) + 64, 8}, &hit));
+    ASSERT_OK(cache->handleMemoryAccess({sparse + 3 * PAGE_SIZE + 64, 8},
+                                        &hit));
+  }
+
+  perf_stats stats = cache->getPerformanceStats();
+  ASSERT_EQ(stats.num_ocs_pools, 1);
+  EXPECT_EQ(stats.candidates_promoted, 1);
+  // the pool is the aligned region, so it covers every page of the sweep
+  EXPECT_EQ(stats.backing_store_bytes_displaced, 4 * PAGE_SIZE);
+  delete cache;
+}
+
+TEST(BasicSuite, TestAdaptiveClusteringTunesThresholds) {
+  uintptr_t region_a = 1024 * PAGE_SIZE;
+  uintptr_t region_b = 2048 * PAGE_SIZE;
+  auto access = [](uintptr_t region, int i) -> mem_access {
+    return {region + PAGE_SIZE / 2 + (i % 8) * (PAGE_SIZE / 8), 8};
+  };
+  bool hit;
+
+  // a single hot region keeps hitting its pool, so the bar is lowered
+  AdaptiveOCSCache paying(/*pool_size_bytes=*/2 * PAGE_SIZE,
+                          /*max_concurrent_pools=*/1,
+                          /*max_conrreutn_backing_store_nodes*/ 4,
+                          /*window_accesses=*/1000);
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_OK(paying.handleMemoryAccess(access(region_a, i), &hit));
+  }
+  EXPECT_LT(paying.getMinOnClusterAccesses(), 100);
+  EXPECT_LT(paying.getInvalidationRatio(), 4);
+
+  // two pools alternating on a single OCS slot thrash it, so it's raised
+  AdaptiveOCSCache thrashing(/*pool_size_bytes=*/2 * PAGE_SIZE,
+                             /*max_concurrent_pools=*/1,
+                             /*max_conrreutn_backing_store_nodes*/ 4,
+                             /*window_accesses=*/1000);
+  for (int i = 0; i < 200; i++) {
+    ASSERT_OK(thrashing.handleMemoryAccess(access(region_a, i), &hit));
+  }
+  for (int i = 0; i < 200; i++) {
+    ASSERT_OK(thrashing.handleMemoryAccess(access(region_b, i), &hit));
+  }
+  ASSERT_EQ(thrashing.getPerformanceStats().num_ocs_pools, 2);
+  for (int i = 0; i < 600; i++) {
+    ASSERT_OK(thrashing.handleMemoryAccess(
+        access(i % 2 == 0 ? region_a : region_b, i), &hit));
+  }
+  EXPECT_GT(thrashing.getMinOnClusterAccesses(), 100);
+  EXPECT_GT(thrashing.getInvalidationRatio(), 4);
+}
+
+TEST(BasicSuite, TestDramTierFiltersOffNodeAccesses) {
+  OCSCache *cache = new FarMemCache(/*backing_store_cache_size*/ 4);
+  cache->setDramTier(/*capacity_pages=*/2, LocalDramTier::LRU);
+  uintptr_t base = 0x10000000;
+  mem_access a = {base, 8};
+  mem_access b = {base + PAGE_SIZE, 8};
+  b.is_write = true;
+  mem_access c = {base + 2 * PAGE_SIZE, 8};
+  bool hit;
+
+  // A, B and C miss; C evicts the least recently used page, the dirty B
+  for (const mem_access &access : {a, b, a, c, a, b}) {
+    ASSERT_OK(cache->handleMemoryAccess(access, &hit));
+  }
+
+  perf_stats stats = cache->getPerformanceStats();
+  EXPECT_EQ(stats.dram_tier_hits, 2);
+  EXPECT_EQ(stats.dram_tier_misses, 4);
+  EXPECT_EQ(stats.dram_tier_evictions, 2);
+  EXPECT_EQ(stats.dram_tier_writebacks, 1);
+  EXPECT_EQ(stats.dram_hits, 2);
+  // only the misses reach the off-node tiers
+  EXPECT_EQ(stats.off_node_loads + stats.off_node_stores, 4);
+  delete cache;
+}
+
+TEST(BasicSuite, TestDramTierWritesBackStoresToTheTierBelow) {
+  OCSCache *cache = new ClockFMCache(/*backing_store_cache_size*/ 2);
+  cache->setDramTier(/*capacity_pages=*/1, LocalDramTier::LRU);
+  uintptr_t base = 0x10000000;
+  mem_access a = {base, 8};
+  mem_access a_store = {base, 8};
+  a_store.is_write = true;
+  mem_access b = {base + PAGE_SIZE, 8};
+  mem_access c = {base + 2 * PAGE_SIZE, 8};
+  bool hit;
+
+  // the store hits A in the DRAM tier, B evicts it from there, dirtying the
+  // cached page below
+  for (const mem_access &access : {a, a_store, b}) {
+    ASSERT_OK(cache->handleMemoryAccess(access, &hit));
+  }
+  perf_stats stats = cache->getPerformanceStats();
+  EXPECT_EQ(stats.dram_tier_hits, 1);
+  EXPECT_EQ(stats.dram_tier_writebacks, 1);
+  EXPECT_EQ(stats.backing_store_writebacks, 0);
+
+  // C evicts A from the backing store cache, which writes it back
+  ASSERT_OK(cache->handleMemoryAccess(c, &hit));
+  stats = cache->getPerformanceStats();
+  EXPECT_EQ(stats.dram_tier_writebacks, 1);
+  EXPECT_EQ(stats.backing_store_writebacks, 1);
+  delete cache;
+}
+
+TEST(BasicSuite, TestDramTierHoldsEveryPageAnAccessCrosses) {
+  OCSCache *cache = new ClockFMCache(/*backing_store_cache_size*/ 4);
+  cache->setDramTier(/*capacity_pages=*/2, LocalDramTier::LRU);
+  uintptr_t base = 0x10000000;
+  mem_access a = {base, 8};
+  // crosses from A into B
+  mem_access crossing = {base + PAGE_SIZE - 4, 8};
+  mem_access crossing_store = crossing;
+  crossing_store.is_write = true;
+  bool hit;
+
+  // A alone in the DRAM tier doesn't serve an access that also touches B
+  ASSERT_OK(cache->handleMemoryAccess(a, &hit));
+  ASSERT_OK(cache->handleMemoryAccess(crossing, &hit));
+  perf_stats stats = cache->getPerformanceStats();
+  EXPECT_EQ(stats.dram_tier_hits, 0);
+  EXPECT_EQ(stats.dram_tier_misses, 2);
+  EXPECT_FALSE(hit);
+
+  // with both in the tier, the store hits and dirties both
+  ASSERT_OK(cache->handleMemoryAccess(crossing_store, &hit));
+  EXPECT_TRUE(hit);
+  EXPECT_EQ(cache->getPerformanceStats().dram_tier_hits, 1);
+
+  // C and D evict A and B from the tier, dirtying the cached pages below
+  for (int page = 2; page < 4; page++) {
+    ASSERT_OK(cache->handleMemoryAccess({base + page * PAGE_SIZE, 8}, &hit));
+  }
+  stats = cache->getPerformanceStats();
+  EXPECT_EQ(stats.dram_tier_writebacks, 2);
+  EXPECT_EQ(stats.dram_tier_writeback_bytes, 2 * static_cast<long>(PAGE_SIZE));
+
+  // four more pages evict every page from the backing store cache, A and B
+  // are written back
+  for (int page = 4; page < 8; page++) {
+    ASSERT_OK(cache->handleMemoryAccess({base + page * PAGE_SIZE, 8}, &hit));
+  }
+  stats = cache->getPerformanceStats();
+  EXPECT_EQ(stats.backing_store_writebacks, 2);
+  delete cache;
+}
+
+TEST(BasicSuite, TestColdPoolsAreDematerialized) {
+  OCSCache *cache = new BasicOCSCache(
+      /*pool_size_bytes=*/2 * PAGE_SIZE, /*max_concurrent_pools=*/2,
+      /*max_conrreutn_backing_store_nodes*/ 4);
+  dematerialization_params dematerialization;
+  dematerialization.epoch_accesses = 100;
+  cache->setDematerialization(dematerialization);
+
+  auto access = [](uintptr_t region, int i) -> mem_access {
+    return {region + PAGE_SIZE / 2 + (i % 8) * (PAGE_SIZE / 8), 8};
+  };
+  uintptr_t region_a = 1024 * PAGE_SIZE;
+  uintptr_t region_b = 2048 * PAGE_SIZE;
+  bool hit;
+
+  // a phase on region A, then a longer one on region B
+  for (int i = 0; i < 300; i++) {
+    ASSERT_OK(cache->handleMemoryAccess(access(region_a, i), &hit));
+  }
+  ASSERT_EQ(cache->getPerformanceStats().num_ocs_pools, 1);
+  for (int i = 0; i < 600; i++) {
+    ASSERT_OK(cache->handleMemoryAccess(access(region_b, i), &hit));
+  }
+
+  // only A's pool went cold
+  perf_stats stats = cache->getPerformanceStats();
+  EXPECT_EQ(stats.ocs_pools_dematerialized, 1);
+  EXPECT_EQ(stats.dematerialized_bytes, 2 * PAGE_SIZE);
+  EXPECT_EQ(stats.num_ocs_pools, 1);
+
+  // A is served by the backing store again
+  ASSERT_OK(cache->handleMemoryAccess(access(region_a, 0), &hit));
+  EXPECT_EQ(cache->getPerformanceStats().backing_store_misses,
+            stats.backing_store_misses + 1);
+  delete cache;
+}
+
+TEST(BasicSuite, TestPackedPoolsHoldSeveralHotCandidates) {
+  auto run = [](bool pack, perf_stats *stats) {
+    OCSCache *cache = new BasicOCSCache(
+        /*pool_size_bytes=*/4 * PAGE_SIZE, /*max_concurrent_pools=*/2,
+        /*max_conrreutn_backing_store_nodes*/ 4);
+    cache->setPoolPacking(pack);
+    auto access = [](uintptr_t region, int i) -> mem_access {
+      return {region + PAGE_SIZE / 2 + (i % 8) * (PAGE_SIZE / 16), 8};
+    };
+    uintptr_t region_a = 1024 * PAGE_SIZE;
+    uintptr_t region_b = 2048 * PAGE_SIZE;
+    bool hit;
+
+    // B warms up, then A gets promoted while B is still a hot candidate
+    for (int i = 0; i < 60; i++) {
+      ASSERT_OK(cache->handleMemoryAccess(access(region_b, i), &hit));
+    }
+    for (int i = 0; i < 101; i++) {
+      ASSERT_OK(cache->handleMemoryAccess(access(region_a, i), &hit));
+    }
+    ASSERT_EQ(cache->getPerformanceStats().num_ocs_pools, 1);
+    for (int i = 0; i < 10; i++) {
+      ASSERT_OK(cache->handleMemoryAccess(access(region_b, i), &hit));
+    }
+    *stats = cache->getPerformanceStats();
+    delete cache;
+  };
+
+  perf_stats plain, packed;
+  run(/*pack=*/false, &plain);
+  run(/*pack=*/true, &packed);
+
+  // A's pool only holds the page it touched, with B's page packed alongside
+  EXPECT_EQ(plain.candidates_packed, 0);
+  EXPECT_EQ(packed.candidates_packed, 1);
+  EXPECT_EQ(packed.ocs_pool_mem_usage, 2 * PAGE_SIZE);
+  // B's accesses go to the backing store, or to the packed pool after one
+  // reconfiguration
+  EXPECT_EQ(plain.ocs_pool_hits + plain.ocs_reconfigurations, 0);
+  EXPECT_EQ(packed.ocs_reconfigurations, 1);
+  EXPECT_EQ(packed.ocs_pool_hits, 9);
+}
+
+TEST(BasicSuite, TestSlotsMoveToTheTierWithGhostHits) {
+  auto run = [](bool partition, perf_stats *stats) -> OCSCache * {
+    OCSCache *cache = new BasicOCSCache(
+        /*pool_size_bytes=*/2 * PAGE_SIZE, /*max_concurrent_pools=*/2,
+        /*max_conrreutn_backing_store_nodes*/ 2);
+    if (partition) {
+      slot_partitioning_params slot_partitioning;
+      slot_partitioning.epoch_accesses = 50;
+      cache->setSlotPartitioning(slot_partitioning);
+    }
+    bool hit;
+    // cycle over 4 far apart pages, too scattered to ever be clustered
+    for (int i = 0; i < 400; i++) {
+      mem_access access = {(1024 + (i % 4) * 1024UL) * PAGE_SIZE, 8};
+      EXPECT_EQ(cache->handleMemoryAccess(access, &hit), OCSCache::Status::OK);
+    }
+    *stats = cache->getPerformanceStats();
+    return cache;
+  };
+
+  perf_stats fixed, partitioned;
+  delete run(/*partition=*/false, &fixed);
+  OCSCache *cache = run(/*partition=*/true, &partitioned);
+
+  // the idle OCS gives up all but one slot to the thrashing backing store
+  EXPECT_EQ(fixed.backing_store_ghost_hits, 0);
+  EXPECT_GT(partitioned.backing_store_ghost_hits, 0);
+  EXPECT_EQ(partitioned.ocs_pool_hits + partitioned.ocs_reconfigurations, 0);
+  EXPECT_EQ(partitioned.slot_repartitions, 1);
+  EXPECT_EQ(cache->getOCSSlots(), 1);
+  EXPECT_EQ(cache->getBackingStoreSlots(), 3);
+  ASSERT_EQ(cache->getSlotPartitionHistory().size(), 2u);
+  EXPECT_EQ(cache->getSlotPartitionHistory()[1].off_node_accesses, 50);
+  EXPECT_GT(partitioned.backing_store_hits, fixed.backing_store_hits);
+  delete cache;
+}
+
+TEST(BasicSuite, TestInvalidatedPoolsLeaveNoGhosts) {
+  OCSCache *cache = new ClockOCSCache(
+      /*pool_size_bytes=*/2 * PAGE_SIZE, /*max_concurrent_pools=*/1,
+      /*max_conrreutn_backing_store_nodes*/ 2);
+  slot_partitioning_params slot_partitioning;
+  slot_partitioning.epoch_accesses = 1000000;
+  slot_partitioning.ghost_slots = 1;
+  cache->setSlotPartitioning(slot_partitioning);
+  auto far = [](int page) -> mem_access {
+    return {(4096 + page * 1024UL) * PAGE_SIZE, 8};
+  };
+
+  // page 0 is evicted by a hammered region, whose OCS pool then invalidates
+  // the backing store page it covers while it still sits in a slot
+  bool hit;
+  ASSERT_OK(cache->handleMemoryAccess(far(0), &hit));
+  for (int i = 0; i < 200; i++) {
+    ASSERT_OK(cache->handleMemoryAccess(
+        {1024UL * PAGE_SIZE + (i % 16) * (PAGE_SIZE / 8), 8}, &hit));
+  }
+  perf_stats stats = cache->getPerformanceStats();
+  ASSERT_EQ(stats.num_ocs_pools, 1);
+  ASSERT_EQ(stats.backing_store_bytes_displaced, PAGE_SIZE);
+
+  // replacing an invalidated page doesn't push page 0 out of the ghost tags
+  ASSERT_OK(cache->handleMemoryAccess(far(1), &hit));
+  ASSERT_OK(cache->handleMemoryAccess(far(0), &hit));
+  EXPECT_FALSE(hit);
+  EXPECT_EQ(cache->getPerformanceStats().backing_store_ghost_hits, 1);
+  delete cache;
+}
+
+TEST(BasicSuite, TestDuelingFollowsTheWinningReplacementPolicy) {
+  // a loop over more pages than fit defeats clock, which always evicts the
+  // page needed next, but not random replacement
+  auto run = [](OCSCache *cache) {
+    bool hit;
+    for (int i = 0; i < 2000; i++) {
+      mem_access access = {(1024 + (i % 6) * 1024UL) * PAGE_SIZE, 8};
+      EXPECT_EQ(cache->handleMemoryAccess(access, &hit), OCSCache::Status::OK);
+    }
+    return cache->getPerformanceStats();
+  };
+
+  LiberalClockOCSCache clock(/*pool_size_bytes=*/2 * PAGE_SIZE,
+                             /*max_concurrent_pools=*/2,
+                             /*max_conrreutn_backing_store_nodes*/ 4);
+  DuelingOCSCache dueling(/*pool_size_bytes=*/2 * PAGE_SIZE,
+                          /*max_concurrent_pools=*/2,
+                          /*max_conrreutn_backing_store_nodes*/ 4);
+  perf_stats clock_stats = run(&clock);
+  perf_stats dueling_stats = run(&dueling);
+
+  EXPECT_EQ(clock_stats.backing_store_hits, 0);
+  EXPECT_EQ(dueling.followerPolicy(/*is_ocs_pool=*/false),
+            DuelingOCSCache::RANDOM);
+  EXPECT_GE(dueling_stats.replacement_policy_switches, 1);
+  EXPECT_GT(dueling_stats.backing_store_hits, 200);
+
+  // the random shadow follows the cache's seed
+  struct ShadowRngProbe : DuelingOCSCache {
+    using DuelingOCSCache::DuelingOCSCache;
+    uint64_t nextShadowDraw() { return shadow_rng(); }
+  };
+  auto firstShadowDraw = [](uint64_t seed) {
+    ShadowRngProbe cache(/*pool_size_bytes=*/2 * PAGE_SIZE,
+                         /*max_concurrent_pools=*/2,
+                         /*max_conrreutn_backing_store_nodes*/ 4);
+    cache.setSeed(seed);
+    return cache.nextShadowDraw();
+  };
+  EXPECT_EQ(firstShadowDraw(1), firstShadowDraw(1));
+  EXPECT_NE(firstShadowDraw(1), firstShadowDraw(2));
+}
+
+TEST(BasicSuite, TestPageResolutionIsSharedAcrossCaches) {
+  std::vector<addr_subspace> stack = {{STACK_FLOOR + 1, UINTPTR_MAX}};
+  std::vector<mem_access> trace;
+  for (int i = 0; i < 300; i++) {
+    // two stack accesses, then one that may cross a page boundary
+    trace.push_back({STACK_FLOOR + 64, 8});
+    trace.push_back({STACK_FLOOR + 128, 8});
+    trace.push_back({1024UL * PAGE_SIZE + (i % 8) * (PAGE_SIZE - 4), 8});
+  }
+
+  PageResolvedTrace resolved;
+  resolved.resolve(trace, PAGE_SIZE, stack);
+  ASSERT_EQ(resolved.records().size(), 600u);
+  EXPECT_TRUE(resolved.records()[0].is_dram);
+  EXPECT_EQ(resolved.records()[0].count, 2u);
+  EXPECT_EQ(resolved.records()[1].first_page, 1024u);
+  EXPECT_EQ(resolved.records()[3].count, 2u); // crosses into the next page
+  EXPECT_TRUE(resolved.matches(trace, PAGE_SIZE, stack));
+  EXPECT_FALSE(resolved.matches(trace, 2 * PAGE_SIZE, stack));
+
+  // caches fed the shared resolution end up where resolving themselves would
+  perf_stats stats[2];
+  for (int shared = 0; shared < 2; shared++) {
+    BasicOCSCache cache(/*pool_size_bytes=*/2 * PAGE_SIZE,
+                        /*max_concurrent_pools=*/2,
+                        /*max_conrreutn_backing_store_nodes*/ 4);
+    cache.setDramRegions(stack);
+    ASSERT_OK(simulateAccesses(trace, &cache, /*summarize_perf=*/true,
+                               /*timing=*/nullptr,
+                               shared ? &resolved : nullptr));
+    stats[shared] = cache.getPerformanceStats();
+  }
+  EXPECT_EQ(stats[1].dram_hits, 600);
+  EXPECT_EQ(stats[1].backing_store_hits, stats[0].backing_store_hits);
+  EXPECT_EQ(stats[1].backing_store_misses, stats[0].backing_store_misses);
+  EXPECT_EQ(stats[1].ocs_pool_hits, stats[0].ocs_pool_hits);
+}
+
+TEST(BasicSuite, TestRunLengthCollapsingMatchesPerAccessSimulation) {
+  std::vector<addr_subspace> stack = {{STACK_FLOOR + 1, UINTPTR_MAX}};
+  std::vector<std::function<OCSCache *()>> caches = {
+      [] { return new BasicOCSCache(2 * PAGE_SIZE, 2, 4); },
+      [] { return new ConservativeClockOCSCache(2 * PAGE_SIZE, 2, 4); },
+      [] { return new DuelingOCSCache(2 * PAGE_SIZE, 2, 4); },
+      [] { return new AdaptiveOCSCache(2 * PAGE_SIZE, 2, 4, 512); },
+      [] { return new DensityOCSCache(2 * PAGE_SIZE, 2, 4, 256, 20); },
+      [] { return new FarMemCache(4); },
+  };
+
+  std::mt19937_64 gen(48);
+  for (int trial = 0; trial < 4; trial++) {
+    // runs of accesses to a few hot pages, some crossing into the next page,
+    // with the odd stack access in between
+    std::vector<mem_access> trace;
+    long timestamp = 0;
+    while (trace.size() < 20000) {
+      uintptr_t page = 1024 + gen() % (gen() % 4 == 0 ? 64 : 6);
+      int tenant = gen() % 2;
+      // long runs cross epoch boundaries and resume in bulk after them
+      size_t repeats = 1 + gen() % (gen() % 16 == 0 ? 400 : 40);
+      for (size_t idx = 0; idx < repeats; idx++) {
+        mem_access access = {page * PAGE_SIZE + gen() % PAGE_SIZE,
+                             static_cast<int>(1 + gen() % 64), tenant};
+        timestamp += 1 + gen() % 3;
+        access.timestamp = timestamp;
+        access.is_write = gen() % 4 == 0;
+        trace.push_back(access);
+      }
+      if (gen() % 8 == 0) {
+        trace.push_back({STACK_FLOOR + 64, 8, tenant});
+      }
+    }
+    PageResolvedTrace resolved;
+    resolved.resolve(trace, PAGE_SIZE, stack);
+    ASSERT_LT(resolved.records().size(), trace.size() / 4);
+
+    for (const auto &make : caches) {
+      OCSCache *per_access = make();
+      OCSCache *collapsed = make();
+      for (OCSCache *cache : {per_access, collapsed}) {
+        cache->setDramRegions(stack);
+        if (trial == 1) {
+          cache->setDramTier(4, LocalDramTier::CLOCK);
+        } else if (trial == 2) {
+          cache->setDematerialization({300, 16, 1});
+          cache->setSlotPartitioning({200, 2, 1});
+        } else if (trial == 3) {
+          cache->setReconfiguration({20, /*delay_in_accesses=*/true});
+          cache->setPoolPacking(true);
+          cache->setPrefetcher(new NextNLinePrefetcher(1));
+        }
+      }
+
+      for (const mem_access &access : trace) {
+        bool hit = false;
+        ASSERT_OK(per_access->handleMemoryAccess(access, &hit));
+      }
+      ASSERT_OK(simulateAccesses(trace, collapsed, /*summarize_perf=*/true,
+                                 /*timing=*/nullptr, &resolved));
+
+      std::vector<uint64_t> signatures[2];
+      per_access->appendStateSignature(&signatures[0]);
+      collapsed->appendStateSignature(&signatures[1]);
+      EXPECT_EQ(signatures[0], signatures[1]) << per_access->getName();
+      std::ostringstream stats[2];
+      stats[0] << per_access->getPerformanceStats();
+      stats[1] << collapsed->getPerformanceStats();
+      EXPECT_EQ(stats[0].str(), stats[1].str()) << per_access->getName();
+      std::vector<perf_stats> tenants[2] = {
+          per_access->getTenantPerformanceStats(),
+          collapsed->getTenantPerformanceStats()};
+      ASSERT_EQ(tenants[0].size(), tenants[1].size());
+      for (size_t tenant = 0; tenant < tenants[0].size(); tenant++) {
+        std::ostringstream tenant_stats[2];
+        tenant_stats[0] << tenants[0][tenant];
+        tenant_stats[1] << tenants[1][tenant];
+        EXPECT_EQ(tenant_stats[0].str(), tenant_stats[1].str());
+      }
+      delete per_access;
+      delete collapsed;
+    }
+  }
+}
+
+TEST(BasicSuite, TestCompressedTraceRoundTrips) {
+  std::mt19937_64 rng(7);
+  std::vector<mem_access> trace;
+  long timestamp = 1000;
+  uintptr_t heap = 0x10000000;
+  for (int i = 0; i < 20000; i++) {
+    mem_access access;
+    // mostly strided heap accesses interleaved with the stack, plus a stretch
+    // of more distinct sizes than a block's dictionary holds
+    bool stack = i % 4 == 3;
+    heap += rng() % 3 == 0 ? rng() % (1 << 20) : 64;
+    access.addr = stack ? 0x7ff000000000 - (rng() % 64) * 8 : heap;
+    access.size = i >= 5000 && i < 5200 ? 1 + i % 100 : 8 << (rng() % 3);
+    access.tenant = (i / 700) % 3;
+    access.timestamp = timestamp += rng() % 5;
+    access.is_write = rng() % 4 == 0;
+    trace.push_back(access);
+  }
+  std::vector<addr_subspace> regions = {{0x7fe000000000, 0x7ff000000000}};
+
+  auto expectSame = [](const mem_access &decoded, const mem_access &access) {
+    EXPECT_EQ(decoded.addr, access.addr);
+    EXPECT_EQ(decoded.size, access.size);
+    EXPECT_EQ(decoded.tenant, access.tenant);
+    EXPECT_EQ(decoded.timestamp, access.timestamp);
+    EXPECT_EQ(decoded.is_write, access.is_write);
+  };
+
+  std::string csv_trace = testing::TempDir() + "compressible.csv";
+  std::string compressed_trace = testing::TempDir() + "compressible.bin";
+  {
+    std::ofstream csv(csv_trace);
+    csv << "header\ntimestamp,address,size,type,tenant\n";
+    for (const mem_access &access : trace) {
+      csv << access.timestamp << "," << access.addr << "," << access.size
+          << "," << (access.is_write ? "W" : "R") << "," << access.tenant
+          << "\n";
+    }
+  }
+  CompressedTraceWriter writer;
+  ASSERT_OK(writer.open(compressed_trace, regions, /*block_records=*/1000));
+  for (const mem_access &access : trace) {
+    ASSERT_OK(writer.append(access));
+  }
+  ASSERT_OK(writer.close());
+  std::ifstream csv_file(csv_trace, std::ios::ate | std::ios::binary);
+  std::ifstream compressed_file(compressed_trace,
+                                std::ios::ate | std::ios::binary);
+  EXPECT_LT(compressed_file.tellg() * 3, csv_file.tellg());
+
+  // streamed record by record, with the scalar varint scan and then the AVX2
+  // one where the CPU supports it
+  MappedTraceCursor cursor;
+  ASSERT_OK(cursor.open(compressed_trace));
+  ASSERT_NE(cursor.getCompressed(), nullptr);
+  ASSERT_EQ(cursor.getDramRegions().size(), 1);
+  EXPECT_EQ(cursor.getDramRegions()[0].addr_start, regions[0].addr_start);
+  EXPECT_EQ(cursor.getDramRegions()[0].addr_end, regions[0].addr_end);
+  const CompressedTraceDecoder &decoder = *cursor.getCompressed();
+  EXPECT_EQ(decoder.numRecords(), trace.size());
+  // the stretch of distinct sizes splits its blocks
+  EXPECT_GT(decoder.numBlocks(), trace.size() / 1000);
+  mem_access access;
+  for (bool avx2 : {false, true}) {
+    SCOPED_TRACE(avx2 ? "avx2" : "scalar");
+    setAvx2Enabled(avx2);
+    CompressedTraceDecoder streaming = decoder;
+    ASSERT_OK(streaming.seek(0));
+    size_t streamed = 0;
+    while (streaming.next(&access)) {
+      ASSERT_LT(streamed, trace.size());
+      expectSame(access, trace[streamed++]);
+    }
+    EXPECT_EQ(streamed, trace.size());
+  }
+
+  // decoded in parallel, and through loadTrace like the CSV
+  std::vector<mem_access> from_csv;
+  std::vector<mem_access> decoded;
+  std::vector<addr_subspace> decoded_regions;
+  ASSERT_OK(loadTrace(csv_trace, 0, &from_csv, nullptr));
+  ASSERT_OK(loadTrace(compressed_trace, 0, &decoded, &decoded_regions));
+  ASSERT_EQ(decoded.size(), from_csv.size());
+  EXPECT_EQ(decoded_regions.size(), 1);
+  for (size_t idx = 0; idx < decoded.size(); idx++) {
+    expectSame(decoded[idx], from_csv[idx]);
+  }
+  std::vector<mem_access> first_records;
+  ASSERT_OK(decoder.decodeAll(1234, 4, &first_records));
+  EXPECT_EQ(first_records.size(), 1234);
+
+  // seeking lands mid-block
+  CompressedTraceDecoder seeker = decoder;
+  for (uint64_t record : {0UL, 999UL, 1000UL, 5150UL, 19999UL}) {
+    ASSERT_OK(seeker.seek(record));
+    ASSERT_TRUE(seeker.next(&access));
+    expectSame(access, trace[record]);
+  }
+  ASSERT_OK(seeker.seek(trace.size()));
+  EXPECT_FALSE(seeker.next(&access));
+}
+
+TEST(BasicSuite, TestCorruptCompressedTracesAreRejected) {
+  std::vector<mem_access> trace;
+  for (int i = 0; i < 3000; i++) {
+    trace.push_back({0x10000000 + i * 64UL, 8});
+  }
+  std::string valid_trace = testing::TempDir() + "valid.bin";
+  ASSERT_OK(writeCompressedTrace(valid_trace, trace, {}));
+  std::ifstream in(valid_trace, std::ios::binary);
+  std::string valid((std::istreambuf_iterator<char>(in)),
+                    std::istreambuf_iterator<char>());
+
+  // the first block follows the 16 byte header, its dictionary size follows
+  // its 16 byte header
+  const size_t first_block = 16;
+  auto openCorrupted = [](const std::string &bytes,
+                          std::vector<mem_access> *decoded) {
+    std::string corrupt_trace = testing::TempDir() + "corrupt.bin";
+    std::ofstream(corrupt_trace, std::ios::binary) << bytes;
+    MappedTraceCursor cursor;
+    if (cursor.open(corrupt_trace) != OCSCache::Status::OK) {
+      return OCSCache::Status::BAD;
+    }
+    return cursor.getCompressed()->decodeAll(0, 2, decoded);
+  };
+  std::vector<mem_access> decoded;
+  ASSERT_OK(openCorrupted(valid, &decoded));
+  EXPECT_EQ(decoded.size(), trace.size());
+
+  std::string truncated = valid.substr(0, valid.size() - 5);
+  std::string bad_magic = valid;
+  bad_magic.back() ^= 1;
+  // a record count that disagrees with the index
+  std::string bad_count = valid;
+  bad_count[first_block] ^= 1;
+  // more sizes than a dictionary holds
+  std::string bad_dictionary = valid;
+  bad_dictionary[first_block + 16] = static_cast<char>(200);
+  // a footer claiming billions of records
+  std::string bad_records = valid;
+  bad_records[valid.size() - 9] = 0x7f;
+  // a block count 2^61 too large, whose index size wraps around to the real one
+  std::string bad_blocks = valid;
+  bad_blocks[valid.size() - 17] ^= 0x20;
+  for (const std::string *corrupt : {&truncated, &bad_magic, &bad_count,
+                                     &bad_dictionary, &bad_records,
+                                     &bad_blocks}) {
+    decoded.clear();
+    EXPECT_EQ(openCorrupted(*corrupt, &decoded), OCSCache::Status::BAD);
+  }
+}
+
+TEST(BasicSuite, TestTracesStreamFromPipes) {
+  // enough records to span several stream chunks
+  std::string csv_trace = testing::TempDir() + "streamed.csv";
+  std::string compressed_trace = testing::TempDir() + "streamed.bin";
+  {
+    std::ofstream csv(csv_trace);
+    csv << "#dram_region,0x7fe000000000,0x7ff000000000\n"
+        << "header\ntimestamp,address,size,type,tenant\n";
+    for (int i = 0; i < 120000; i++) {
+      csv << i << "," << 0x10000000 + (i * 7919L) % (1 << 24) << ","
+          << 8 * (1 + i % 4) << "," << (i % 5 == 0 ? "W" : "R") << ","
+          << i % 2 << "\n";
+    }
+  }
+  std::vector<mem_access> expected;
+  std::vector<addr_subspace> regions;
+  ASSERT_OK(loadTrace(csv_trace, 0, &expected, &regions));
+  ASSERT_OK(writeCompressedTrace(compressed_trace, expected, regions));
+  std::ifstream csv_size(csv_trace, std::ios::ate | std::ios::binary);
+  ASSERT_GT(static_cast<size_t>(csv_size.tellg()),
+            2 * MappedTraceCursor::kStreamChunkBytes);
+
+  // a reader that gives up early makes the writer's writes fail, not raise
+  signal(SIGPIPE, SIG_IGN);
+  auto writeToPipe = [](const std::string &trace, int fd) {
+    return std::thread([&trace, fd]() {
+      std::ifstream in(trace, std::ios::binary);
+      std::vector<char> buffer(4096);
+      bool open = true;
+      while (open &&
+             (in.read(buffer.data(), buffer.size()) || in.gcount() > 0)) {
+        for (ssize_t written = 0; open && written < in.gcount();) {
+          ssize_t bytes =
+              write(fd, buffer.data() + written, in.gcount() - written);
+          open = bytes > 0;
+          written += open ? bytes : 0;
+        }
+      }
+      close(fd);
+    });
+  };
+  for (const std::string &trace : {csv_trace, compressed_trace}) {
+    int fds[2];
+    ASSERT_EQ(pipe(fds), 0);
+    std::thread writer = writeToPipe(trace, fds[1]);
+
+    std::vector<mem_access> streamed;
+    std::vector<addr_subspace> streamed_regions;
+    OCSCache::Status status =
+        loadTrace("/dev/fd/" + std::to_string(fds[0]), 0, &streamed,
+                  &streamed_regions);
+    close(fds[0]);
+    writer.join();
+    ASSERT_OK(status);
+    ASSERT_EQ(streamed.size(), expected.size());
+    ASSERT_EQ(streamed_regions.size(), 1);
+    EXPECT_EQ(streamed_regions[0].addr_start, 0x7fe000000000);
+    for (size_t idx = 0; idx < expected.size(); idx++) {
+      ASSERT_EQ(streamed[idx].addr, expected[idx].addr);
+      ASSERT_EQ(streamed[idx].size, expected[idx].size);
+      ASSERT_EQ(streamed[idx].timestamp, expected[idx].timestamp);
+      ASSERT_EQ(streamed[idx].tenant, expected[idx].tenant);
+      ASSERT_EQ(streamed[idx].is_write, expected[idx].is_write);
+    }
+  }
+
+  // one pass over the pipe simulates every cache as if it ran on its own
+  constexpr int kSimulated = 10000;
+  std::vector<mem_access> simulated(expected.begin(),
+                                    expected.begin() + kSimulated);
+  std::vector<OCSCache *> streamed_caches = {
+      new BasicOCSCache(2 * PAGE_SIZE, 2, 4), new ClockFMCache(4)};
+  std::vector<OCSCache *> reference_caches = {
+      new BasicOCSCache(2 * PAGE_SIZE, 2, 4), new ClockFMCache(4)};
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+  std::thread writer = writeToPipe(csv_trace, fds[1]);
+  OCSCache::Status status =
+      simulateTrace("/dev/fd/" + std::to_string(fds[0]), /*n_lines=*/-1,
+                    /*sim_first_n_lines=*/kSimulated, streamed_caches,
+                    /*summarize_perf=*/false);
+  close(fds[0]);
+  writer.join();
+  ASSERT_OK(status);
+  EXPECT_TRUE(MappedTraceCursor::isStream("-"));
+  EXPECT_FALSE(MappedTraceCursor::isStream(csv_trace));
+  for (size_t idx = 0; idx < streamed_caches.size(); idx++) {
+    ASSERT_EQ(streamed_caches[idx]->getDramRegions().size(), 1);
+    reference_caches[idx]->setDramRegions(regions);
+    ASSERT_OK(simulateAccesses(simulated, reference_caches[idx],
+                               /*summarize_perf=*/false));
+    std::ostringstream stats[2];
+    stats[0] << streamed_caches[idx]->getPerformanceStats();
+    stats[1] << reference_caches[idx]->getPerformanceStats();
+    EXPECT_EQ(stats[0].str(), stats[1].str());
+    delete streamed_caches[idx];
+    delete reference_caches[idx];
+  }
+
+  // neither a file nor a stream
+  std::vector<mem_access> from_directory;
+  EXPECT_EQ(loadTrace(testing::TempDir(), 0, &from_directory, nullptr),
+            OCSCache::Status::BAD);
+}